@@ -3,8 +3,8 @@
 # License:   MIT
 
 CC      := gcc
-CFLAGS  := -std=c11 -Wall -Wextra -pedantic -Iinclude
-LDFLAGS := 
+CFLAGS  := -std=c11 -Wall -Wextra -pedantic -pthread -Iinclude
+LDFLAGS := -lm -pthread
 TARGET  := atm_cli
 
 SRC_DIR := src
@@ -15,11 +15,36 @@ SRCS := $(SRC_DIR)/main.c \
         $(SRC_DIR)/account.c \
         $(SRC_DIR)/auth.c \
         $(SRC_DIR)/ui.c \
-        $(SRC_DIR)/db_json.c
+        $(SRC_DIR)/db_json.c \
+        $(SRC_DIR)/account_codec.c \
+        $(SRC_DIR)/crc32c.c \
+        $(SRC_DIR)/fileio.c \
+        $(SRC_DIR)/sha256.c \
+        $(SRC_DIR)/parallel.c \
+        $(SRC_DIR)/bloom.c \
+        $(SRC_DIR)/protocol.c \
+        $(SRC_DIR)/timeutil.c \
+        $(SRC_DIR)/throttle.c \
+        $(SRC_DIR)/reload.c \
+        $(SRC_DIR)/replica.c \
+        $(SRC_DIR)/trace.c \
+        $(SRC_DIR)/snapshot.c \
+        $(SRC_DIR)/record.c \
+        $(SRC_DIR)/eod.c \
+        $(SRC_DIR)/history.c \
+        $(SRC_DIR)/idem.c \
+        $(SRC_DIR)/shmview.c \
+        $(SRC_DIR)/import.c
 
 OBJS := $(SRCS:.c=.o)
 
-.PHONY: all clean debug release
+TEST_TARGET := tests/codec_test
+TEST_SRCS   := tests/codec_test.c \
+               $(SRC_DIR)/account_codec.c \
+               $(SRC_DIR)/crc32c.c
+TEST_OBJS   := $(TEST_SRCS:.c=.o)
+
+.PHONY: all clean debug release test
 
 all: $(TARGET)
 
@@ -32,8 +57,14 @@ release: clean all
 $(TARGET): $(OBJS)
 	$(CC) $(CFLAGS) -o $@ $^ $(LDFLAGS)
 
+test: $(TEST_TARGET)
+	./$(TEST_TARGET)
+
+$(TEST_TARGET): $(TEST_OBJS)
+	$(CC) $(CFLAGS) -o $@ $^ $(LDFLAGS)
+
 %.o: %.c
 	$(CC) $(CFLAGS) -c -o $@ $<
 
 clean:
-	$(RM) $(OBJS) $(TARGET)
+	$(RM) $(OBJS) $(TARGET) $(TEST_OBJS) $(TEST_TARGET)
@@ -14,32 +14,158 @@
 
 #include "common.h"
 
+/*
+ * Account schema, defined once. Each entry is
+ *   X(member, key, kind, c_type, array_dim)
+ * where `key` is the JSON key and `kind` selects the generated codec
+ * routines in account_codec.c (STR, MONEY, U32, FLAG, UINT, HEX). The order
+ * of the entries is the CSV column order and the JSON key order.
+ *
+ * Fields added after the original format live in a later group. Records
+ * written before a group existed simply omit it and load with the group
+ * zeroed, so older databases stay readable.
+ *
+ *   is_locked       : 0 = unlocked, positive = locked,
+ *                     ACCOUNT_CLOSED = closed (a tombstone, see below)
+ *   failed_attempts : consecutive failed PIN attempts
+ *   hash_version    : AUTH_HASH_* scheme used for this PIN (see auth.h)
+ *   kdf_cost        : log2 of the KDF iteration count
+ */
+#define ACCOUNT_FIELDS_V1(X)                                                 \
+    X(id,              "id",       STR,   char,     [MAX_ACCOUNT_ID_LEN])    \
+    X(holder_name,     "holder",   STR,   char,     [MAX_NAME_LEN])          \
+    X(balance,         "balance",  MONEY, double,   )                        \
+    X(pin_hash,        "pin_hash", U32,   uint32_t, )                        \
+    X(is_locked,       "locked",   FLAG,  int,      )                        \
+    X(failed_attempts, "failed",   UINT,  unsigned, )
+
+#define ACCOUNT_FIELDS_V2(X)                                                 \
+    X(hash_version,    "hash_ver", UINT,  unsigned, )                        \
+    X(kdf_cost,        "kdf_cost", UINT,  unsigned, )                        \
+    X(pin_salt,        "pin_salt", HEX,   uint8_t,  [AUTH_SALT_LEN])         \
+    X(pin_kdf,         "pin_kdf",  HEX,   uint8_t,  [AUTH_KDF_LEN])
+
+#define ACCOUNT_FIELDS(X) ACCOUNT_FIELDS_V1(X) ACCOUNT_FIELDS_V2(X)
+
+/*
+ * A closed account stays in the store as a tombstone: its ID and holder
+ * are kept, its PIN is cleared and is_locked is ACCOUNT_CLOSED, so readers
+ * that predate tombstones see a locked account. account_store_find skips
+ * tombstones; account_open reuses their slots before growing the store,
+ * and account_store_compact drops them.
+ */
+#define ACCOUNT_CLOSED (-1)
+
+/*
+ * Largest balance an operation may produce: every balance stays an exact
+ * number of cents with a short "%.2f" form. Deposits, transfers and new
+ * accounts that would exceed it fail with ATM_ERR_INVALID_AMOUNT.
+ */
+#define ACCOUNT_MAX_BALANCE 1.0e13
+
 typedef struct {
-    char     id[MAX_ACCOUNT_ID_LEN];
-    char     holder_name[MAX_NAME_LEN];
-    double   balance;
-    uint32_t pin_hash;
-    int      is_locked;        /* 0 = unlocked, non-zero = locked */
-    unsigned failed_attempts;  /* consecutive failed PIN attempts */
+#define ACCOUNT_DECLARE_FIELD(member, key, kind, c_type, dim) c_type member dim;
+    ACCOUNT_FIELDS(ACCOUNT_DECLARE_FIELD)
+#undef ACCOUNT_DECLARE_FIELD
 } Account;
 
 typedef struct {
     Account *items;
     size_t   size;
     size_t   capacity;
+    size_t  *free_slots; /* tombstone positions to reuse, last one first; may be stale */
+    size_t   free_len;
+    size_t   free_cap;
+    int      free_built; /* free_slots has been filled by a scan of items */
 } AccountStore;
 
+/* One leg of a transfer batch. */
+typedef struct {
+    char   from_id[MAX_ACCOUNT_ID_LEN];
+    char   to_id[MAX_ACCOUNT_ID_LEN];
+    double amount;
+} AccountTransfer;
+
+/* Result of scrubbing a database file without loading it. */
+typedef struct {
+    size_t records;    /* data records seen */
+    size_t verified;   /* checksum present and matching */
+    size_t unchecked;  /* well-formed, but no checksum column */
+    size_t corrupted;  /* checksum mismatch */
+    size_t malformed;  /* does not match the schema */
+    size_t first_bad;  /* 1-based line (CSV) or record (JSON) number, 0 if none */
+} AccountVerifyReport;
+
 /* Lifecycle */
 AtmStatus account_store_init(AccountStore *store);
 void      account_store_free(AccountStore *store);
 
-/* Persistence (CSV) */
+/*
+ * Persistence (CSV). `crcs` is optional; if given, it receives the
+ * checksum of every record written (store->size entries).
+ */
 AtmStatus account_store_load(AccountStore *store, const char *path);
-AtmStatus account_store_save(const AccountStore *store, const char *path);
+AtmStatus account_store_save(const AccountStore *store, const char *path, uint32_t *crcs);
 
-/* Lookup / manipulation */
+/*
+ * Checks every record checksum in a CSV database. Returns ATM_OK when the
+ * file is clean, ATM_ERR_CHECKSUM / ATM_ERR_PARSE if any record is
+ * corrupted / malformed, and ATM_ERR_IO if the file cannot be read.
+ */
+AtmStatus account_store_verify(const char *path, AccountVerifyReport *report);
+
+/* Appends a copy of the account, growing the store as needed. */
+AtmStatus account_store_append(AccountStore *store, const Account *account);
+
+/* Lookup / manipulation. Tombstones are not found. */
 Account  *account_store_find(AccountStore *store, const char *account_id);
+int       account_is_closed(const Account *account);
+
+/*
+ * Adds a copy of `account` (its is_locked must not be ACCOUNT_CLOSED).
+ * Returns ATM_ERR_CONFLICT if the ID is already open. A tombstone with
+ * the same ID is reopened in place; otherwise the most recently closed
+ * slot is reused, and only without one does the store grow. The slot
+ * used is stored in *slot (optional).
+ */
+AtmStatus account_open(AccountStore *store, const Account *account, size_t *slot);
+
+/*
+ * Bulk account_open. Entries whose results[i] is not ATM_OK on entry are
+ * skipped. The others are sorted by ID and merged with the store's sorted
+ * IDs in one pass: an ID already open, or repeated in the batch after its
+ * first entry, gets ATM_ERR_CONFLICT. Accepted entries reopen their own
+ * tombstone, fill other tombstones, then are appended, in ID order; each
+ * one's position goes to slots[i] (optional). Returns the number opened,
+ * or 0 with ATM_ERR_INTERNAL in every pending result if memory ran out.
+ */
+size_t    account_open_batch(AccountStore *store, const Account *accounts, size_t count,
+                             AtmStatus *results, size_t *slots);
+
+/*
+ * Turns an open account into a tombstone. Returns ATM_ERR_NOT_FOUND if
+ * it is not open and ATM_ERR_INVALID_AMOUNT unless its balance is zero.
+ */
+AtmStatus account_close(AccountStore *store, const char *account_id);
+
+/* Number of tombstones in the store. */
+size_t    account_store_closed(const AccountStore *store);
+
+/*
+ * Drops every tombstone, keeping the order of the open accounts, and
+ * returns how many were dropped. Account pointers into the store are
+ * invalidated.
+ */
+size_t    account_store_compact(AccountStore *store);
 AtmStatus account_deposit(Account *account, double amount);
 AtmStatus account_withdraw(Account *account, double amount);
 
+/*
+ * Moves `amount` between two accounts. Both records are validated before
+ * either is changed, so the transfer is applied in full or not at all;
+ * persisting the store afterwards writes both records as one unit.
+ */
+AtmStatus account_transfer(AccountStore *store, const char *from_id,
+                           const char *to_id, double amount);
+
 #endif /* ACCOUNT_H */
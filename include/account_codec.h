@@ -0,0 +1,72 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      account_codec.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Record codecs for the CSV and JSON database formats, generated at
+ *   compile time from the ACCOUNT_FIELDS schema in account.h. No format
+ *   strings are interpreted at runtime.
+ */
+
+#ifndef ACCOUNT_CODEC_H
+#define ACCOUNT_CODEC_H
+
+#include "account.h"
+
+/*
+ * Widest "%.2f" of a finite double (sign, 309 digits, point, 2 decimals).
+ * Balances are kept far below that (ACCOUNT_MAX_BALANCE), but a database
+ * edited by hand may hold anything strtod accepts.
+ */
+#define ACCOUNT_MONEY_TEXT_MAX  313
+
+/* Upper bounds for one formatted record (including the trailing newline). */
+#define ACCOUNT_CSV_RECORD_MAX  (MAX_LINE_LEN + ACCOUNT_MONEY_TEXT_MAX)
+#define ACCOUNT_JSON_RECORD_MAX (1024 + ACCOUNT_MONEY_TEXT_MAX)
+
+/* Number of schema columns (excluding the checksum column). */
+#define ACCOUNT_COUNT_FIELD(member, key, kind, c_type, dim) +1
+enum {
+    ACCOUNT_V1_FIELD_COUNT = 0 ACCOUNT_FIELDS_V1(ACCOUNT_COUNT_FIELD),
+    ACCOUNT_FIELD_COUNT    = 0 ACCOUNT_FIELDS(ACCOUNT_COUNT_FIELD)
+};
+
+/*
+ * CSV: one record per line, columns in schema order followed by a CRC32C
+ * of the preceding bytes as eight hex digits, e.g. (original columns only)
+ *   1001,John Doe,1500.00,3356862322,0,0,fe0836cc
+ * Lines with only the ACCOUNT_FIELDS_V1 columns are accepted on input.
+ * account_format_csv writes the line (with '\n') and returns its length;
+ * *crc (if non-NULL) receives the checksum value.
+ * account_parse_csv returns ATM_ERR_PARSE if the line does not match the
+ * schema and ATM_ERR_CHECKSUM if the checksum column does not match. The
+ * checksum column is optional on input; *checked (if non-NULL) is set to
+ * whether one was present.
+ */
+size_t    account_format_csv(const Account *acc, char *out, uint32_t *crc);
+AtmStatus account_parse_csv(const char *line, Account *acc, int *checked);
+
+/*
+ * JSON: one object with keys in schema order plus a trailing "crc32c" key.
+ * Objects with only the ACCOUNT_FIELDS_V1 keys are accepted on input.
+ * account_format_json writes the object indented for the "accounts" array,
+ * without a trailing comma or newline (*crc as for CSV). account_parse_json advances *cursor
+ * just past the last value (before the closing brace) on success; *checked
+ * works as for CSV.
+ */
+size_t    account_format_json(const Account *acc, char *out, uint32_t *crc);
+AtmStatus account_parse_json(const char **cursor, Account *acc, int *checked);
+
+/* CRC32C of the record's canonical CSV columns (the checksum column value). */
+uint32_t  account_record_crc(const Account *acc);
+
+/*
+ * Non-zero if every schema field is identical. Cheaper than comparing
+ * checksums; records that differ only in unprinted digits of a MONEY
+ * value compare unequal here but have the same checksum.
+ */
+int       account_equal(const Account *a, const Account *b);
+
+#endif /* ACCOUNT_CODEC_H */
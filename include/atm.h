@@ -13,11 +13,35 @@
 
 #include "common.h"
 #include "account.h"
+#include "bloom.h"
+#include "throttle.h"
+#include "reload.h"
+#include "replica.h"
+#include "history.h"
+#include "idem.h"
+#include "shmview.h"
+
+#include <stdio.h>
+
+/*
+ * Closing accounts compacts the store once it holds at least
+ * ATM_COMPACT_MIN_CLOSED tombstones and they fill 1 / ATM_COMPACT_RATIO
+ * of its slots, so scans and saves stay proportional to open accounts.
+ */
+#define ATM_COMPACT_MIN_CLOSED 64
+#define ATM_COMPACT_RATIO      4
 
 typedef struct {
     AccountStore store;
     char         db_path[MAX_DB_PATH_LEN];
     int          use_json; /* 0 = CSV, non-zero = JSON */
+    BloomFilter  id_filter; /* rejects unknown account IDs before lookup */
+    Throttle     throttle;  /* login backoff per account and terminal */
+    ReloadWatch  reload;    /* detects edits made to db_path by other processes */
+    Replica      replica;   /* hot standby fed by every persist (fd -1 if none) */
+    History      history;   /* point-in-time log of every persist (ATM_HISTORY) */
+    IdemTable    idem;      /* idempotency keys of recent requests, saved with the store */
+    ShmView      view;      /* balances published to shared memory (ATM_SHM_VIEW) */
 } AtmContext;
 
 AtmStatus atm_init(AtmContext *ctx, const char *db_path);
@@ -26,4 +50,79 @@ void      atm_shutdown(AtmContext *ctx);
 /* Main interaction loop (login + per-session menu) */
 void      atm_run(AtmContext *ctx);
 
+/* Shared helpers for front ends other than the interactive menu */
+int         atm_path_is_json(const char *db_path);
+Account    *atm_find_account(AtmContext *ctx, const char *account_id);
+AtmStatus   atm_persist(AtmContext *ctx);
+
+/* Non-empty, shorter than `cap`, and safe as a CSV field and a JSON string. */
+int         atm_valid_field(const char *text, size_t cap);
+
+/*
+ * Deposit, withdrawal and transfer with an optional idempotency key (NULL
+ * or "" for none). A key seen before returns the first outcome without
+ * applying the request again, or ATM_ERR_CONFLICT if it named a different
+ * request (see idem.h). Keys longer than IDEM_MAX_KEY_LEN - 1 are
+ * rejected with ATM_ERR_PARSE.
+ */
+AtmStatus   atm_deposit(AtmContext *ctx, Account *account, double amount, const char *key);
+AtmStatus   atm_withdraw(AtmContext *ctx, Account *account, double amount, const char *key);
+AtmStatus   atm_transfer(AtmContext *ctx, const char *from_id, const char *to_id,
+                         double amount, const char *key);
+
+/*
+ * Merges edits made to the database file by other processes since the
+ * last load or save (see reload.h). Records may move, so `session`, if
+ * non-NULL, is looked up again by ID; it becomes NULL if the account was
+ * removed. Returns ATM_ERR_CONFLICT if a record changed on both sides
+ * (the local values are kept; details in *report, if non-NULL).
+ */
+AtmStatus   atm_refresh(AtmContext *ctx, Account **session, ReloadReport *report);
+
+/*
+ * atm_refresh followed by atm_persist, so that a save never overwrites
+ * edits it has not seen. Nothing is saved if the file could not be read.
+ */
+AtmStatus   atm_commit(AtmContext *ctx, Account **session);
+
+/*
+ * Account administration. Each call merges external edits first (as
+ * atm_refresh, with `session` looked up again), applies the change and
+ * persists it.
+ *
+ * atm_open_account hashes `pin` at the current KDF cost (auth.h). It
+ * returns ATM_ERR_PARSE for an empty or overlong ID, holder or PIN, or
+ * one containing a separator or quote, ATM_ERR_INVALID_AMOUNT for a
+ * balance below zero or above ACCOUNT_MAX_BALANCE and ATM_ERR_CONFLICT
+ * if the ID is already open.
+ *
+ * atm_close_account leaves a tombstone (see account.h) and requires a zero
+ * balance; *session becomes NULL if it was the closed account. When
+ * compaction is due, the same save drops every tombstone.
+ *
+ * atm_compact drops every tombstone now and stores the count in *dropped
+ * (optional). Nothing is saved if there were none.
+ */
+AtmStatus   atm_open_account(AtmContext *ctx, const char *account_id, const char *holder,
+                             const char *pin, double balance, Account **session);
+AtmStatus   atm_close_account(AtmContext *ctx, const char *account_id, Account **session);
+AtmStatus   atm_compact(AtmContext *ctx, Account **session, size_t *dropped);
+
+/*
+ * Call after the store's contents were replaced wholesale (e.g. on a
+ * promoted standby): rebuilds the ID filter and persists the store.
+ */
+AtmStatus   atm_store_replaced(AtmContext *ctx);
+const char *atm_status_name(AtmStatus status);
+
+/*
+ * Reads "from_id,to_id,amount[,key]" lines from `in`, applies them as a
+ * single batch (lines with a key through atm_transfer's idempotency
+ * check), persists once, and writes "<n> <code> <name>" per line to `out`
+ * (n counts the lines that are not blank or '#' comments). An overlong
+ * line is one ATM_ERR_PARSE result. If the save fails, the lines that
+ * were applied report its status instead of ATM_OK.
+ */
+AtmStatus   atm_transfer_batch(AtmContext *ctx, FILE *in, FILE *out);
+
 #endif /* ATM_H */
@@ -14,13 +14,55 @@
 #include "common.h"
 #include "account.h"
 
-/* Non-cryptographic PIN hash for demonstration purposes. */
+/* PIN hash schemes, stored in Account.hash_version. */
+#define AUTH_HASH_FNV1A       0u  /* legacy: unsalted FNV-1a in pin_hash */
+#define AUTH_HASH_PBKDF2      1u  /* PBKDF2-HMAC-SHA256(pin, salt) */
+#define AUTH_HASH_PBKDF2_FNV  2u  /* PBKDF2-HMAC-SHA256(FNV-1a(pin), salt), bulk-migrated */
+
+/* KDF cost is log2 of the PBKDF2 iteration count. */
+#define AUTH_KDF_MIN_COST     4u
+#define AUTH_KDF_MAX_COST     24u
+#define AUTH_KDF_DEFAULT_COST 12u
+
+/* Non-cryptographic PIN hash, kept for legacy records. */
 uint32_t  auth_hash_pin(const char *pin);
 
+/* Cost used for new hashes and login-time upgrades (clamped to the limits). */
+void      auth_set_kdf_cost(unsigned cost);
+unsigned  auth_kdf_cost(void);
+
+/* Replaces the account's PIN hash with a fresh salted hash at the current cost. */
+AtmStatus auth_set_pin(Account *account, const char *pin);
+
+/*
+ * Like auth_set_pin, but keeps the account's scheme and cost, so the next
+ * login costs what it did before (used to prepare session replays).
+ */
+AtmStatus auth_replace_pin(Account *account, const char *pin);
+
 /*
  * Verifies a login attempt using the provided PIN.
  * Updates failed_attempts and is_locked fields in the Account when necessary.
+ * Hash comparison is constant-time. On success, a record using an older
+ * scheme or a lower cost is transparently rehashed with auth_set_pin.
  */
 AtmStatus auth_verify_login(Account *account, const char *pin);
 
+/*
+ * Bulk migration: wraps every legacy FNV-1a hash of an open account in
+ * the salted KDF (AUTH_HASH_PBKDF2_FNV) at the current cost, using
+ * `threads` worker threads (0 = one per CPU) and four KDF lanes per
+ * thread. Wrapped records are upgraded to AUTH_HASH_PBKDF2 at their next
+ * login.
+ */
+AtmStatus auth_rehash_store(AccountStore *store, unsigned threads, size_t *upgraded);
+
+/*
+ * Bulk onboarding: sets the PIN of *accounts[i] to pins[i] as
+ * auth_set_pin does, at the current cost, with `threads` worker threads
+ * (0 = one per CPU) and four KDF lanes per thread.
+ */
+AtmStatus auth_set_pins(Account *const *accounts, const char *const *pins, size_t count,
+                        unsigned threads);
+
 #endif /* AUTH_H */
@@ -0,0 +1,48 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      bloom.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Bloom filter over account IDs. Consulted before a full account lookup
+ *   so that unknown IDs (typos, probing) are rejected without a store scan.
+ *   A filter may report false positives but never false negatives.
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "common.h"
+#include "account.h"
+
+#define BLOOM_FILE_SUFFIX    ".bloom"
+#define BLOOM_TARGET_FP_RATE 0.01
+
+typedef struct {
+    uint64_t *bits;
+    uint64_t  nbits;
+    uint32_t  nhashes;
+    uint64_t  nitems;
+    uint64_t  digest;   /* sum of the inserted IDs' hashes (order-independent) */
+} BloomFilter;
+
+/* Lifecycle */
+AtmStatus bloom_init(BloomFilter *bf, size_t expected_items, double fp_rate);
+void      bloom_free(BloomFilter *bf);
+
+/* Membership */
+void      bloom_add(BloomFilter *bf, const char *key);
+int       bloom_maybe_contains(const BloomFilter *bf, const char *key);
+
+/* Builds a filter sized for (and populated with) every ID in the store. */
+AtmStatus bloom_build(BloomFilter *bf, const AccountStore *store);
+
+/* Digest of the store's IDs, comparable with BloomFilter.digest. */
+uint64_t  bloom_store_digest(const AccountStore *store);
+
+/* Persistence (binary sidecar next to the database file) */
+AtmStatus bloom_save(const BloomFilter *bf, const char *path);
+AtmStatus bloom_load(BloomFilter *bf, const char *path);
+
+#endif /* BLOOM_H */
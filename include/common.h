@@ -17,11 +17,14 @@
 #define MAX_ACCOUNT_ID_LEN  16
 #define MAX_NAME_LEN        64
 #define MAX_PIN_LEN         32
-#define MAX_LINE_LEN        256
+#define MAX_LINE_LEN        512
 #define MAX_DB_PATH_LEN     260
 
 #define MAX_FAILED_ATTEMPTS 3
 
+#define AUTH_SALT_LEN       16  /* bytes of random salt per PIN hash */
+#define AUTH_KDF_LEN        32  /* bytes of derived key per PIN hash */
+
 typedef enum {
     ATM_OK = 0,
     ATM_ERR_IO,
@@ -31,7 +34,10 @@ typedef enum {
     ATM_ERR_LOCKED,
     ATM_ERR_INVALID_AMOUNT,
     ATM_ERR_INSUFFICIENT_FUNDS,
-    ATM_ERR_INTERNAL
+    ATM_ERR_INTERNAL,
+    ATM_ERR_CHECKSUM, /* record checksum mismatch (appended: codes are stable) */
+    ATM_ERR_THROTTLED, /* login attempt inside a backoff window */
+    ATM_ERR_CONFLICT   /* record changed both in memory and on disk */
 } AtmStatus;
 
 #endif /* COMMON_H */
@@ -0,0 +1,27 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      crc32c.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   CRC32C (Castagnoli) checksums for database records. Uses the SSE4.2
+ *   crc32 instruction when the CPU supports it, and a portable
+ *   slicing-by-8 table implementation otherwise.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include "common.h"
+
+/*
+ * Continues a CRC32C over `len` bytes, zlib style: start with crc = 0 and
+ * feed the previous result back in to checksum data in pieces.
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/* Non-zero if the hardware-accelerated path is in use. */
+int      crc32c_hw_available(void);
+
+#endif /* CRC32C_H */
@@ -15,6 +15,9 @@
 #include "common.h"
 
 AtmStatus account_store_load_json(AccountStore *store, const char *path);
-AtmStatus account_store_save_json(const AccountStore *store, const char *path);
+AtmStatus account_store_save_json(const AccountStore *store, const char *path, uint32_t *crcs);
+
+/* JSON counterpart of account_store_verify (see account.h). */
+AtmStatus account_store_verify_json(const char *path, AccountVerifyReport *report);
 
 #endif /* DB_JSON_H */
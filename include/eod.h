@@ -0,0 +1,86 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      eod.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   End-of-day batch: applies interest and fee rules to every open account
+ *   in parallel chunks and persists the store once.
+ *
+ *   Rules come from a text file, one per line, applied in order:
+ *
+ *     days <n>                        accrual days for this run (default 1)
+ *     interest <annual_pct> [min <balance>]
+ *     fee <amount> [below <balance>]
+ *
+ *   Interest accrues at annual_pct / 365 per day on balances of at least
+ *   `min`; a fee is charged when the balance is below `below` (always if
+ *   omitted) and never takes a balance under zero. Amounts are rounded
+ *   to cents per account. '#' starts a comment.
+ *
+ *   Each run is named by the caller (normally the business date) and its
+ *   progress is checkpointed in "<db>.eod":
+ *
+ *     applying    the database is still untouched: a restart redoes the run
+ *     committing  the single save is under way; the checkpoint holds the
+ *                 store digest before and after, so a restart tells
+ *                 whether the save landed and never applies a run twice
+ *     done        a repeated run with the same name is a no-op
+ *
+ *   A run is refused while a different run has not reached "done".
+ */
+
+#ifndef EOD_H
+#define EOD_H
+
+#include "common.h"
+#include "atm.h"
+
+#define EOD_CHECKPOINT_SUFFIX ".eod"
+#define EOD_MAX_RULES         32
+#define EOD_MAX_RUN_ID_LEN    64
+#define EOD_CHUNK_ACCOUNTS    (64 * 1024)
+
+typedef enum {
+    EOD_RULE_INTEREST,
+    EOD_RULE_FEE
+} EodRuleKind;
+
+typedef struct {
+    EodRuleKind kind;
+    double      rate;        /* interest: daily fraction */
+    int64_t     cents;       /* fee amount */
+    int64_t     threshold;   /* interest: minimum; fee: waived at or above */
+    int         has_threshold;
+} EodRule;
+
+typedef struct {
+    EodRule  rules[EOD_MAX_RULES];
+    size_t   count;
+    unsigned days;
+    uint32_t digest;         /* of the rules file, recorded in the checkpoint */
+} EodRules;
+
+typedef struct {
+    size_t   accounts;       /* accounts changed */
+    int64_t  interest_cents; /* total credited */
+    int64_t  fee_cents;      /* total charged */
+    int      resumed;        /* finished an interrupted run */
+    int      already_done;   /* the run had completed before: nothing changed */
+    uint64_t apply_ns;       /* parallel pass over the store */
+    uint64_t persist_ns;
+} EodReport;
+
+/* Parses a rules file. ATM_ERR_PARSE names the bad line in *bad_line. */
+AtmStatus eod_rules_load(EodRules *rules, const char *path, size_t *bad_line);
+
+/*
+ * Runs (or resumes) the batch named `run_id` over ctx's store with
+ * `threads` workers (0 = one per CPU). Returns ATM_ERR_CONFLICT if another
+ * run is unfinished or the database no longer matches the checkpoint.
+ */
+AtmStatus eod_run(AtmContext *ctx, const EodRules *rules, const char *run_id,
+                  unsigned threads, EodReport *report);
+
+#endif /* EOD_H */
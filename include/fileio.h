@@ -0,0 +1,94 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      fileio.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Crash-safe whole-file replacement used by the database writers.
+ *   Data is written to "<path>.tmp", flushed to stable storage, and then
+ *   renamed over the original, so readers and a restarted process see
+ *   either the old file or the new one, never a partial write.
+ *
+ *   Writers format straight into a pool of FILEIO_BUFFERS buffers
+ *   (fileio_replace_reserve / _advance). Two backends drain them:
+ *
+ *     stdio             fwrite + fflush + fsync (the default).
+ *     io_uring (Linux)  selected with ATM_IO=io_uring. The buffers are
+ *                       registered with the kernel once; each full buffer
+ *                       is queued as a fixed-buffer write while the next
+ *                       one is being filled, completions are reaped in
+ *                       batches, and the last write is linked to the fsync
+ *                       in one submission. Falls back to stdio when the
+ *                       kernel refuses io_uring.
+ *
+ *   io_uring is not the default: buffered writes to ext4 are handed to
+ *   kernel worker threads, which on a single CPU cost more than the
+ *   write() calls they replace (see the README for numbers).
+ *
+ *   The pool is process-wide: only one replacement may be open at a time.
+ */
+
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include "common.h"
+
+#include <stdio.h>
+
+#define FILEIO_TMP_SUFFIX ".tmp"
+#define FILEIO_BUF_LEN    (64 * 1024)
+#define FILEIO_BUFFERS    4
+#define FILEIO_ENV        "ATM_IO"   /* "io_uring" or "stdio" */
+
+typedef enum {
+    FILEIO_STDIO,
+    FILEIO_URING
+} FileioBackend;
+
+typedef struct {
+    FILE     *fp;       /* stdio backend */
+    int       fd;       /* io_uring backend, -1 with stdio */
+    char     *buf;      /* pool buffer being filled */
+    size_t    used;
+    unsigned  slot;     /* index of `buf` in the pool */
+    uint64_t  offset;   /* file offset of `buf` */
+    int       ok;       /* cleared by the first failed write */
+    char      path[MAX_DB_PATH_LEN];
+    char      tmp_path[MAX_DB_PATH_LEN + sizeof(FILEIO_TMP_SUFFIX)];
+} FileReplace;
+
+/*
+ * Chooses the backend for later replacements. FILEIO_URING silently
+ * stays on stdio where io_uring is unavailable; fileio_backend() reports
+ * the one in effect. The default comes from ATM_IO (stdio if unset).
+ */
+void          fileio_set_backend(FileioBackend backend);
+FileioBackend fileio_backend(void);
+const char   *fileio_backend_name(FileioBackend backend);
+
+/* Opens the temporary file for writing. */
+AtmStatus fileio_replace_begin(FileReplace *fr, const char *path);
+
+/*
+ * Returns room for `len` (<= FILEIO_BUF_LEN) contiguous bytes, handing
+ * full buffers to the backend as needed, or NULL once a write failed.
+ * fileio_replace_advance commits the `len` bytes actually produced.
+ */
+char     *fileio_replace_reserve(FileReplace *fr, size_t len);
+void      fileio_replace_advance(FileReplace *fr, size_t len);
+
+/* Copies `len` bytes in (reserve + memcpy + advance). Returns 0 on failure. */
+int       fileio_replace_write(FileReplace *fr, const void *data, size_t len);
+
+/*
+ * Writes what is left, syncs and closes the temporary file, then
+ * atomically renames it over the target and, on POSIX, syncs the parent
+ * directory so the rename survives a crash. On any failure before the
+ * rename (including `write_ok` == 0) the target is left untouched; if
+ * only the directory sync fails, ATM_ERR_IO is returned although the
+ * target already holds the new content.
+ */
+AtmStatus fileio_replace_commit(FileReplace *fr, int write_ok);
+
+#endif /* FILEIO_H */
@@ -0,0 +1,119 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      history.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Point-in-time account history. With ATM_HISTORY=<dir> set, the
+ *   history directory is split into segments, each named by its start
+ *   time in wall-clock ms:
+ *
+ *     <start>.snap   full snapshot of the store at <start> (snapshot.h)
+ *     <start>.log    every record that changed in a save after <start>:
+ *                    HistoryEntry header + the record's CSV line (with its
+ *                    checksum); `prev` links each entry to the previous one
+ *                    for the same account
+ *     <start>.idx    open-addressing table: account ID -> its newest entry
+ *     segments       one <start> per line, oldest first
+ *
+ *   A segment starts when the process opens the history, and again after
+ *   HISTORY_INTERVAL_ENV seconds (default 3600) or when its index is half
+ *   full; a save that would fill it further starts the next segment early,
+ *   and that segment's snapshot holds the changes left unlogged. To find
+ *   an account at time T, the query takes the last segment starting at or
+ *   before T, looks the ID up in its index and follows the account's own
+ *   entries back to the newest one at or before T. Only if there is none
+ *   does it read the account from the segment's snapshot.
+ *
+ *   Changes are logged when they are saved, with the save's timestamp.
+ *   One process per database should write history.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "common.h"
+#include "account.h"
+
+#include <stdio.h>
+
+#define HISTORY_ENV            "ATM_HISTORY"
+#define HISTORY_INTERVAL_ENV   "ATM_HISTORY_INTERVAL"
+#define HISTORY_INTERVAL_S     3600
+#define HISTORY_MIN_SLOTS      1024
+#define HISTORY_LOG_MAGIC      "ATMHLOG"  /* with its NUL: 8 bytes */
+#define HISTORY_IDX_MAGIC      "ATMHIDX"
+#define HISTORY_SEGMENTS_FILE  "segments"
+
+/* Log entry header, followed by `len` bytes of CSV record. */
+typedef struct {
+    uint64_t ts_ms;   /* save time, ms since the Unix epoch */
+    uint64_t prev;    /* offset + 1 of the account's previous entry, 0 if none */
+    uint32_t len;
+    uint32_t crc;     /* CRC32C of ts_ms, prev, len and the record */
+} HistoryEntry;
+
+/* Index slot: empty while `last` is 0. */
+typedef struct {
+    char     id[MAX_ACCOUNT_ID_LEN];
+    uint64_t last;    /* offset + 1 of the account's newest entry */
+} HistorySlot;
+
+typedef struct {
+    int          enabled;
+    char         dir[MAX_DB_PATH_LEN];
+    uint64_t     interval_ms;
+    uint64_t     start_ms;  /* current segment */
+    FILE        *log;
+    FILE        *idx;
+    uint64_t     log_end;
+    uint64_t     slots;     /* power of two */
+    uint64_t     used;
+    HistorySlot *table;     /* in-memory copy of the index */
+    size_t      *dirty;     /* slots changed by the current history_log call */
+    size_t       dirty_len;
+    size_t       dirty_cap;
+    uint32_t    *logged;    /* record CRCs as last logged, parallel to store.items */
+    size_t       logged_len;
+    size_t       logged_cap;
+    int          resync;    /* records were removed: start a new segment */
+} History;
+
+/* Result of a point-in-time query. */
+typedef struct {
+    uint64_t segment_ms;   /* start of the segment used */
+    uint64_t as_of_ms;     /* time of the change that set this state */
+    int      from_log;     /* 0: the account did not change since segment_ms */
+    size_t   entries_read; /* log entries visited */
+} HistoryAnswer;
+
+void      history_init(History *h);
+
+/*
+ * Starts writing history to `dir` (created if missing) with a new
+ * segment for `store`. `crcs` (optional) are the store's record CRCs.
+ */
+AtmStatus history_open(History *h, const char *dir, const AccountStore *store,
+                       const uint32_t *crcs);
+void      history_close(History *h);
+
+/*
+ * Call after every successful save: logs the records whose CRC changed
+ * since the last call (`crcs` as for replica_ship) and starts a new
+ * segment when one is due. A failure does not undo the save; the caller
+ * marks the history for resync so the next segment's snapshot covers the gap.
+ */
+AtmStatus history_log(History *h, const AccountStore *store, const uint32_t *crcs);
+
+/* Records were removed from the store: the next log call starts a new segment. */
+void      history_mark_resync(History *h);
+
+/*
+ * Rebuilds `account_id` as it was at `at_ms`. Returns ATM_ERR_NOT_FOUND if
+ * the history does not reach back that far or the account did not exist.
+ */
+AtmStatus history_query(const char *dir, const char *account_id, uint64_t at_ms,
+                        Account *out, HistoryAnswer *answer);
+
+#endif /* HISTORY_H */
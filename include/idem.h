@@ -0,0 +1,125 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      idem.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Idempotency keys for deposits, withdrawals and transfers. A front end
+ *   that may retry a request tags it with a key of its choosing; a key
+ *   already seen returns the first outcome (AtmStatus) without applying
+ *   the operation again. Reusing a key for a different request (other
+ *   account, kind or amount) returns ATM_ERR_CONFLICT.
+ *
+ *   Keys are kept for IDEM_TTL_ENV seconds (default one day), at most
+ *   IDEM_CAPACITY of them: the oldest key is dropped when a new one does
+ *   not fit. Entries sit in a ring in arrival order, so expiry pops from
+ *   the head; an open-addressing index maps each key to its ring slot.
+ *
+ *   The table is persisted with the store in "<db>.idem", an append-only
+ *   journal of fixed-size, checksummed records. Before every save that
+ *   follows new keys, those keys are appended and synced behind a group
+ *   record holding a digest of the database as it is on disk; once the
+ *   save has landed, a commit marker is synced before any response goes
+ *   out. On restart, trailing groups after the last marker whose digest
+ *   still matches the file belong to saves that never landed (or that left
+ *   the file unchanged and answered no one): their keys are dropped, so the
+ *   retried request is applied. A digest that no longer matches proves the
+ *   save landed even if the crash came before its marker. The journal is
+ *   rewritten once it holds twice the live keys (plus IDEM_COMPACT_SLACK
+ *   records).
+ */
+
+#ifndef IDEM_H
+#define IDEM_H
+
+#include "common.h"
+
+#include <stdio.h>
+
+#define IDEM_FILE_SUFFIX   ".idem"
+#define IDEM_MAGIC         "ATMIDEM"  /* with its NUL: 8 bytes */
+#define IDEM_TTL_ENV       "ATM_IDEM_TTL"
+#define IDEM_TTL_S         86400
+#define IDEM_CAPACITY      65536u     /* remembered keys (power of two) */
+#define IDEM_MAX_KEY_LEN   48         /* including the terminating NUL */
+#define IDEM_COMPACT_SLACK 4096u      /* journal records allowed beyond twice the keys */
+
+typedef enum {
+    IDEM_GROUP = 0,   /* journal only: a group of keys, or a commit marker */
+    IDEM_DEPOSIT,
+    IDEM_WITHDRAW,
+    IDEM_TRANSFER
+} IdemOp;
+
+/* What a key stands for; a retry must match it exactly. */
+typedef struct {
+    IdemOp      op;
+    const char *account_id;  /* the account acted on (source of a transfer) */
+    const char *to_id;       /* transfers only */
+    double      amount;
+} IdemRequest;
+
+/* One remembered key; also the journal record (zero-padded). */
+typedef struct {
+    char     key[IDEM_MAX_KEY_LEN];
+    char     account_id[MAX_ACCOUNT_ID_LEN];
+    char     to_id[MAX_ACCOUNT_ID_LEN];
+    int64_t  cents;
+    uint64_t expires_ms;  /* wall clock; IDEM_GROUP: store digest */
+    int32_t  op;
+    int32_t  status;      /* IDEM_GROUP: 1 for a commit marker */
+    uint32_t hash;        /* CRC32C of the key: its home slot in the index */
+    uint32_t crc;         /* CRC32C of everything above */
+} IdemEntry;
+
+typedef struct {
+    IdemEntry *ring;      /* IDEM_CAPACITY entries */
+    size_t     head;      /* oldest */
+    size_t     count;
+    size_t     unsynced;  /* newest entries not yet in the journal */
+    uint64_t  *index;     /* 2 * IDEM_CAPACITY slots: key hash << 32 | ring position + 1 */
+    uint64_t   ttl_ms;
+    FILE      *journal;
+    char       path[MAX_DB_PATH_LEN + sizeof(IDEM_FILE_SUFFIX)];
+    size_t     journal_records;
+    int        pending;   /* a group is journaled whose save has no commit marker yet */
+    size_t     dropped;   /* keys lost to a full table before expiry */
+} IdemTable;
+
+void      idem_init(IdemTable *t);
+
+/*
+ * Loads "<db_path>.idem". `crcs` are the record CRCs of the database as
+ * just loaded (reload.h `base`); they decide which trailing groups are
+ * dropped.
+ */
+AtmStatus idem_open(IdemTable *t, const char *db_path, const uint32_t *crcs, size_t count);
+void      idem_close(IdemTable *t);
+
+/*
+ * Returns 1 and the first outcome in *status if `key` was seen (or
+ * ATM_ERR_CONFLICT if it was used for a different request), 0 if not.
+ */
+int       idem_check(IdemTable *t, const char *key, const IdemRequest *req, AtmStatus *status);
+
+/* Remembers the outcome of a request whose key idem_check did not know. */
+AtmStatus idem_remember(IdemTable *t, const char *key, const IdemRequest *req, AtmStatus status);
+
+/*
+ * Call before every save, with the record CRCs of the file about to be
+ * replaced: appends and syncs the keys remembered since the last call.
+ * The save must not go ahead if this fails.
+ */
+AtmStatus idem_prepare(IdemTable *t, const uint32_t *crcs, size_t count);
+
+/*
+ * Call after a successful save, before answering the requests it holds:
+ * syncs a commit marker if keys were journaled for it, and rewrites the
+ * journal when it is due (a failed rewrite keeps the old journal and is
+ * retried later). Returns ATM_ERR_IO if the marker could not be synced;
+ * the save stands, and the next successful save writes the marker.
+ */
+AtmStatus idem_saved(IdemTable *t);
+
+#endif /* IDEM_H */
@@ -0,0 +1,58 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      import.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Bulk account onboarding. Reads one new account per line,
+ *
+ *     id,holder,pin[,balance]
+ *
+ *   ('#' starts a comment line), and opens all of them with a single
+ *   persist. Rows are checked as atm_open_account checks its arguments;
+ *   the valid ones are sorted by ID and merged with the store in one pass
+ *   (account_open_batch), so an ID that is already open or repeats an
+ *   earlier row is rejected. The initial PINs of the accepted rows are
+ *   then hashed in parallel at the current KDF cost (auth_set_pins).
+ *
+ *   Every row gets its own AtmStatus: ATM_ERR_PARSE for a malformed row,
+ *   ATM_ERR_INVALID_AMOUNT for a balance below zero or above
+ *   ACCOUNT_MAX_BALANCE and ATM_ERR_CONFLICT for a duplicate ID. Rejected
+ *   rows do not stop the others.
+ *
+ *   At the default cost the KDF dominates (about 2^12 SHA-256 blocks per
+ *   PIN); a large onboarding can run at a lower cost, since each PIN is
+ *   rehashed at the current cost on its first successful login.
+ */
+
+#ifndef IMPORT_H
+#define IMPORT_H
+
+#include "common.h"
+#include "atm.h"
+
+#include <stdio.h>
+
+typedef struct {
+    size_t   rows;        /* data rows read */
+    size_t   imported;
+    size_t   malformed;   /* ATM_ERR_PARSE or ATM_ERR_INVALID_AMOUNT */
+    size_t   duplicates;  /* ATM_ERR_CONFLICT */
+    uint64_t read_ns;     /* parsing and checking the rows */
+    uint64_t merge_ns;    /* sort and merge with the store */
+    uint64_t hash_ns;     /* PIN hashing */
+    uint64_t persist_ns;
+} ImportReport;
+
+/*
+ * Imports the rows in `in` into ctx's store, after merging external edits
+ * as atm_open_account does, and writes "<line> <code> <name>" per data row
+ * to `out` (line numbers count every line of `in`). `threads` hash PINs
+ * (0 = one per CPU). Returns the status of reading and persisting, not of
+ * the rows; nothing is saved if no row was accepted.
+ */
+AtmStatus import_accounts(AtmContext *ctx, FILE *in, FILE *out, unsigned threads,
+                          ImportReport *report);
+
+#endif /* IMPORT_H */
@@ -0,0 +1,30 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      parallel.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Minimal fork/join helper for bulk jobs over the account store.
+ *   Uses POSIX threads where available and runs serially elsewhere.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "common.h"
+
+/* Processes the half-open index range [begin, end). */
+typedef void (*ParallelRangeFn)(void *arg, size_t begin, size_t end);
+
+/* Number of online CPUs (at least 1). */
+unsigned  parallel_cpu_count(void);
+
+/*
+ * Splits [0, count) into `threads` contiguous ranges and runs `fn` on each
+ * concurrently, returning when all have finished. threads == 0 means one
+ * per CPU. Falls back to a single serial call if threads cannot be started.
+ */
+AtmStatus parallel_for(size_t count, unsigned threads, ParallelRangeFn fn, void *arg);
+
+#endif /* PARALLEL_H */
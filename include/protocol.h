@@ -0,0 +1,44 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      protocol.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Headless line protocol for kiosk front ends. One request per line on
+ *   stdin, one response per line on stdout:
+ *
+ *     SRC <terminal_id>        ->  <code> <name>
+ *     LOGIN <id> <pin>         ->  <code> <name>  (ERR_THROTTLED adds <retry_ms>)
+ *     BAL                      ->  <code> <name> <balance>
+ *     DEP <amount> [key]       ->  <code> <name> <balance>
+ *     WDR <amount> [key]       ->  <code> <name> <balance>
+ *     XFR <to_id> <amt> [key]  ->  <code> <name> <balance>
+ *     LOGOUT                   ->  <code> <name>
+ *     QUIT                     ->  (ends the stream)
+ *
+ *   <code> is the numeric AtmStatus and <name> its symbolic form
+ *   (e.g. "0 OK 1500.00", "7 ERR_INSUFFICIENT_FUNDS 20.00"). A request
+ *   repeated with the same idempotency key gets the first <code> back
+ *   and is not applied again (see idem.h); <balance> is the current one.
+ *   No prompts, colors, or terminal control calls are emitted.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "atm.h"
+
+/*
+ * Serves requests from stdin until EOF or QUIT.
+ * Output is fully buffered; pending mutations are persisted and responses
+ * flushed only when no further input is immediately available, so a
+ * response is never visible before the change it reports is on disk.
+ * A failing save is retried, with the responses held, for up to 30 s; if
+ * it still fails, the responses to the unsaved changes carry the save's
+ * status (e.g. "1 ERR_IO 1500.00"), and the session ends without saving
+ * them.
+ */
+AtmStatus protocol_run(AtmContext *ctx);
+
+#endif /* PROTOCOL_H */
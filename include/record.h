@@ -0,0 +1,79 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      record.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Session recording and replay, for load testing a build against
+ *   production traffic.
+ *
+ *   With ATM_RECORD=<file> set, the interactive menu and protocol mode
+ *   append every operation that reaches the store (logins, balance
+ *   inquiries, deposits, withdrawals, transfers, logouts) and every save
+ *   to <file>, with its outcome and a timestamp. PINs are never recorded.
+ *   The file is "ATMREC\0\0", a varint version, then one record per
+ *   operation:
+ *
+ *     varint  microseconds since the previous record
+ *     byte    op (RecordOp)        byte  status (AtmStatus)
+ *     LOGIN       varint id_len, id
+ *     DEP / WDR   zigzag varint amount in cents
+ *     XFR         varint to_len, to_id, zigzag varint amount in cents
+ *
+ *   Records are buffered and written in RECORD_BUF_LEN blocks and at exit.
+ *
+ *   Replay drives atm_find_account, auth_verify_login, account_deposit /
+ *   _withdraw / _transfer and atm_persist in the recorded order, at the
+ *   recorded pace divided by `speed` (or as fast as possible when speed
+ *   is 0), and reports throughput and per-operation latency.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include "common.h"
+#include "atm.h"
+
+#include <stdio.h>
+
+#define RECORD_MAGIC      "ATMREC"   /* with padding: 8 bytes */
+#define RECORD_VERSION    1u
+#define RECORD_ENV        "ATM_RECORD"
+#define RECORD_BUF_LEN    (64 * 1024)
+#define RECORD_REPLAY_SUFFIX ".replay"
+
+typedef enum {
+    RECORD_LOGIN = 1,
+    RECORD_BALANCE,
+    RECORD_DEPOSIT,
+    RECORD_WITHDRAW,
+    RECORD_TRANSFER,
+    RECORD_LOGOUT,
+    RECORD_PERSIST,
+    RECORD_OP_COUNT
+} RecordOp;
+
+/* Starts recording if ATM_RECORD is set. */
+void      record_init(void);
+/* Writes out buffered records and closes the file. */
+void      record_shutdown(void);
+
+/* Hooks; no-ops unless recording. `amount` is in currency units. */
+void      record_login(const char *account_id, AtmStatus status);
+void      record_op(RecordOp op, AtmStatus status);
+void      record_amount(RecordOp op, double amount, AtmStatus status);
+void      record_transfer(const char *to_id, double amount, AtmStatus status);
+
+/*
+ * Replays the recording at `path` against `ctx`, whose saves must
+ * already point away from the source database. Before the clock starts,
+ * every account with a successful recorded login gets RECORD_REPLAY_PIN
+ * (auth_replace_pin: same scheme and cost); failed logins use a PIN that
+ * never matches. Operations whose status differs from the
+ * recorded one are counted as mismatches. The report goes to `out`.
+ */
+#define RECORD_REPLAY_PIN "0000"
+AtmStatus record_replay(AtmContext *ctx, const char *path, double speed, FILE *out);
+
+#endif /* RECORD_H */
@@ -0,0 +1,89 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      reload.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Hot reload of the account database when another process (e.g. the
+ *   back office) edits it. On Linux the database's directory is watched
+ *   with inotify, so checking for changes costs one non-blocking read;
+ *   elsewhere, a stat() of the file is compared with the last snapshot.
+ *
+ *   Applying a reload is a three-way diff. The per-record CRC at the last
+ *   load or save is the common base. A record that changed on disk but
+ *   not in memory takes the disk version. One that changed in memory but
+ *   not on disk keeps the local version. One that changed on both sides
+ *   (to different values) is a conflict: the local version is kept and
+ *   reported, and will overwrite the disk version on the next save.
+ */
+
+#ifndef RELOAD_H
+#define RELOAD_H
+
+#include "common.h"
+#include "account.h"
+
+/* What identifies one version of the database file. */
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    uint64_t mtime_ns;
+    int      exists;
+} ReloadFileId;
+
+typedef struct {
+    int          fd;         /* inotify descriptor, -1 when not available */
+    char         name[MAX_DB_PATH_LEN]; /* file name within the watched directory */
+    ReloadFileId file;       /* file version matching `base` */
+    int          check;      /* an event was seen; compare the file with `file` */
+    uint32_t    *base;       /* record CRCs at the last load/save, parallel to store.items */
+    size_t       base_len;
+    size_t       base_cap;
+    uint32_t    *next;       /* filled by a save in progress; becomes `base` on success */
+    size_t       next_cap;
+} ReloadWatch;
+
+typedef struct {
+    size_t updated;   /* records replaced with the disk version */
+    size_t added;     /* records that appeared on disk */
+    size_t removed;   /* records that disappeared from disk */
+    size_t conflicts; /* records changed on both sides (local kept) */
+    char   first_conflict[MAX_ACCOUNT_ID_LEN];
+} ReloadReport;
+
+/* Starts watching `path`. Falls back to stat() polling if inotify fails. */
+AtmStatus reload_watch_init(ReloadWatch *w, const char *path);
+void      reload_watch_free(ReloadWatch *w);
+
+/*
+ * Records `store` as the state of the file at `path` (call after a load
+ * or a successful save): remembers the file version and every record CRC.
+ */
+AtmStatus reload_snapshot(ReloadWatch *w, const char *path, const AccountStore *store);
+
+/*
+ * Saving: reload_save_buffer returns room for `count` record CRCs (NULL if
+ * out of memory) for the save to fill; after a successful save,
+ * reload_save_done makes them the new base without recomputing them.
+ */
+uint32_t *reload_save_buffer(ReloadWatch *w, size_t count);
+void      reload_save_done(ReloadWatch *w, const char *path, size_t count);
+
+/*
+ * Non-blocking. Returns 1 if the file at `path` differs from the last
+ * snapshot (filling *current with its version), 0 if not.
+ */
+int       reload_pending(ReloadWatch *w, const char *path, ReloadFileId *current);
+
+/*
+ * Merges `incoming` (the freshly parsed file, version `file`) into `store`
+ * as described above. Surviving records keep their order; added records
+ * are appended in file order. Returns ATM_ERR_CONFLICT if any record
+ * conflicted, ATM_OK otherwise.
+ */
+AtmStatus reload_apply(ReloadWatch *w, AccountStore *store, const AccountStore *incoming,
+                       const ReloadFileId *file, ReloadReport *report);
+
+#endif /* RELOAD_H */
@@ -0,0 +1,113 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      replica.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Log-shipping replication to a hot standby over a Unix or TCP socket.
+ *
+ *   Every persist on the primary is one commit. The records whose checksum
+ *   changed since the last commit are shipped as checksummed CSV lines
+ *   (account_format_csv), so a commit carries exactly the mutated accounts
+ *   (deposits, withdrawals, both legs of a transfer, lock and PIN-hash
+ *   changes). Frames, one per line:
+ *
+ *     primary -> standby   SNAP <count>     next <count> RECs replace the store
+ *                          REC <csv line>   insert or update one account
+ *                          COMMIT <seq>     apply everything since the last commit
+ *     standby -> primary   ACK <seq>
+ *
+ *   The standby applies a commit only when its COMMIT line arrives, so a
+ *   transfer is never half-applied there either. In synchronous mode the
+ *   primary waits for the ACK before the persist returns (and so before
+ *   the client sees the response); in asynchronous mode ACKs are only
+ *   used to measure lag.
+ *
+ *   A standby that is lost (gone, or too slow to acknowledge in sync mode)
+ *   is reconnected at the next commit after REPLICA_RETRY_MS, and sent a
+ *   full snapshot. Until then every replica_ship reports ATM_ERR_IO.
+ *
+ *   Addresses are "unix:<path>" or "<host>:<port>". Peers are not
+ *   authenticated: an empty host means the loopback interface, and only
+ *   "*:<port>" makes a standby listen on every interface.
+ */
+
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "common.h"
+#include "account.h"
+
+#include <stdio.h>
+
+#define REPLICA_SYNC_TIMEOUT_MS 5000
+#define REPLICA_RETRY_MS        1000  /* pause between attempts to reach a lost standby */
+#define REPLICA_ADDR_MAX        256
+#define REPLICA_LAG_WINDOW      1024u /* commits tracked for ack latency (power of two) */
+#define REPLICA_BUF_LEN         (64 * 1024)
+
+typedef struct {
+    uint64_t commits;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t snapshots;
+    uint64_t acks;
+    uint64_t ack_total_ns; /* send of COMMIT to receipt of its ACK */
+    uint64_t ack_max_ns;
+    uint64_t first_ns;     /* time of the first and last commit sent */
+    uint64_t last_ns;
+} ReplicaStats;
+
+typedef struct {
+    char         addr[REPLICA_ADDR_MAX]; /* standby address, empty if none */
+    int          fd;        /* -1 when not connected */
+    uint64_t     retry_ms;  /* earliest reconnect attempt (monotonic) */
+    int          sync;
+    uint64_t     seq;       /* last commit sent */
+    uint64_t     acked;     /* last commit acknowledged */
+    int          resync;    /* the next commit is a full snapshot */
+    uint32_t    *shipped;   /* record CRCs as last shipped, parallel to store.items */
+    size_t       shipped_len;
+    size_t       shipped_cap;
+    uint64_t     sent_ns[REPLICA_LAG_WINDOW];
+    ReplicaStats stats;
+    char         in[64];    /* partial ACK line */
+    size_t       in_len;
+} Replica;
+
+/* Primary side */
+void      replica_init(Replica *r);
+void      replica_close(Replica *r);
+
+/* Connects to a standby and ships the whole store as the first commit. */
+AtmStatus replica_connect(Replica *r, const char *addr, int sync, const AccountStore *store);
+
+/*
+ * Ships the records that changed since the previous commit. `crcs` holds
+ * the current CRC of every record (as returned by a save) or is NULL to
+ * compute them. Returns ATM_ERR_IO if the standby is gone, does not
+ * acknowledge in time (sync mode) or has not been reached again yet.
+ */
+AtmStatus replica_ship(Replica *r, const AccountStore *store, const uint32_t *crcs);
+
+/*
+ * Waits until the standby has acknowledged every commit sent (used by
+ * ship in sync mode, and at shutdown in async mode).
+ */
+AtmStatus replica_wait(Replica *r, int timeout_ms);
+
+/* Records were removed or reordered: send a full snapshot next time. */
+void      replica_mark_resync(Replica *r);
+
+void      replica_print_stats(const Replica *r, FILE *out);
+
+/*
+ * Standby side. Listens on `addr`, applies commits from the primary to
+ * `store`, and answers "STATUS" (-> "0 OK <seq> <records>") and "PROMOTE"
+ * lines on stdin. Returns ATM_OK with *promoted set after PROMOTE, or with
+ * *promoted clear at end of stdin; ATM_ERR_IO if `addr` cannot be bound.
+ */
+AtmStatus replica_standby_run(AccountStore *store, const char *addr, int *promoted);
+
+#endif /* REPLICA_H */
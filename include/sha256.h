@@ -0,0 +1,50 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      sha256.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Self-contained SHA-256 and PBKDF2-HMAC-SHA256, used for salted PIN
+ *   hashing. Includes a 4-lane variant that derives four independent keys
+ *   in lockstep, which keeps the CPU's execution units busy during bulk
+ *   rehashing.
+ */
+
+#ifndef SHA256_H
+#define SHA256_H
+
+#include "common.h"
+
+#define SHA256_DIGEST_LEN 32
+#define SHA256_BLOCK_LEN  64
+#define SHA256_LANES      4
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;                 /* bytes processed */
+    uint8_t  buffer[SHA256_BLOCK_LEN];
+    size_t   used;
+} Sha256;
+
+void sha256_init(Sha256 *ctx);
+void sha256_update(Sha256 *ctx, const void *data, size_t len);
+void sha256_final(Sha256 *ctx, uint8_t out[SHA256_DIGEST_LEN]);
+
+/* PBKDF2-HMAC-SHA256 producing one 32-byte block. */
+void pbkdf2_sha256(const void *password, size_t password_len,
+                   const uint8_t *salt, size_t salt_len,
+                   uint32_t iterations, uint8_t out[SHA256_DIGEST_LEN]);
+
+/*
+ * Four independent PBKDF2-HMAC-SHA256 derivations with the same iteration
+ * count, computed in interleaved lanes. Equivalent to four calls of
+ * pbkdf2_sha256.
+ */
+void pbkdf2_sha256_x4(const void *const passwords[SHA256_LANES],
+                      const size_t password_lens[SHA256_LANES],
+                      const uint8_t *const salts[SHA256_LANES],
+                      size_t salt_len, uint32_t iterations,
+                      uint8_t out[SHA256_LANES][SHA256_DIGEST_LEN]);
+
+#endif /* SHA256_H */
@@ -0,0 +1,130 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      shmview.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Shared-memory balance view. With SHMVIEW_ENV=<path> set (normally a
+ *   file under /dev/shm), the ATM process maps <path> and publishes every
+ *   account's ID, balance and lock flag there after each load, save and
+ *   hot reload. Balance displays and monitoring scripts map the same
+ *   file read-only through the reader half of this module and never
+ *   touch the database.
+ *
+ *   Segment layout (one writer, any number of readers):
+ *
+ *     ShmViewHeader
+ *     index     index_slots words: CRC32C(id) << 32 | record position + 1
+ *     records   ShmViewRecord[capacity], in store order
+ *
+ *   Every record carries a sequence lock: the writer makes `seq` odd,
+ *   updates the record and makes it even again; a reader copies the
+ *   record and retries if `seq` was odd or changed meanwhile. Readers take
+ *   no locks and never block the writer. Records only change position when
+ *   accounts are removed, compacted or replace a tombstone; the writer
+ *   then rebuilds the index under the header's `index_seq`, which
+ *   lookups check the same way. A store that outgrows the capacity is
+ *   published in a new segment renamed over <path>; the old one is marked
+ *   retired and readers re-attach by path.
+ *
+ *   The view shows the in-memory store as of the last save or reload.
+ *   `updated_ms` stops advancing when the writer exits; the file is left
+ *   in place. POSIX only.
+ */
+
+#ifndef SHMVIEW_H
+#define SHMVIEW_H
+
+#include "common.h"
+#include "account.h"
+
+#include <stdatomic.h>
+
+#define SHMVIEW_ENV         "ATM_SHM_VIEW"
+#define SHMVIEW_MAGIC       "ATMVIEW"   /* with its NUL: 8 bytes */
+#define SHMVIEW_VERSION     1u
+#define SHMVIEW_MIN_RECORDS 1024u
+#define SHMVIEW_ID_WORDS    (MAX_ACCOUNT_ID_LEN / 8)
+#define SHMVIEW_MAX_SPINS   (1u << 20)  /* reader retries before giving up */
+
+typedef struct {
+    char             magic[8];
+    uint32_t         version;
+    uint32_t         record_size;
+    uint64_t         capacity;       /* records */
+    uint64_t         index_slots;    /* power of two */
+    uint64_t         index_offset;   /* bytes from the start of the segment */
+    uint64_t         records_offset;
+    uint64_t         writer_pid;
+    _Atomic uint64_t count;          /* records published */
+    _Atomic uint64_t index_seq;      /* odd while records move and the index is rebuilt */
+    _Atomic uint64_t updated_ms;     /* wall clock of the last publish */
+    _Atomic uint64_t publishes;
+    _Atomic uint64_t retired;        /* a newer segment was renamed over the path */
+} ShmViewHeader;
+
+typedef struct {
+    _Atomic uint64_t seq;            /* odd while the writer updates the record */
+    _Atomic uint64_t id[SHMVIEW_ID_WORDS]; /* NUL-padded account ID */
+    _Atomic int64_t  cents;
+    _Atomic int64_t  is_locked;      /* as in Account: ACCOUNT_CLOSED for a tombstone */
+} ShmViewRecord;
+
+/* Writer side, owned by AtmContext. Disabled (hdr NULL) unless opened. */
+typedef struct {
+    char           path[MAX_DB_PATH_LEN];
+    ShmViewHeader *hdr;
+    size_t         map_len;
+    uint32_t      *crcs;     /* record CRCs as last published, when known */
+    size_t         crcs_len;
+    size_t         crcs_cap;
+} ShmView;
+
+void      shmview_init(ShmView *v);
+
+/* Creates the segment at `path` (replacing any old one) and publishes `store`. */
+AtmStatus shmview_open(ShmView *v, const char *path, const AccountStore *store);
+void      shmview_close(ShmView *v);
+
+/*
+ * Updates the records that differ from `store`. With `crcs` (the store's
+ * record CRCs, as for replica_ship), only records whose CRC changed since
+ * the last publish are compared; without, every record is. Failing to
+ * grow the segment leaves the last published values in place.
+ */
+AtmStatus shmview_publish(ShmView *v, const AccountStore *store, const uint32_t *crcs);
+
+/* Reader side: read-only client, needs only this module and crc32c. */
+typedef struct {
+    char                 path[MAX_DB_PATH_LEN];
+    const ShmViewHeader *hdr;
+    size_t               map_len;
+    uint64_t             retries;    /* seqlock retries seen, for diagnostics */
+} ShmViewReader;
+
+/* A consistent copy of one record. */
+typedef struct {
+    char    id[MAX_ACCOUNT_ID_LEN];
+    int64_t cents;
+    int     is_locked;
+} ShmViewBalance;
+
+/* Maps `path` read-only. ATM_ERR_IO if it cannot, ATM_ERR_PARSE if it is not a view. */
+AtmStatus shmview_attach(ShmViewReader *r, const char *path);
+void      shmview_detach(ShmViewReader *r);
+
+/*
+ * Looks `account_id` up. ATM_ERR_NOT_FOUND if it is unknown or closed;
+ * ATM_ERR_IO if the writer stopped in the middle of an update.
+ */
+AtmStatus shmview_get(ShmViewReader *r, const char *account_id, ShmViewBalance *out);
+
+/*
+ * Reads the record at `pos` (0 .. shmview_count - 1), for listing every
+ * account. Tombstones come back with is_locked == ACCOUNT_CLOSED.
+ */
+size_t    shmview_count(ShmViewReader *r);
+AtmStatus shmview_at(ShmViewReader *r, size_t pos, ShmViewBalance *out);
+
+#endif /* SHMVIEW_H */
@@ -0,0 +1,74 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      snapshot.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Compact archival snapshots of the account store.
+ *
+ *   A snapshot is a binary file (little-endian, LEB128 varints):
+ *
+ *     "ATMSNAP\0"  version  kind  created_ms  records
+ *     [base_name_len base_name base_crc32c]          (delta snapshots)
+ *     op*                                            (edit script)
+ *     crc32c of everything above                     (4 bytes)
+ *
+ *   The body is an edit script against a base snapshot; a full snapshot
+ *   is one INSERT run against an empty base. Each op is a varint
+ *   (run << 2 | kind): KEEP copies `run` base records, SKIP drops them,
+ *   CHANGE rewrites the next `run` base records and INSERT adds `run` new
+ *   ones. A record is a varint mask of the fields that differ from the
+ *   base record (an empty account for INSERT) followed by those fields,
+ *   generated from ACCOUNT_FIELDS:
+ *
+ *     id          front-coded against the previous ID in the file
+ *     STR         words, each a dictionary reference or a new literal
+ *     MONEY       zigzag varint of the change in cents
+ *     U32 / UINT  varint;  FLAG  zigzag varint;  HEX  raw bytes
+ *
+ *   A delta names its base by file name; the base must stay in the same
+ *   directory as the delta, and its checksum is verified on restore.
+ *   Stores whose surviving records changed order are written in full.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "common.h"
+#include "account.h"
+
+#define SNAPSHOT_MAGIC     "ATMSNAP"  /* with its NUL: 8 bytes */
+#define SNAPSHOT_VERSION   1u
+#define SNAPSHOT_MAX_CHAIN 1024       /* deltas between a restore and its full base */
+
+typedef struct {
+    int      delta;      /* written against a base */
+    uint64_t created_ms; /* wall clock, ms since the Unix epoch */
+    size_t   records;    /* accounts in the snapshot */
+    size_t   kept;       /* relative to the base (all inserted for a full snapshot) */
+    size_t   changed;
+    size_t   inserted;
+    size_t   removed;
+    size_t   bytes;      /* file size */
+    size_t   chain;      /* snapshots read to restore this one (restore only) */
+    char     base[MAX_DB_PATH_LEN]; /* base file name, "" for a full snapshot */
+} SnapshotInfo;
+
+/*
+ * Writes `store` to `path` as a delta against the snapshot `base_path`,
+ * or in full when `base_path` is NULL (or the records were reordered).
+ * `info` is optional.
+ */
+AtmStatus snapshot_write(const AccountStore *store, const char *path,
+                         const char *base_path, SnapshotInfo *info);
+
+/*
+ * Replaces the contents of `store` (initialized by the caller) with the
+ * snapshot at `path`, following its chain of bases. Returns ATM_ERR_CHECKSUM
+ * if any file in the chain is damaged or a base was replaced, ATM_ERR_PARSE
+ * if one is malformed. `info` (optional) describes `path` itself.
+ */
+AtmStatus snapshot_restore(const char *path, AccountStore *store, SnapshotInfo *info);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,73 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      throttle.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Time-based login throttling in front of auth_verify_login. Failed
+ *   attempts are counted per account and per source (terminal), and each
+ *   key backs off exponentially once it exceeds its free allowance.
+ *   Rejected attempts are answered from memory, without a store lookup
+ *   or a persist.
+ *
+ *   State lives in a fixed-size, set-associative table; idle entries are
+ *   retired by a hashed timing wheel, so memory use is constant no matter
+ *   how many distinct IDs an attacker cycles through.
+ */
+
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include "common.h"
+
+#define THROTTLE_CAPACITY    4096u  /* tracked keys (power of two) */
+#define THROTTLE_WAYS        4u     /* associativity of the key table */
+#define THROTTLE_WHEEL_SLOTS 256u   /* timing wheel buckets (power of two) */
+#define THROTTLE_TICK_MS     1000u  /* timing wheel granularity */
+
+typedef struct {
+    unsigned account_free_failures; /* failures allowed before backoff starts */
+    unsigned source_free_failures;
+    uint64_t base_delay_ms;         /* first backoff window */
+    uint64_t max_delay_ms;          /* backoff cap */
+    uint64_t forget_after_ms;       /* idle time after which a key is dropped */
+} ThrottleConfig;
+
+typedef struct {
+    uint64_t key;          /* 0 = free slot */
+    uint64_t blocked_until;
+    uint64_t expires_at;
+    uint32_t failures;
+    uint32_t wheel_next;   /* 1-based entry index within the wheel bucket list, 0 = end */
+    uint32_t wheel_prev;
+    uint32_t wheel_slot;
+} ThrottleEntry;
+
+typedef struct {
+    ThrottleConfig config;
+    ThrottleEntry *entries;                    /* THROTTLE_CAPACITY */
+    uint32_t       wheel[THROTTLE_WHEEL_SLOTS];/* bucket heads, 1-based, 0 = empty */
+    uint64_t       wheel_tick;                 /* last tick processed */
+    size_t         active;                     /* occupied entries */
+} Throttle;
+
+/* Fills `config` with the defaults used when throttle_init gets NULL. */
+void      throttle_default_config(ThrottleConfig *config);
+
+AtmStatus throttle_init(Throttle *t, const ThrottleConfig *config);
+void      throttle_free(Throttle *t);
+
+/*
+ * Returns ATM_ERR_THROTTLED if either key is inside a backoff window
+ * (with the remaining time in *retry_after_ms, if non-NULL), else ATM_OK.
+ * `source` may be NULL when the caller has no terminal identity.
+ */
+AtmStatus throttle_check(Throttle *t, const char *account_id, const char *source,
+                         uint64_t now_ms, uint64_t *retry_after_ms);
+
+/* Records the outcome of an attempt that passed throttle_check. */
+void      throttle_record(Throttle *t, const char *account_id, const char *source,
+                          uint64_t now_ms, int success);
+
+#endif /* THROTTLE_H */
@@ -0,0 +1,26 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      timeutil.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Monotonic clock helpers (unaffected by wall-clock changes), plus the
+ *   wall clock for timestamps that are stored or shown to people.
+ */
+
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+
+#include "common.h"
+
+uint64_t time_monotonic_ns(void);
+uint64_t time_monotonic_ms(void);
+
+/* Wall clock: milliseconds since the Unix epoch (0 if unavailable). */
+uint64_t time_wall_ms(void);
+
+/* Sleeps until time_monotonic_ns() reaches `deadline_ns` (returns at once if past). */
+void     time_sleep_until_ns(uint64_t deadline_ns);
+
+#endif /* TIMEUTIL_H */
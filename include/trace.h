@@ -0,0 +1,105 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      trace.h
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Always-on event tracing into a per-process ring buffer of fixed-size
+ *   binary events. Recording an event is one atomic increment, one
+ *   timestamp read and a 16-byte store: no locks, no allocation, no I/O.
+ *   The newest TRACE_CAPACITY events are kept.
+ *
+ *   Timestamps are raw TSC ticks on x86 (GCC/Clang), the monotonic clock
+ *   in nanoseconds elsewhere. A dump carries two (ticks, ns) reference
+ *   points, taken at trace_init and at the dump, from which the decoder
+ *   derives the tick rate; this assumes an invariant TSC, which every
+ *   x86 CPU of the last decade provides.
+ *
+ *   The buffer is written to a file on demand (SIGUSR1) and at exit when
+ *   ATM_TRACE names a file. `atm_cli trace <file>` decodes a dump into a
+ *   timeline and a per-phase latency breakdown. Building with
+ *   -DATM_NO_TRACE compiles every trace point out.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "common.h"
+
+#include <stdio.h>
+
+#define TRACE_CAPACITY   65536u            /* events kept (power of two): 1 MiB */
+#define TRACE_MAGIC      "ATMTRACE"
+#define TRACE_VERSION    2u
+#define TRACE_ENV        "ATM_TRACE"       /* dump file; also enables dump at exit */
+#define TRACE_DEFAULT_FILE "atm_trace.bin" /* SIGUSR1 target when ATM_TRACE is unset */
+
+/* What a BEGIN/END pair measures. */
+typedef enum {
+    TRACE_LOGIN = 1, /* whole login attempt (throttle, find, auth, persist) */
+    TRACE_FIND,      /* account lookup: arg = 1 if found */
+    TRACE_AUTH,      /* PIN verification (KDF) */
+    TRACE_TXN,       /* deposit / withdrawal / transfer: arg = TraceTxnKind */
+    TRACE_PERSIST,   /* save: arg = records */
+    TRACE_RELOAD,    /* hot reload merge: arg = records changed */
+    TRACE_REPLICATE, /* ship a commit to the standby */
+    TRACE_SESSION,   /* interactive session, login to logout */
+    TRACE_PHASE_COUNT
+} TracePhase;
+
+typedef enum {
+    TRACE_BEGIN = 1,
+    TRACE_END
+} TraceKind;
+
+typedef enum {
+    TRACE_TXN_DEPOSIT = 1,
+    TRACE_TXN_WITHDRAW,
+    TRACE_TXN_TRANSFER
+} TraceTxnKind;
+
+/* On-disk and in-memory event (16 bytes). */
+typedef struct {
+    uint64_t ticks;   /* timestamp, see above */
+    uint8_t  phase;   /* TracePhase */
+    uint8_t  kind;    /* TraceKind */
+    uint16_t status;  /* AtmStatus (END events) */
+    uint32_t arg;
+} TraceEvent;
+
+/* Dump file header, followed by TRACE_CAPACITY events in ring order. */
+typedef struct {
+    char     magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t capacity;
+    uint32_t pid;
+    uint64_t head;    /* events recorded so far; slot = index % capacity */
+    uint64_t ref_ticks[2];
+    uint64_t ref_ns[2];
+} TraceHeader;
+
+#ifndef ATM_NO_TRACE
+void trace_record(TracePhase phase, TraceKind kind, AtmStatus status, uint32_t arg);
+#  define TRACE_BEGIN_EVENT(phase, arg)       trace_record((phase), TRACE_BEGIN, ATM_OK, (uint32_t)(arg))
+#  define TRACE_END_EVENT(phase, status, arg) trace_record((phase), TRACE_END, (status), (uint32_t)(arg))
+#else
+#  define TRACE_BEGIN_EVENT(phase, arg)       ((void)(phase), (void)(arg))
+#  define TRACE_END_EVENT(phase, status, arg) ((void)(phase), (void)(status), (void)(arg))
+#endif
+
+/*
+ * Reads ATM_TRACE and installs the SIGUSR1 handler (POSIX only). Call
+ * once at startup; trace_shutdown writes the exit dump if requested.
+ */
+void      trace_init(void);
+void      trace_shutdown(void);
+
+/* Writes the current buffer to `path`. */
+AtmStatus trace_dump(const char *path);
+
+/* Decodes a dump: timeline (if `timeline`) and per-phase latencies. */
+AtmStatus trace_decode(const char *path, FILE *out, int timeline);
+
+#endif /* TRACE_H */
@@ -0,0 +1,41 @@
+#!/bin/sh
+# Project:   Command-Line ATM Interface
+# File:      bench_protocol.sh
+# Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+# License:   MIT
+#
+# Pipes N protocol commands (default 1,000,000) through `atm_cli protocol`
+# against a scratch database and reports operations per second.
+#
+# Usage: scripts/bench_protocol.sh [num_commands] [atm_cli_binary]
+
+set -eu
+
+N=${1:-1000000}
+BIN=${2:-./atm_cli}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# PIN "1234" hashes to 4257489661 with the demo FNV-1a hash.
+printf '1001,Bench User,1000000.00,4257489661,0,0\n' > "$WORK/bench.db"
+
+# Mix: 1 login per 100 commands, otherwise balance/deposit/withdraw.
+awk -v n="$N" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        m = i % 100
+        if (m == 0)      print "LOGIN 1001 1234"
+        else if (m % 3 == 0) print "DEP 1.00"
+        else if (m % 3 == 1) print "WDR 1.00"
+        else             print "BAL"
+    }
+}' > "$WORK/commands.txt"
+
+start=$(date +%s.%N)
+"$BIN" protocol "$WORK/bench.db" < "$WORK/commands.txt" > "$WORK/responses.txt"
+end=$(date +%s.%N)
+
+lines=$(wc -l < "$WORK/responses.txt")
+awk -v s="$start" -v e="$end" -v n="$N" -v r="$lines" 'BEGIN {
+    t = e - s
+    printf "commands: %d  responses: %d  time: %.3f s  ops/sec: %.0f\n", n, r, t, n / t
+}'
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Project:   Command-Line ATM Interface
+# File:      repl_load.sh
+# Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+# License:   MIT
+#
+# Replication under load: starts a standby on a Unix socket, pipes N
+# protocol commands (default 200,000) over A accounts (default 10,000)
+# through a primary replicating to it (async, then sync), and prints the
+# primary's replication stats (commits, records, ack latency, records/s).
+# After each run the standby is promoted and its database is compared
+# with the primary's.
+#
+# Usage: scripts/repl_load.sh [num_commands] [accounts] [atm_cli_binary]
+
+set -eu
+
+N=${1:-200000}
+A=${2:-10000}
+BIN=${3:-./atm_cli}
+WORK=$(mktemp -d)
+trap 'exec 7>&- 2>/dev/null || true; rm -rf "$WORK"' EXIT
+
+# PIN "1234" hashes to 4257489661 with the demo FNV-1a hash.
+awk -v a="$A" 'BEGIN {
+    for (i = 0; i < a; i++)
+        printf "%d,Load User,1000.00,4257489661,0,0\n", 100000 + i
+}' > "$WORK/seed.db"
+
+# One login per 1000 commands (each login runs the deliberately slow
+# KDF); transfers spread the changes over all accounts.
+awk -v n="$N" -v a="$A" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        m = i % 3
+        if (i % 1000 == 0) printf "LOGIN %d 1234\n", 100000 + (i / 1000) % a
+        else if (m == 0)   print "DEP 1.00"
+        else if (m == 1)   print "WDR 1.00"
+        else               printf "XFR %d 0.50\n", 100000 + (i * 7) % a
+    }
+}' > "$WORK/commands.txt"
+
+for mode in async sync; do
+    cp "$WORK/seed.db" "$WORK/primary.db"
+    rm -f "$WORK/standby.db" "$WORK/fifo"
+    mkfifo "$WORK/fifo"
+
+    "$BIN" standby "$WORK/standby.db" "unix:$WORK/repl.sock" \
+        < "$WORK/fifo" > "$WORK/standby.out" 2> "$WORK/standby.err" &
+    exec 7> "$WORK/fifo"
+    while [ ! -S "$WORK/repl.sock" ]; do sleep 0.05; done
+
+    flag=""
+    [ "$mode" = sync ] && flag="--sync"
+
+    start=$(date +%s.%N)
+    "$BIN" protocol "$WORK/primary.db" --replica "unix:$WORK/repl.sock" $flag \
+        < "$WORK/commands.txt" > /dev/null 2> "$WORK/primary.err"
+    end=$(date +%s.%N)
+
+    grep '^replication' "$WORK/primary.err"
+    awk -v s="$start" -v e="$end" -v n="$N" 'BEGIN {
+        printf "  commands: %d  time: %.3f s  ops/sec: %.0f\n", n, e - s, n / (e - s)
+    }'
+
+    echo PROMOTE >&7
+    exec 7>&-
+    wait
+    if cmp -s "$WORK/primary.db" "$WORK/standby.db"; then
+        echo "  promoted standby matches primary"
+    else
+        echo "  promoted standby DIFFERS from primary"
+    fi
+done
@@ -0,0 +1,50 @@
+#!/bin/sh
+# Project:   Command-Line ATM Interface
+# File:      stuffing_load.sh
+# Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+# License:   MIT
+#
+# Simulates a credential-stuffing burst: N wrong-PIN logins (default
+# 200,000) spread over A accounts and S terminals, piped through
+# `atm_cli protocol`. Reports the response mix (throttled vs. checked
+# against the store) and the throughput.
+#
+# Usage: scripts/stuffing_load.sh [attempts] [accounts] [sources] [atm_cli_binary]
+
+set -eu
+
+N=${1:-200000}
+A=${2:-10000}
+S=${3:-50}
+BIN=${4:-./atm_cli}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+# PIN "1234" hashes to 4257489661 with the demo FNV-1a hash.
+awk -v a="$A" 'BEGIN {
+    for (i = 0; i < a; i++)
+        printf "%d,Load User,100.00,4257489661,0,0\n", 100000 + i
+}' > "$WORK/load.db"
+
+# Each terminal sends a run of attempts, cycling through account IDs
+# (plus some that do not exist) with a wrong PIN.
+awk -v n="$N" -v a="$A" -v s="$S" 'BEGIN {
+    per = int(n / s); if (per < 1) per = 1
+    for (i = 0; i < n; i++) {
+        if (i % per == 0) printf "SRC term%d\n", int(i / per) % s
+        id = 100000 + (i * 7919) % (a + a / 10)
+        printf "LOGIN %d 0000\n", id
+    }
+}' > "$WORK/commands.txt"
+
+start=$(date +%s.%N)
+"$BIN" protocol "$WORK/load.db" < "$WORK/commands.txt" > "$WORK/responses.txt"
+end=$(date +%s.%N)
+
+awk -v s="$start" -v e="$end" '
+    $2 != "OK" { count[$2]++; total++ }
+    END {
+        t = e - s
+        for (k in count) printf "%-24s %d\n", k, count[k]
+        printf "attempts: %d  time: %.3f s  attempts/sec: %.0f\n", total, t, total / t
+    }' "$WORK/responses.txt"
@@ -0,0 +1,68 @@
+#!/bin/sh
+# Project:   Command-Line ATM Interface
+# File:      view_load.sh
+# Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+# License:   MIT
+#
+# Shared-memory view under load: publishes A accounts (default 10,000)
+# from a protocol-mode writer that keeps applying deposits, withdrawals
+# and transfers, and meanwhile runs R reader processes (default 2), each
+# doing random balance lookups for S seconds (default 5). Prints every
+# reader's lookups/s and seqlock retries, and the writer's throughput.
+#
+# Usage: scripts/view_load.sh [accounts] [readers] [seconds] [atm_cli_binary]
+
+set -eu
+
+A=${1:-10000}
+R=${2:-2}
+S=${3:-5}
+BIN=${4:-./atm_cli}
+WORK=$(mktemp -d)
+VIEW=/dev/shm/atm_view_load.$$
+trap 'rm -rf "$WORK" "$VIEW" "$VIEW.tmp"' EXIT
+
+# PIN "1234" hashes to 4257489661 with the demo FNV-1a hash.
+awk -v a="$A" 'BEGIN {
+    for (i = 0; i < a; i++)
+        printf "%d,Load User,1000.00,4257489661,0,0\n", 100000 + i
+}' > "$WORK/accounts.db"
+
+# Enough commands to keep the writer busy past the readers' window.
+awk -v a="$A" 'BEGIN {
+    for (i = 0; i < 2000000; i++) {
+        m = i % 3
+        if (i % 1000 == 0) printf "LOGIN %d 1234\n", 100000 + (i / 1000) % a
+        else if (m == 0)   print "DEP 1.00"
+        else if (m == 1)   print "WDR 1.00"
+        else               printf "XFR %d 0.50\n", 100000 + (i * 7) % a
+    }
+}' > "$WORK/commands.txt"
+
+start=$(date +%s.%N)
+ATM_SHM_VIEW="$VIEW" "$BIN" protocol "$WORK/accounts.db" \
+    < "$WORK/commands.txt" > "$WORK/writer.out" 2> "$WORK/writer.err" &
+writer=$!
+while [ ! -f "$VIEW" ]; do sleep 0.05; done
+
+readers=""
+i=0
+while [ "$i" -lt "$R" ]; do
+    "$BIN" view "$VIEW" --bench "$S" > "$WORK/reader.$i" &
+    readers="$readers $!"
+    i=$((i + 1))
+done
+wait $readers
+kill "$writer" 2>/dev/null || true
+wait "$writer" 2>/dev/null || true
+end=$(date +%s.%N)
+
+i=0
+while [ "$i" -lt "$R" ]; do
+    printf "reader %d: " "$i"
+    cat "$WORK/reader.$i"
+    i=$((i + 1))
+done
+awk -v s="$start" -v e="$end" 'END {
+    printf "writer: %d responses in %.2f s while readers ran\n", NR, e - s
+}' "$WORK/writer.out"
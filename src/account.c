@@ -9,6 +9,9 @@
  */
 
 #include "account.h"
+#include "account_codec.h"
+#include "crc32c.h"
+#include "fileio.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,9 +35,13 @@ static AtmStatus account_store_reserve(AccountStore *store, size_t new_capacity)
 AtmStatus account_store_init(AccountStore *store) {
     if (!store) return ATM_ERR_INTERNAL;
 
-    store->items    = NULL;
-    store->size     = 0;
-    store->capacity = 0;
+    store->items      = NULL;
+    store->size       = 0;
+    store->capacity   = 0;
+    store->free_slots = NULL;
+    store->free_len   = 0;
+    store->free_cap   = 0;
+    store->free_built = 0;
 
     return ATM_OK;
 }
@@ -42,9 +49,8 @@ AtmStatus account_store_init(AccountStore *store) {
 void account_store_free(AccountStore *store) {
     if (!store) return;
     free(store->items);
-    store->items    = NULL;
-    store->size     = 0;
-    store->capacity = 0;
+    free(store->free_slots);
+    account_store_init(store);
 }
 
 Account *account_store_find(AccountStore *store, const char *account_id) {
@@ -52,12 +58,301 @@ Account *account_store_find(AccountStore *store, const char *account_id) {
 
     for (size_t i = 0; i < store->size; ++i) {
         if (strncmp(store->items[i].id, account_id, MAX_ACCOUNT_ID_LEN) == 0) {
-            return &store->items[i];
+            return account_is_closed(&store->items[i]) ? NULL : &store->items[i];
         }
     }
     return NULL;
 }
 
+int account_is_closed(const Account *account) {
+    return account && account->is_locked == ACCOUNT_CLOSED;
+}
+
+static AtmStatus account_free_push(AccountStore *store, size_t slot) {
+    if (store->free_len == store->free_cap) {
+        size_t  new_cap = store->free_cap ? store->free_cap * 2 : 64;
+        size_t *slots   = realloc(store->free_slots, new_cap * sizeof(*slots));
+        if (!slots) {
+            return ATM_ERR_INTERNAL;
+        }
+        store->free_slots = slots;
+        store->free_cap   = new_cap;
+    }
+    store->free_slots[store->free_len++] = slot;
+    return ATM_OK;
+}
+
+/*
+ * Pops the most recently closed slot that is still a tombstone. Entries go
+ * stale when records move (reload, compaction) and are simply skipped.
+ */
+static int account_free_pop(AccountStore *store, size_t *slot) {
+    if (!store->free_built) {
+        store->free_len   = 0;
+        store->free_built = 1;
+        for (size_t i = 0; i < store->size; ++i) {
+            if (account_is_closed(&store->items[i]) && account_free_push(store, i) != ATM_OK) {
+                store->free_built = 0; /* retried on the next call */
+                break;
+            }
+        }
+    }
+    while (store->free_len > 0) {
+        size_t i = store->free_slots[--store->free_len];
+        if (i < store->size && account_is_closed(&store->items[i])) {
+            *slot = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+AtmStatus account_open(AccountStore *store, const Account *account, size_t *slot) {
+    if (!store || !account || account_is_closed(account)) return ATM_ERR_INTERNAL;
+
+    /* One pass finds a live duplicate, or the ID's own tombstone. */
+    size_t i = 0;
+    while (i < store->size &&
+           strncmp(store->items[i].id, account->id, MAX_ACCOUNT_ID_LEN) != 0) {
+        i++;
+    }
+    if (i < store->size && !account_is_closed(&store->items[i])) {
+        return ATM_ERR_CONFLICT;
+    }
+
+    if (i < store->size || account_free_pop(store, &i)) {
+        store->items[i] = *account;
+    } else {
+        AtmStatus st = account_store_append(store, account);
+        if (st != ATM_OK) {
+            return st;
+        }
+    }
+    if (slot) {
+        *slot = i;
+    }
+    return ATM_OK;
+}
+
+/* Sort key for bulk opens: the NUL-padded ID as big-endian words, so integer order is strcmp order. */
+#define ACCOUNT_KEY_WORDS ((MAX_ACCOUNT_ID_LEN + 7) / 8)
+
+typedef struct {
+    uint64_t w[ACCOUNT_KEY_WORDS];
+    size_t   pos;   /* index into the batch or the store */
+    size_t   slot;  /* batch only: own tombstone, or SIZE_MAX */
+} AccountKey;
+
+static void account_key_make(AccountKey *key, const char *id, size_t pos) {
+    uint8_t bytes[ACCOUNT_KEY_WORDS * 8] = {0};
+    size_t  len = 0;
+    while (len < MAX_ACCOUNT_ID_LEN && id[len] != '\0') {
+        bytes[len] = (uint8_t)id[len];
+        len++;
+    }
+    for (size_t w = 0; w < ACCOUNT_KEY_WORDS; ++w) {
+        uint64_t v = 0;
+        for (size_t b = 0; b < 8; ++b) {
+            v = (v << 8) | bytes[w * 8 + b];
+        }
+        key->w[w] = v;
+    }
+    key->pos  = pos;
+    key->slot = SIZE_MAX;
+}
+
+static int account_key_cmp_id(const AccountKey *a, const AccountKey *b) {
+    for (size_t w = 0; w < ACCOUNT_KEY_WORDS; ++w) {
+        if (a->w[w] != b->w[w]) {
+            return a->w[w] < b->w[w] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* By ID, then position: the first of several equal IDs sorts first. */
+static int account_key_cmp(const void *pa, const void *pb) {
+    const AccountKey *a = (const AccountKey *)pa;
+    const AccountKey *b = (const AccountKey *)pb;
+    int c = account_key_cmp_id(a, b);
+    if (c != 0) {
+        return c;
+    }
+    return (a->pos > b->pos) - (a->pos < b->pos);
+}
+
+size_t account_open_batch(AccountStore *store, const Account *accounts, size_t count,
+                          AtmStatus *results, size_t *slots) {
+    if (!store || !accounts || !results) return 0;
+
+    size_t n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i] == ATM_OK && account_is_closed(&accounts[i])) {
+            results[i] = ATM_ERR_INTERNAL;
+        }
+        n += (results[i] == ATM_OK);
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    AccountKey *in   = malloc(n * sizeof(*in));
+    AccountKey *have = malloc((store->size ? store->size : 1) * sizeof(*have));
+    if (!in || !have) {
+        free(in);
+        free(have);
+        for (size_t i = 0; i < count; ++i) {
+            if (results[i] == ATM_OK) results[i] = ATM_ERR_INTERNAL;
+        }
+        return 0;
+    }
+
+    n = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i] == ATM_OK) {
+            account_key_make(&in[n++], accounts[i].id, i);
+        }
+    }
+    for (size_t i = 0; i < store->size; ++i) {
+        account_key_make(&have[i], store->items[i].id, i);
+    }
+    qsort(in, n, sizeof(*in), account_key_cmp);
+    qsort(have, store->size, sizeof(*have), account_key_cmp);
+
+    /*
+     * One merge pass over both sorted lists. Accepted entries are packed
+     * to the front of `in`; tombstones not reopened by their own ID are
+     * packed to the front of `have` (never ahead of the read position).
+     */
+    size_t accepted = 0, tombs = 0, homeless = 0, j = 0;
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = in[k].pos;
+        if (k > 0 && account_key_cmp_id(&in[k - 1], &in[k]) == 0) {
+            results[i] = ATM_ERR_CONFLICT;
+            continue;
+        }
+        while (j < store->size && account_key_cmp_id(&have[j], &in[k]) < 0) {
+            if (account_is_closed(&store->items[have[j].pos])) {
+                have[tombs++] = have[j];
+            }
+            j++;
+        }
+        size_t own  = SIZE_MAX;
+        int    live = 0;
+        while (j < store->size && account_key_cmp_id(&have[j], &in[k]) == 0) {
+            if (!account_is_closed(&store->items[have[j].pos])) {
+                live = 1;
+            } else if (own == SIZE_MAX) {
+                own = have[j].pos;
+            } else {
+                have[tombs++] = have[j];
+            }
+            j++;
+        }
+        if (live) {
+            results[i] = ATM_ERR_CONFLICT;
+            if (own != SIZE_MAX) {
+                have[tombs++].pos = own;
+            }
+            continue;
+        }
+        in[k].slot     = own;
+        in[accepted++] = in[k];
+        homeless      += (own == SIZE_MAX);
+    }
+    for (; j < store->size; ++j) {
+        if (account_is_closed(&store->items[have[j].pos])) {
+            have[tombs++] = have[j];
+        }
+    }
+
+    size_t appended = (homeless > tombs) ? homeless - tombs : 0;
+    if (account_store_reserve(store, store->size + appended) != ATM_OK) {
+        for (size_t k = 0; k < accepted; ++k) {
+            results[in[k].pos] = ATM_ERR_INTERNAL;
+        }
+        accepted = 0;
+    }
+
+    size_t next_tomb = 0;
+    for (size_t k = 0; k < accepted; ++k) {
+        size_t slot = in[k].slot;
+        if (slot == SIZE_MAX) {
+            slot = (next_tomb < tombs) ? have[next_tomb++].pos : store->size++;
+        }
+        store->items[slot] = accounts[in[k].pos];
+        if (slots) {
+            slots[in[k].pos] = slot;
+        }
+    }
+
+    free(in);
+    free(have);
+    return accepted;
+}
+
+AtmStatus account_close(AccountStore *store, const char *account_id) {
+    Account *acc = account_store_find(store, account_id);
+    if (!acc) {
+        return ATM_ERR_NOT_FOUND;
+    }
+    if (acc->balance != 0.0) {
+        return ATM_ERR_INVALID_AMOUNT;
+    }
+
+    Account tomb;
+    memset(&tomb, 0, sizeof(tomb));
+    memcpy(tomb.id, acc->id, sizeof(tomb.id));
+    memcpy(tomb.holder_name, acc->holder_name, sizeof(tomb.holder_name));
+    tomb.is_locked = ACCOUNT_CLOSED;
+    *acc           = tomb;
+
+    /* Without a scan yet, the first account_open finds this slot anyway. */
+    if (store->free_built && account_free_push(store, (size_t)(acc - store->items)) != ATM_OK) {
+        store->free_built = 0;
+    }
+    return ATM_OK;
+}
+
+size_t account_store_closed(const AccountStore *store) {
+    size_t n = 0;
+    for (size_t i = 0; store && i < store->size; ++i) {
+        n += account_is_closed(&store->items[i]);
+    }
+    return n;
+}
+
+size_t account_store_compact(AccountStore *store) {
+    if (!store) return 0;
+
+    size_t k = 0;
+    for (size_t i = 0; i < store->size; ++i) {
+        if (!account_is_closed(&store->items[i])) {
+            store->items[k++] = store->items[i];
+        }
+    }
+    size_t dropped    = store->size - k;
+    store->size       = k;
+    store->free_len   = 0;
+    store->free_built = 1; /* no tombstones left */
+    return dropped;
+}
+
+AtmStatus account_store_append(AccountStore *store, const Account *account) {
+    if (!store || !account) return ATM_ERR_INTERNAL;
+
+    if (store->size == store->capacity) {
+        size_t new_cap = (store->capacity == 0) ? 8 : store->capacity * 2;
+        AtmStatus st   = account_store_reserve(store, new_cap);
+        if (st != ATM_OK) {
+            return st;
+        }
+    }
+
+    store->items[store->size++] = *account;
+    return ATM_OK;
+}
+
 AtmStatus account_store_load(AccountStore *store, const char *path) {
     if (!store || !path) return ATM_ERR_INTERNAL;
 
@@ -67,7 +362,7 @@ AtmStatus account_store_load(AccountStore *store, const char *path) {
         return ATM_OK;
     }
 
-    char line[MAX_LINE_LEN];
+    char line[ACCOUNT_CSV_RECORD_MAX + 1];
     while (fgets(line, sizeof(line), f)) {
         /* Skip empty or commented lines */
         if (line[0] == '#' || line[0] == '\n') {
@@ -77,89 +372,190 @@ AtmStatus account_store_load(AccountStore *store, const char *path) {
         Account acc;
         memset(&acc, 0, sizeof(Account));
 
-        char id[MAX_ACCOUNT_ID_LEN];
-        char name[MAX_NAME_LEN];
-        double balance;
-        unsigned pin_hash;
-        int is_locked;
-        unsigned failed_attempts;
-
-        int parsed = sscanf(
-            line,
-            " %15[^,],%63[^,],%lf,%u,%d,%u",
-            id,
-            name,
-            &balance,
-            &pin_hash,
-            &is_locked,
-            &failed_attempts
-        );
-
-        if (parsed != 6) {
+        AtmStatus st = account_parse_csv(line, &acc, NULL);
+        if (st == ATM_OK) {
+            st = account_store_append(store, &acc);
+        }
+        if (st != ATM_OK) {
             fclose(f);
-            return ATM_ERR_PARSE;
+            return st;
         }
+    }
 
-        strncpy(acc.id, id, MAX_ACCOUNT_ID_LEN - 1);
-        acc.id[MAX_ACCOUNT_ID_LEN - 1] = '\0';
+    fclose(f);
+    return ATM_OK;
+}
 
-        strncpy(acc.holder_name, name, MAX_NAME_LEN - 1);
-        acc.holder_name[MAX_NAME_LEN - 1] = '\0';
+AtmStatus account_store_save(const AccountStore *store, const char *path, uint32_t *crcs) {
+    if (!store || !path) return ATM_ERR_INTERNAL;
 
-        acc.balance         = balance;
-        acc.pin_hash        = (uint32_t)pin_hash;
-        acc.is_locked       = is_locked;
-        acc.failed_attempts = failed_attempts;
+    FileReplace out;
+    if (fileio_replace_begin(&out, path) != ATM_OK) {
+        return ATM_ERR_IO;
+    }
 
-        if (store->size == store->capacity) {
-            size_t new_cap = (store->capacity == 0) ? 8 : store->capacity * 2;
-            AtmStatus st   = account_store_reserve(store, new_cap);
-            if (st != ATM_OK) {
-                fclose(f);
-                return st;
-            }
+    /* Records are formatted straight into the writer's I/O buffers.
+     * Column order follows ACCOUNT_FIELDS:
+     * account_id,holder_name,balance,pin_hash,is_locked,failed_attempts,crc32c
+     */
+    int ok = 1;
+    for (size_t i = 0; i < store->size && ok; ++i) {
+        char *dst = fileio_replace_reserve(&out, ACCOUNT_CSV_RECORD_MAX);
+        if (!dst) {
+            ok = 0;
+            break;
         }
+        fileio_replace_advance(&out, account_format_csv(&store->items[i], dst,
+                                                        crcs ? &crcs[i] : NULL));
+    }
+
+    return fileio_replace_commit(&out, ok);
+}
 
-        store->items[store->size++] = acc;
+static void account_verify_mark(AccountVerifyReport *r, size_t *bad, size_t line_no) {
+    (*bad)++;
+    if (r->first_bad == 0) {
+        r->first_bad = line_no;
     }
+}
 
-    fclose(f);
-    return ATM_OK;
+/*
+ * Scrubs one CSV line. A line with a checksum column is verified straight
+ * from its raw bytes (no field parsing); only legacy lines without one are
+ * parsed, to at least confirm they match the schema.
+ */
+static void account_verify_line(const char *line, size_t len, size_t line_no,
+                                AccountVerifyReport *r) {
+    while (len > 0 && (*line == ' ' || *line == '\t')) {
+        line++;
+        len--;
+    }
+    while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ')) {
+        len--;
+    }
+    if (len == 0 || line[0] == '#') {
+        return;
+    }
+
+    r->records++;
+
+    size_t commas = 0;
+    for (const char *c = line; (c = memchr(c, ',', (size_t)(line + len - c))) != NULL; ++c) {
+        commas++;
+    }
+
+    /* Fast path: "<fields>,<8 hex digits>" (current or original columns) */
+    if ((commas == ACCOUNT_FIELD_COUNT || commas == ACCOUNT_V1_FIELD_COUNT) &&
+        len > 9 && line[len - 9] == ',') {
+        uint32_t stored = 0;
+        size_t   i      = len - 8;
+        for (; i < len; ++i) {
+            char c = line[i];
+            uint32_t d;
+            if (c >= '0' && c <= '9')      d = (uint32_t)(c - '0');
+            else if (c >= 'a' && c <= 'f') d = (uint32_t)(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') d = (uint32_t)(c - 'A' + 10);
+            else break;
+            stored = (stored << 4) | d;
+        }
+
+        if (i != len) {
+            account_verify_mark(r, &r->malformed, line_no);
+        } else if (stored != crc32c(0, line, len - 9)) {
+            account_verify_mark(r, &r->corrupted, line_no);
+        } else {
+            r->verified++;
+        }
+        return;
+    }
+
+    char    buf[ACCOUNT_CSV_RECORD_MAX + 1];
+    Account acc;
+    int     checked = 0;
+    if ((commas != ACCOUNT_FIELD_COUNT - 1 && commas != ACCOUNT_V1_FIELD_COUNT - 1) ||
+        len >= sizeof(buf)) {
+        account_verify_mark(r, &r->malformed, line_no);
+        return;
+    }
+    memcpy(buf, line, len);
+    buf[len] = '\0';
+    if (account_parse_csv(buf, &acc, &checked) != ATM_OK) {
+        account_verify_mark(r, &r->malformed, line_no);
+    } else {
+        r->unchecked++;
+    }
 }
 
-AtmStatus account_store_save(const AccountStore *store, const char *path) {
-    if (!store || !path) return ATM_ERR_INTERNAL;
+AtmStatus account_store_verify(const char *path, AccountVerifyReport *report) {
+    if (!path || !report) return ATM_ERR_INTERNAL;
+    memset(report, 0, sizeof(*report));
 
-    FILE *f = fopen(path, "w");
+    FILE *f = fopen(path, "rb");
     if (!f) {
         return ATM_ERR_IO;
     }
 
-    /* Simple CSV-like format:
-     * account_id,holder_name,balance,pin_hash,is_locked,failed_attempts
-     */
-    for (size_t i = 0; i < store->size; ++i) {
-        const Account *acc = &store->items[i];
-        fprintf(f,
-                "%s,%s,%.2f,%u,%d,%u\n",
-                acc->id,
-                acc->holder_name,
-                acc->balance,
-                acc->pin_hash,
-                acc->is_locked,
-                acc->failed_attempts);
-    }
-
-    if (fclose(f) != 0) {
-        return ATM_ERR_IO;
+    /* Large sequential reads; lines are scanned in place. */
+    size_t cap = 1024 * 1024;
+    char  *buf = malloc(cap);
+    if (!buf) {
+        fclose(f);
+        return ATM_ERR_INTERNAL;
+    }
+
+    size_t used    = 0;
+    size_t line_no = 0;
+    int    eof     = 0;
+    while (!eof) {
+        size_t n = fread(buf + used, 1, cap - used, f);
+        if (n == 0) {
+            eof = 1;
+            if (ferror(f)) {
+                free(buf);
+                fclose(f);
+                return ATM_ERR_IO;
+            }
+        }
+        used += n;
+
+        size_t start = 0;
+        for (;;) {
+            char *nl = memchr(buf + start, '\n', used - start);
+            if (!nl) {
+                break;
+            }
+            size_t end = (size_t)(nl - buf);
+            account_verify_line(buf + start, end - start, ++line_no, report);
+            start = end + 1;
+        }
+
+        if (eof && start < used) {
+            account_verify_line(buf + start, used - start, ++line_no, report);
+            start = used;
+        }
+
+        if (start == 0 && used == cap) {
+            /* A single line longer than the buffer cannot be a record. */
+            account_verify_mark(report, &report->malformed, ++line_no);
+            used = 0;
+            continue;
+        }
+        memmove(buf, buf + start, used - start);
+        used -= start;
     }
 
+    free(buf);
+    fclose(f);
+
+    if (report->corrupted) return ATM_ERR_CHECKSUM;
+    if (report->malformed) return ATM_ERR_PARSE;
     return ATM_OK;
 }
 
 AtmStatus account_deposit(Account *account, double amount) {
     if (!account) return ATM_ERR_INTERNAL;
-    if (amount <= 0.0) return ATM_ERR_INVALID_AMOUNT;
+    if (!(amount > 0.0)) return ATM_ERR_INVALID_AMOUNT; /* also rejects NaN */
+    if (amount > ACCOUNT_MAX_BALANCE - account->balance) return ATM_ERR_INVALID_AMOUNT;
 
     account->balance += amount;
     return ATM_OK;
@@ -167,7 +563,7 @@ AtmStatus account_deposit(Account *account, double amount) {
 
 AtmStatus account_withdraw(Account *account, double amount) {
     if (!account) return ATM_ERR_INTERNAL;
-    if (amount <= 0.0) return ATM_ERR_INVALID_AMOUNT;
+    if (!(amount > 0.0)) return ATM_ERR_INVALID_AMOUNT;
 
     if (amount > account->balance) {
         return ATM_ERR_INSUFFICIENT_FUNDS;
@@ -176,3 +572,32 @@ AtmStatus account_withdraw(Account *account, double amount) {
     account->balance -= amount;
     return ATM_OK;
 }
+
+AtmStatus account_transfer(AccountStore *store, const char *from_id,
+                           const char *to_id, double amount) {
+    if (!store || !from_id || !to_id) return ATM_ERR_INTERNAL;
+    if (!(amount > 0.0)) return ATM_ERR_INVALID_AMOUNT; /* also rejects NaN */
+
+    /* A self-transfer is rejected rather than treated as a no-op. */
+    if (strncmp(from_id, to_id, MAX_ACCOUNT_ID_LEN) == 0) {
+        return ATM_ERR_INVALID_AMOUNT;
+    }
+
+    Account *from = account_store_find(store, from_id);
+    Account *to   = account_store_find(store, to_id);
+    if (!from || !to) {
+        return ATM_ERR_NOT_FOUND;
+    }
+    if (from->is_locked) {
+        return ATM_ERR_LOCKED;
+    }
+    if (amount > ACCOUNT_MAX_BALANCE - to->balance) {
+        return ATM_ERR_INVALID_AMOUNT;
+    }
+
+    AtmStatus st = account_withdraw(from, amount);
+    if (st != ATM_OK) {
+        return st;
+    }
+    return account_deposit(to, amount); /* cannot fail: checked above */
+}
@@ -0,0 +1,496 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      account_codec.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Specialized CSV/JSON parse and format routines. Each schema kind has a
+ *   small put/get primitive; the record routines are expanded from
+ *   ACCOUNT_FIELDS so a new field needs no hand-written codec changes.
+ *
+ *   Every record carries a CRC32C of its canonical CSV field text: in CSV
+ *   as a trailing hex column, in JSON as a "crc32c" key. Both are written
+ *   on save and verified on load when present; records without one (older
+ *   files) are accepted as-is.
+ */
+
+#include "account_codec.h"
+#include "crc32c.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------------------------------------------------------------------- */
+/* Formatting primitives                                                  */
+/* ---------------------------------------------------------------------- */
+
+static char *codec_put_raw(char *out, const char *s, size_t n) {
+    memcpy(out, s, n);
+    return out + n;
+}
+
+static char *codec_put_u64(char *out, uint64_t v) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + (v % 10));
+        v /= 10;
+    } while (v);
+    while (n) {
+        *out++ = tmp[--n];
+    }
+    return out;
+}
+
+static char *codec_put_STR(char *out, const char *v, size_t cap) {
+    size_t n = 0;
+    while (n < cap && v[n]) n++;
+    return codec_put_raw(out, v, n);
+}
+
+static char *codec_put_U32(char *out, uint32_t v) {
+    return codec_put_u64(out, v);
+}
+
+static char *codec_put_UINT(char *out, unsigned v) {
+    return codec_put_u64(out, v);
+}
+
+static char *codec_put_FLAG(char *out, int v) {
+    if (v < 0) {
+        *out++ = '-';
+        return codec_put_u64(out, (uint64_t)(-(int64_t)v));
+    }
+    return codec_put_u64(out, (uint64_t)v);
+}
+
+/*
+ * Equivalent to "%.2f". Values whose scaled fraction sits too close to a
+ * rounding tie (or that are huge) take the printf path so the output is
+ * byte-identical to what the stdio writer produced.
+ */
+static char *codec_put_MONEY(char *out, double v) {
+    double scaled = v * 100.0;
+    double frac   = scaled - floor(scaled);
+
+    if (!(fabs(scaled) < 9.0e15) || fabs(frac - 0.5) < 1e-6 ||
+        (signbit(v) && scaled > -0.5)) {
+        /* snprintf returns the untruncated length: advance by what was written. */
+        int n = snprintf(out, ACCOUNT_MONEY_TEXT_MAX + 1, "%.2f", v);
+        if (n < 0) n = 0;
+        if (n > ACCOUNT_MONEY_TEXT_MAX) n = ACCOUNT_MONEY_TEXT_MAX;
+        return out + n;
+    }
+
+    int64_t cents = (int64_t)floor(scaled + 0.5);
+    if (cents < 0) {
+        *out++ = '-';
+        cents  = -cents;
+    }
+    out    = codec_put_u64(out, (uint64_t)(cents / 100));
+    *out++ = '.';
+    *out++ = (char)('0' + (cents % 100) / 10);
+    *out++ = (char)('0' + cents % 10);
+    return out;
+}
+
+static char *codec_put_HEX(char *out, const uint8_t *v, size_t len) {
+    static const char HEX[] = "0123456789abcdef";
+    for (size_t i = 0; i < len; ++i) {
+        *out++ = HEX[v[i] >> 4];
+        *out++ = HEX[v[i] & 0xF];
+    }
+    return out;
+}
+
+#define CODEC_PUT_STR(out, f)   codec_put_STR((out), (f), sizeof(f))
+#define CODEC_PUT_HEX(out, f)   codec_put_HEX((out), (f), sizeof(f))
+#define CODEC_PUT_MONEY(out, f) codec_put_MONEY((out), (f))
+#define CODEC_PUT_U32(out, f)   codec_put_U32((out), (f))
+#define CODEC_PUT_FLAG(out, f)  codec_put_FLAG((out), (f))
+#define CODEC_PUT_UINT(out, f)  codec_put_UINT((out), (f))
+
+/* ---------------------------------------------------------------------- */
+/* Parsing primitives                                                     */
+/* ---------------------------------------------------------------------- */
+
+static const char *codec_skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+    return p;
+}
+
+static const char *codec_skip_blanks(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+/* Copies up to (but not including) `stop`, end of line, or NUL. */
+static const char *codec_get_STR(const char *p, char stop, char *dst, size_t cap) {
+    size_t n = 0;
+    while (p[n] && p[n] != stop && p[n] != '\n' && p[n] != '\r') {
+        if (n + 1 >= cap) {
+            return NULL;
+        }
+        dst[n] = p[n];
+        n++;
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    dst[n] = '\0';
+    return p + n;
+}
+
+static const char *codec_get_u64(const char *p, uint64_t limit, uint64_t *out) {
+    p = codec_skip_blanks(p);
+    if (*p == '+') p++;
+    if (*p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    uint64_t v = 0;
+    while (*p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t)(*p++ - '0');
+        if (v > limit) {
+            return NULL;
+        }
+    }
+    *out = v;
+    return p;
+}
+
+static const char *codec_get_U32(const char *p, uint32_t *out) {
+    uint64_t v;
+    p = codec_get_u64(p, UINT32_MAX, &v);
+    if (p) *out = (uint32_t)v;
+    return p;
+}
+
+static const char *codec_get_UINT(const char *p, unsigned *out) {
+    uint64_t v;
+    p = codec_get_u64(p, (unsigned)-1, &v);
+    if (p) *out = (unsigned)v;
+    return p;
+}
+
+static const char *codec_get_FLAG(const char *p, int *out) {
+    p = codec_skip_blanks(p);
+    int neg = 0;
+    if (*p == '-') {
+        neg = 1;
+        p++;
+    }
+
+    uint64_t v;
+    p = codec_get_u64(p, (uint64_t)2147483647 + (uint64_t)neg, &v);
+    if (p) *out = neg ? (int)(-(int64_t)v) : (int)v;
+    return p;
+}
+
+/*
+ * Fast path for plain "[-]digits[.d[d]]" amounts: an exact integer number
+ * of cents divided by 100 is the correctly rounded value, the same as
+ * strtod. Anything else (exponents, more decimals) falls back to strtod.
+ */
+static const char *codec_get_MONEY(const char *p, double *out) {
+    p = codec_skip_blanks(p);
+
+    const char *q   = p;
+    int         neg = 0;
+    if (*q == '-' || *q == '+') {
+        neg = (*q == '-');
+        q++;
+    }
+
+    int64_t whole  = 0;
+    int     digits = 0;
+    while (*q >= '0' && *q <= '9' && digits < 15) {
+        whole = whole * 10 + (*q++ - '0');
+        digits++;
+    }
+
+    int64_t frac   = 0;
+    int     fdigits = 0;
+    if (digits > 0 && *q == '.') {
+        q++;
+        while (*q >= '0' && *q <= '9' && fdigits < 3) {
+            frac = frac * 10 + (*q++ - '0');
+            fdigits++;
+        }
+    }
+
+    int plain = digits > 0 && fdigits <= 2 &&
+                !((*q >= '0' && *q <= '9') || *q == '.' || *q == 'e' || *q == 'E');
+    if (plain) {
+        int64_t cents = whole * 100 + (fdigits == 1 ? frac * 10 : frac);
+        double  v     = (double)cents / 100.0;
+        *out = neg ? -v : v;
+        return q;
+    }
+
+    char *endptr = NULL;
+    double v = strtod(p, &endptr);
+    if (!endptr || endptr == p) {
+        return NULL;
+    }
+    *out = v;
+    return endptr;
+}
+
+static int codec_hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Exactly 2 * len hex digits. */
+static const char *codec_get_HEX(const char *p, uint8_t *dst, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        int hi = codec_hex_digit(p[2 * i]);
+        int lo = hi < 0 ? -1 : codec_hex_digit(p[2 * i + 1]);
+        if (lo < 0) {
+            return NULL;
+        }
+        dst[i] = (uint8_t)((hi << 4) | lo);
+    }
+    return p + 2 * len;
+}
+
+#define CODEC_GET_STR(p, stop, f)   codec_get_STR((p), (stop), (f), sizeof(f))
+#define CODEC_GET_HEX(p, stop, f)   codec_get_HEX((p), (f), sizeof(f))
+#define CODEC_GET_MONEY(p, stop, f) codec_get_MONEY((p), &(f))
+#define CODEC_GET_U32(p, stop, f)   codec_get_U32((p), &(f))
+#define CODEC_GET_FLAG(p, stop, f)  codec_get_FLAG((p), &(f))
+#define CODEC_GET_UINT(p, stop, f)  codec_get_UINT((p), &(f))
+
+/* JSON wraps strings in quotes; every other kind is a bare number. */
+#define CODEC_JSON_QUOTED_STR   1
+#define CODEC_JSON_QUOTED_HEX   1
+#define CODEC_JSON_QUOTED_MONEY 0
+#define CODEC_JSON_QUOTED_U32   0
+#define CODEC_JSON_QUOTED_FLAG  0
+#define CODEC_JSON_QUOTED_UINT  0
+
+/* Checksums are written as exactly eight lowercase hex digits. */
+static char *codec_put_hex32(char *out, uint32_t v) {
+    static const char HEX[] = "0123456789abcdef";
+    for (int shift = 28; shift >= 0; shift -= 4) {
+        *out++ = HEX[(v >> shift) & 0xF];
+    }
+    return out;
+}
+
+static const char *codec_get_hex32(const char *p, uint32_t *out) {
+    uint32_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        int d = codec_hex_digit(p[i]);
+        if (d < 0) {
+            return NULL;
+        }
+        v = (v << 4) | (uint32_t)d;
+    }
+    *out = v;
+    return p + 8;
+}
+
+/* ---------------------------------------------------------------------- */
+/* CSV                                                                    */
+/* ---------------------------------------------------------------------- */
+
+/* Writes the schema columns only (no checksum, no newline). */
+static size_t codec_format_csv_fields(const Account *acc, char *out, int with_v2) {
+    char *o = out;
+
+#define CODEC_CSV_PUT(member, key, kind, c_type, dim) \
+    o = CODEC_PUT_##kind(o, acc->member);              \
+    *o++ = ',';
+    ACCOUNT_FIELDS_V1(CODEC_CSV_PUT)
+    if (with_v2) {
+        ACCOUNT_FIELDS_V2(CODEC_CSV_PUT)
+    }
+#undef CODEC_CSV_PUT
+
+    return (size_t)(o - out) - 1; /* drop the trailing separator */
+}
+
+static uint32_t codec_record_crc(const Account *acc, int with_v2) {
+    char buf[ACCOUNT_CSV_RECORD_MAX];
+    return crc32c(0, buf, codec_format_csv_fields(acc, buf, with_v2));
+}
+
+uint32_t account_record_crc(const Account *acc) {
+    return codec_record_crc(acc, 1);
+}
+
+#define CODEC_EQ_STR(a, b)   (strcmp((a), (b)) == 0)
+#define CODEC_EQ_HEX(a, b)   (memcmp((a), (b), sizeof(a)) == 0)
+#define CODEC_EQ_MONEY(a, b) ((a) == (b))
+#define CODEC_EQ_U32(a, b)   ((a) == (b))
+#define CODEC_EQ_FLAG(a, b)  (((a) > 0) == ((b) > 0) && ((a) < 0) == ((b) < 0))
+#define CODEC_EQ_UINT(a, b)  ((a) == (b))
+
+int account_equal(const Account *a, const Account *b) {
+#define CODEC_EQ_FIELD(member, key, kind, c_type, dim) \
+    if (!CODEC_EQ_##kind(a->member, b->member)) return 0;
+    ACCOUNT_FIELDS(CODEC_EQ_FIELD)
+#undef CODEC_EQ_FIELD
+    return 1;
+}
+
+size_t account_format_csv(const Account *acc, char *out, uint32_t *crc) {
+    size_t   n   = codec_format_csv_fields(acc, out, 1);
+    char    *o   = out + n;
+    uint32_t sum = crc32c(0, out, n);
+
+    if (crc) *crc = sum;
+    *o++ = ',';
+    o    = codec_put_hex32(o, sum);
+    *o++ = '\n';
+    return (size_t)(o - out);
+}
+
+AtmStatus account_parse_csv(const char *line, Account *acc, int *checked) {
+    const char *start = codec_skip_ws(line);
+    const char *p     = start;
+
+    /* The column count tells whether the newer field groups are present. */
+    size_t columns = 1;
+    for (const char *c = start; *c && *c != '\n'; ++c) {
+        if (*c == ',') columns++;
+    }
+    int with_v2 = columns >= ACCOUNT_FIELD_COUNT;
+    int first   = 1;
+
+#define CODEC_CSV_GET(member, key, kind, c_type, dim) \
+    if (!first) {                                      \
+        if (*p != ',') return ATM_ERR_PARSE;           \
+        p++;                                           \
+    }                                                  \
+    first = 0;                                         \
+    p = CODEC_GET_##kind(p, ',', acc->member);         \
+    if (!p) return ATM_ERR_PARSE;
+    ACCOUNT_FIELDS_V1(CODEC_CSV_GET)
+    if (with_v2) {
+        ACCOUNT_FIELDS_V2(CODEC_CSV_GET)
+    }
+#undef CODEC_CSV_GET
+
+    /* Optional checksum column over the raw bytes of the record. */
+    const char *end     = p;
+    uint32_t    stored  = 0;
+    int         has_crc = (*p == ',');
+    if (has_crc && !(end = codec_get_hex32(p + 1, &stored))) {
+        return ATM_ERR_PARSE;
+    }
+    /* Nothing but the line end may follow: not a damaged or extra column. */
+    if (*codec_skip_ws(end) != '\0') {
+        return ATM_ERR_PARSE;
+    }
+    if (checked) *checked = has_crc;
+    if (has_crc && stored != crc32c(0, start, (size_t)(p - start))) {
+        return ATM_ERR_CHECKSUM;
+    }
+
+    return ATM_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* JSON                                                                   */
+/* ---------------------------------------------------------------------- */
+
+#define CODEC_JSON_CRC_KEY "crc32c"
+
+/* Matches `"key" :` and returns the position of the value, or NULL. */
+static const char *codec_json_key(const char *p, const char *key, size_t key_len) {
+    if (*p++ != '"' || strncmp(p, key, key_len) != 0) return NULL;
+    p += key_len;
+    if (*p++ != '"') return NULL;
+    p = codec_skip_ws(p);
+    if (*p++ != ':') return NULL;
+    return codec_skip_ws(p);
+}
+
+size_t account_format_json(const Account *acc, char *out, uint32_t *crc) {
+    static const char OPEN[]  = "    {\n";
+    static const char CLOSE[] = "\"\n    }";
+    static const char SEP[]   = ",\n";
+    static const char CRC[]   = ",\n      \"" CODEC_JSON_CRC_KEY "\": \"";
+
+    char *o = codec_put_raw(out, OPEN, sizeof(OPEN) - 1);
+    int first = 1;
+
+#define CODEC_JSON_PUT(member, key, kind, c_type, dim)                 \
+    if (!first) o = codec_put_raw(o, SEP, sizeof(SEP) - 1);            \
+    first = 0;                                                          \
+    o = codec_put_raw(o, "      \"" key "\": ", sizeof(key) + 9);       \
+    if (CODEC_JSON_QUOTED_##kind) *o++ = '"';                           \
+    o = CODEC_PUT_##kind(o, acc->member);                               \
+    if (CODEC_JSON_QUOTED_##kind) *o++ = '"';
+    ACCOUNT_FIELDS(CODEC_JSON_PUT)
+#undef CODEC_JSON_PUT
+
+    o = codec_put_raw(o, CRC, sizeof(CRC) - 1);
+    uint32_t sum = account_record_crc(acc);
+    if (crc) *crc = sum;
+    o = codec_put_hex32(o, sum);
+    o = codec_put_raw(o, CLOSE, sizeof(CLOSE) - 1);
+    return (size_t)(o - out);
+}
+
+AtmStatus account_parse_json(const char **cursor, Account *acc, int *checked) {
+    const char *p = codec_skip_ws(*cursor);
+    if (*p++ != '{') {
+        return ATM_ERR_PARSE;
+    }
+    int first = 1;
+
+#define CODEC_JSON_GET(member, key, kind, c_type, dim)                       \
+    p = codec_skip_ws(p);                                                     \
+    if (!first) {                                                             \
+        if (*p++ != ',') return ATM_ERR_PARSE;                                \
+        p = codec_skip_ws(p);                                                 \
+    }                                                                         \
+    first = 0;                                                                \
+    p = codec_json_key(p, key, sizeof(key) - 1);                              \
+    if (!p) return ATM_ERR_PARSE;                                             \
+    if (CODEC_JSON_QUOTED_##kind && *p++ != '"') return ATM_ERR_PARSE;        \
+    p = CODEC_GET_##kind(p, '"', acc->member);                                \
+    if (!p) return ATM_ERR_PARSE;                                             \
+    if (CODEC_JSON_QUOTED_##kind && *p++ != '"') return ATM_ERR_PARSE;
+    ACCOUNT_FIELDS_V1(CODEC_JSON_GET)
+
+    /* The newer group is present if its first key follows. */
+#define CODEC_JSON_KEY_STR(member, key, kind, c_type, dim) key,
+    static const char *const V2_KEYS[] = { ACCOUNT_FIELDS_V2(CODEC_JSON_KEY_STR) };
+#undef CODEC_JSON_KEY_STR
+    const char *q = codec_skip_ws(p);
+    int with_v2 = *q == ',' &&
+                  codec_json_key(codec_skip_ws(q + 1), V2_KEYS[0], strlen(V2_KEYS[0])) != NULL;
+    if (with_v2) {
+        ACCOUNT_FIELDS_V2(CODEC_JSON_GET)
+    }
+#undef CODEC_JSON_GET
+
+    /* Optional checksum over the canonical CSV form of the fields. */
+    q = codec_skip_ws(p);
+    if (checked) *checked = (*q == ',');
+    if (*q == ',') {
+        uint32_t stored;
+        q = codec_json_key(codec_skip_ws(q + 1), CODEC_JSON_CRC_KEY,
+                           sizeof(CODEC_JSON_CRC_KEY) - 1);
+        if (!q || *q++ != '"' || !(q = codec_get_hex32(q, &stored)) || *q++ != '"') {
+            return ATM_ERR_PARSE;
+        }
+        if (stored != codec_record_crc(acc, with_v2)) {
+            return ATM_ERR_CHECKSUM;
+        }
+        p = q;
+    }
+
+    *cursor = p;
+    return ATM_OK;
+}
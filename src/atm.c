@@ -12,17 +12,31 @@
 #include "auth.h"
 #include "ui.h"
 #include "db_json.h"
+#include "record.h"
+#include "timeutil.h"
+#include "trace.h"
 
+#include <errno.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static void atm_print_status_from_code(AtmStatus status);
 static void atm_session(AtmContext *ctx, Account *account);
-static AtmStatus atm_persist(AtmContext *ctx);
+static int  atm_session_refresh(AtmContext *ctx, Account **account);
+static void atm_load_id_filter(AtmContext *ctx);
+
+#define ATM_LOCAL_SOURCE "local" /* throttle source for the interactive terminal */
 
 AtmStatus atm_init(AtmContext *ctx, const char *db_path) {
     if (!ctx || !db_path) return ATM_ERR_INTERNAL;
 
+    replica_init(&ctx->replica);
+    history_init(&ctx->history);
+    idem_init(&ctx->idem);
+    shmview_init(&ctx->view);
+
     AtmStatus st = account_store_init(&ctx->store);
     if (st != ATM_OK) {
         return st;
@@ -31,12 +45,7 @@ AtmStatus atm_init(AtmContext *ctx, const char *db_path) {
     strncpy(ctx->db_path, db_path, MAX_DB_PATH_LEN - 1);
     ctx->db_path[MAX_DB_PATH_LEN - 1] = '\0';
 
-    /* Detect format by extension */
-    ctx->use_json = 0;
-    const char *ext = strrchr(ctx->db_path, '.');
-    if (ext && strcmp(ext, ".json") == 0) {
-        ctx->use_json = 1;
-    }
+    ctx->use_json = atm_path_is_json(ctx->db_path);
 
     if (ctx->use_json) {
         st = account_store_load_json(&ctx->store, ctx->db_path);
@@ -44,14 +53,65 @@ AtmStatus atm_init(AtmContext *ctx, const char *db_path) {
         st = account_store_load(&ctx->store, ctx->db_path);
     }
 
+    if (st == ATM_OK) {
+        atm_load_id_filter(ctx);
+        st = throttle_init(&ctx->throttle, NULL);
+    }
+    if (st == ATM_OK) {
+        st = reload_watch_init(&ctx->reload, ctx->db_path);
+    }
+    if (st == ATM_OK) {
+        st = reload_snapshot(&ctx->reload, ctx->db_path, &ctx->store);
+    }
+    if (st == ATM_OK) {
+        st = idem_open(&ctx->idem, ctx->db_path, ctx->reload.base, ctx->reload.base_len);
+    }
+    if (st == ATM_OK && getenv(HISTORY_ENV)) {
+        st = history_open(&ctx->history, getenv(HISTORY_ENV), &ctx->store, ctx->reload.base);
+    }
+    if (st == ATM_OK && getenv(SHMVIEW_ENV)) {
+        st = shmview_open(&ctx->view, getenv(SHMVIEW_ENV), &ctx->store);
+    }
+
     return st;
 }
 
 void atm_shutdown(AtmContext *ctx) {
     if (!ctx) return;
+    shmview_close(&ctx->view);
+    history_close(&ctx->history);
+    idem_close(&ctx->idem);
+    replica_close(&ctx->replica);
+    reload_watch_free(&ctx->reload);
+    throttle_free(&ctx->throttle);
+    bloom_free(&ctx->id_filter);
     account_store_free(&ctx->store);
 }
 
+/*
+ * Reuses the persisted filter when it still describes the loaded IDs,
+ * otherwise rebuilds it and refreshes the sidecar file. A missing filter
+ * is not an error: lookups simply fall through to the full scan.
+ */
+static void atm_load_id_filter(AtmContext *ctx) {
+    char path[MAX_DB_PATH_LEN + sizeof(BLOOM_FILE_SUFFIX)];
+    snprintf(path, sizeof(path), "%s%s", ctx->db_path, BLOOM_FILE_SUFFIX);
+
+    memset(&ctx->id_filter, 0, sizeof(ctx->id_filter));
+
+    if (bloom_load(&ctx->id_filter, path) == ATM_OK) {
+        if (ctx->id_filter.nitems == ctx->store.size &&
+            ctx->id_filter.digest == bloom_store_digest(&ctx->store)) {
+            return;
+        }
+        bloom_free(&ctx->id_filter);
+    }
+
+    if (bloom_build(&ctx->id_filter, &ctx->store) == ATM_OK) {
+        bloom_save(&ctx->id_filter, path); /* best effort */
+    }
+}
+
 void atm_run(AtmContext *ctx) {
     if (!ctx) return;
 
@@ -76,13 +136,28 @@ void atm_run(AtmContext *ctx) {
             break;
         }
 
-        Account *acc = account_store_find(&ctx->store, account_id);
+        /* Throttled attempts are answered without touching the database. */
+        uint64_t retry_ms = 0;
+        if (throttle_check(&ctx->throttle, account_id, ATM_LOCAL_SOURCE,
+                           time_monotonic_ms(), &retry_ms) != ATM_OK) {
+            printf("Too many failed attempts. Try again in %llu second(s).\n",
+                   (unsigned long long)((retry_ms + 999) / 1000));
+            continue;
+        }
+
+        atm_print_status_from_code(atm_refresh(ctx, NULL, NULL));
+
+        Account *acc = atm_find_account(ctx, account_id);
         if (!acc) {
+            throttle_record(&ctx->throttle, account_id, ATM_LOCAL_SOURCE,
+                            time_monotonic_ms(), 0);
+            record_login(account_id, ATM_ERR_NOT_FOUND);
             ui_print_error("Account not found.");
             continue;
         }
 
         if (acc->is_locked) {
+            record_login(account_id, ATM_ERR_LOCKED);
             ui_print_error("Account is locked due to too many failed attempts. Please contact the bank.");
             continue;
         }
@@ -92,17 +167,28 @@ void atm_run(AtmContext *ctx) {
             continue;
         }
 
+        /* Traced from PIN entry on: the time before is the customer's. */
+        TRACE_BEGIN_EVENT(TRACE_LOGIN, 0);
         AtmStatus auth_status = auth_verify_login(acc, pin);
+        throttle_record(&ctx->throttle, account_id, ATM_LOCAL_SOURCE,
+                        time_monotonic_ms(), auth_status == ATM_OK);
+        record_login(account_id, auth_status);
         if (auth_status == ATM_OK) {
             ui_print_status("Authentication successful. Welcome!");
-            AtmStatus st = atm_persist(ctx); /* failed_attempts reset */
+            AtmStatus st = atm_commit(ctx, &acc); /* failed_attempts reset */
+            TRACE_END_EVENT(TRACE_LOGIN, st, 0);
             if (st != ATM_OK) {
                 atm_print_status_from_code(st);
             }
-            atm_session(ctx, acc);
+            if (acc) {
+                TRACE_BEGIN_EVENT(TRACE_SESSION, 0);
+                atm_session(ctx, acc);
+                TRACE_END_EVENT(TRACE_SESSION, ATM_OK, 0);
+            }
         } else {
             atm_print_status_from_code(auth_status);
-            AtmStatus st = atm_persist(ctx); /* might lock account */
+            AtmStatus st = atm_commit(ctx, &acc); /* might lock account */
+            TRACE_END_EVENT(TRACE_LOGIN, auth_status, 0);
             if (st != ATM_OK) {
                 atm_print_status_from_code(st);
             }
@@ -113,10 +199,15 @@ void atm_run(AtmContext *ctx) {
 static void atm_session(AtmContext *ctx, Account *account) {
     if (!ctx || !account) return;
 
-    int    choice = 0;
-    double amount = 0.0;
+    int       choice = 0;
+    double    amount = 0.0;
+    AtmStatus st     = ATM_OK;
 
     for (;;) {
+        if (!atm_session_refresh(ctx, &account)) {
+            return;
+        }
+
         ui_print_line();
         printf("Account ID: %s\n", account->id);
         printf("Account Holder: %s\n", account->holder_name);
@@ -124,7 +215,8 @@ static void atm_session(AtmContext *ctx, Account *account) {
         printf("1) Balance inquiry\n");
         printf("2) Deposit\n");
         printf("3) Withdraw\n");
-        printf("4) Logout\n");
+        printf("4) Transfer\n");
+        printf("5) Logout\n");
 
         if (!ui_read_int("Select an option: ", &choice)) {
             ui_print_error("Failed to read menu option.");
@@ -133,6 +225,7 @@ static void atm_session(AtmContext *ctx, Account *account) {
 
         switch (choice) {
         case 1:
+            record_op(RECORD_BALANCE, ATM_OK);
             printf("Current balance: %.2f\n", account->balance);
             break;
 
@@ -141,7 +234,13 @@ static void atm_session(AtmContext *ctx, Account *account) {
                 ui_print_error("Failed to read amount.");
                 break;
             }
-            switch (account_deposit(account, amount)) {
+            if (!atm_session_refresh(ctx, &account)) {
+                return;
+            }
+            TRACE_BEGIN_EVENT(TRACE_TXN, TRACE_TXN_DEPOSIT);
+            st = account_deposit(account, amount);
+            record_amount(RECORD_DEPOSIT, amount, st);
+            switch (st) {
             case ATM_OK:
                 ui_print_status("Deposit successful.");
                 break;
@@ -152,7 +251,8 @@ static void atm_session(AtmContext *ctx, Account *account) {
                 ui_print_error("Unexpected error during deposit.");
                 break;
             }
-            atm_print_status_from_code(atm_persist(ctx));
+            atm_print_status_from_code(atm_commit(ctx, &account));
+            TRACE_END_EVENT(TRACE_TXN, st, TRACE_TXN_DEPOSIT);
             break;
 
         case 3:
@@ -160,7 +260,13 @@ static void atm_session(AtmContext *ctx, Account *account) {
                 ui_print_error("Failed to read amount.");
                 break;
             }
-            switch (account_withdraw(account, amount)) {
+            if (!atm_session_refresh(ctx, &account)) {
+                return;
+            }
+            TRACE_BEGIN_EVENT(TRACE_TXN, TRACE_TXN_WITHDRAW);
+            st = account_withdraw(account, amount);
+            record_amount(RECORD_WITHDRAW, amount, st);
+            switch (st) {
             case ATM_OK:
                 ui_print_status("Withdrawal successful.");
                 break;
@@ -174,10 +280,50 @@ static void atm_session(AtmContext *ctx, Account *account) {
                 ui_print_error("Unexpected error during withdrawal.");
                 break;
             }
-            atm_print_status_from_code(atm_persist(ctx));
+            atm_print_status_from_code(atm_commit(ctx, &account));
+            TRACE_END_EVENT(TRACE_TXN, st, TRACE_TXN_WITHDRAW);
             break;
 
-        case 4:
+        case 4: {
+            char to_id[MAX_ACCOUNT_ID_LEN];
+            if (!ui_read_string("Enter destination account ID: ", to_id, sizeof(to_id))) {
+                ui_print_error("Failed to read account ID.");
+                break;
+            }
+            if (!ui_read_double("Enter transfer amount: ", &amount)) {
+                ui_print_error("Failed to read amount.");
+                break;
+            }
+            if (!atm_session_refresh(ctx, &account)) {
+                return;
+            }
+            TRACE_BEGIN_EVENT(TRACE_TXN, TRACE_TXN_TRANSFER);
+            st = account_transfer(&ctx->store, account->id, to_id, amount);
+            record_transfer(to_id, amount, st);
+            switch (st) {
+            case ATM_OK:
+                ui_print_status("Transfer successful.");
+                atm_print_status_from_code(atm_commit(ctx, &account));
+                break;
+            case ATM_ERR_NOT_FOUND:
+                ui_print_error("Destination account not found.");
+                break;
+            case ATM_ERR_INVALID_AMOUNT:
+                ui_print_error("Invalid transfer amount or destination.");
+                break;
+            case ATM_ERR_INSUFFICIENT_FUNDS:
+                ui_print_error("Insufficient funds.");
+                break;
+            default:
+                ui_print_error("Unexpected error during transfer.");
+                break;
+            }
+            TRACE_END_EVENT(TRACE_TXN, st, TRACE_TXN_TRANSFER);
+            break;
+        }
+
+        case 5:
+            record_op(RECORD_LOGOUT, ATM_OK);
             ui_print_status("Logging out...");
             return;
 
@@ -188,12 +334,466 @@ static void atm_session(AtmContext *ctx, Account *account) {
     }
 }
 
-static AtmStatus atm_persist(AtmContext *ctx) {
+/*
+ * Picks up external edits while a session is open. Returns 0 (and ends
+ * the session) if the logged-in account no longer exists.
+ */
+static int atm_session_refresh(AtmContext *ctx, Account **account) {
+    atm_print_status_from_code(atm_refresh(ctx, account, NULL));
+    if (!*account) {
+        ui_print_error("This account was removed from the database. Logging out.");
+        return 0;
+    }
+    return 1;
+}
+
+/* Detect format by extension */
+int atm_path_is_json(const char *db_path) {
+    if (!db_path) return 0;
+    const char *ext = strrchr(db_path, '.');
+    return ext && strcmp(ext, ".json") == 0;
+}
+
+Account *atm_find_account(AtmContext *ctx, const char *account_id) {
+    if (!ctx || !account_id) return NULL;
+    TRACE_BEGIN_EVENT(TRACE_FIND, 0);
+    Account *acc = NULL;
+    if (bloom_maybe_contains(&ctx->id_filter, account_id)) {
+        acc = account_store_find(&ctx->store, account_id);
+    }
+    TRACE_END_EVENT(TRACE_FIND, acc ? ATM_OK : ATM_ERR_NOT_FOUND, acc != NULL);
+    return acc;
+}
+
+/* Applies `req`, or answers it from the idempotency table if `key` was seen. */
+static AtmStatus atm_apply(AtmContext *ctx, Account *account, const IdemRequest *req,
+                           const char *key) {
+    int keyed = key && *key;
+    if (keyed && strlen(key) >= IDEM_MAX_KEY_LEN) {
+        return ATM_ERR_PARSE;
+    }
+
+    AtmStatus st;
+    if (keyed && idem_check(&ctx->idem, key, req, &st)) {
+        return st;
+    }
+    switch (req->op) {
+    case IDEM_DEPOSIT:
+        st = account_deposit(account, req->amount);
+        break;
+    case IDEM_WITHDRAW:
+        st = account_withdraw(account, req->amount);
+        break;
+    default:
+        st = account_transfer(&ctx->store, req->account_id, req->to_id, req->amount);
+        break;
+    }
+    if (keyed) {
+        idem_remember(&ctx->idem, key, req, st);
+    }
+    return st;
+}
+
+AtmStatus atm_deposit(AtmContext *ctx, Account *account, double amount, const char *key) {
+    if (!ctx || !account) return ATM_ERR_INTERNAL;
+    IdemRequest req = { IDEM_DEPOSIT, account->id, NULL, amount };
+    return atm_apply(ctx, account, &req, key);
+}
+
+AtmStatus atm_withdraw(AtmContext *ctx, Account *account, double amount, const char *key) {
+    if (!ctx || !account) return ATM_ERR_INTERNAL;
+    IdemRequest req = { IDEM_WITHDRAW, account->id, NULL, amount };
+    return atm_apply(ctx, account, &req, key);
+}
+
+AtmStatus atm_transfer(AtmContext *ctx, const char *from_id, const char *to_id,
+                       double amount, const char *key) {
+    if (!ctx || !from_id || !to_id) return ATM_ERR_INTERNAL;
+    IdemRequest req = { IDEM_TRANSFER, from_id, to_id, amount };
+    return atm_apply(ctx, NULL, &req, key);
+}
+
+AtmStatus atm_persist(AtmContext *ctx) {
     if (!ctx) return ATM_ERR_INTERNAL;
-    if (ctx->use_json) {
-        return account_store_save_json(&ctx->store, ctx->db_path);
+
+    TRACE_BEGIN_EVENT(TRACE_PERSIST, ctx->store.size);
+
+    /* New idempotency keys are durable before the changes they guard. */
+    uint32_t *crcs = NULL;
+    AtmStatus st   = idem_prepare(&ctx->idem, ctx->reload.base, ctx->reload.base_len);
+
+    /* The save hands back every record CRC: the base for the next reload. */
+    if (st == ATM_OK) {
+        crcs = reload_save_buffer(&ctx->reload, ctx->store.size);
+        st   = ctx->use_json ? account_store_save_json(&ctx->store, ctx->db_path, crcs)
+                             : account_store_save(&ctx->store, ctx->db_path, crcs);
+    }
+    if (st == ATM_OK && crcs) {
+        reload_save_done(&ctx->reload, ctx->db_path, ctx->store.size);
+    } else if (st == ATM_OK) {
+        st = reload_snapshot(&ctx->reload, ctx->db_path, &ctx->store);
+    }
+    if (st == ATM_OK) {
+        /* Without its marker a key survives a restart only if the file changed. */
+        AtmStatus is = idem_saved(&ctx->idem);
+        if (is != ATM_OK) {
+            fprintf(stderr, "idem: committing a save failed (%s)\n", atm_status_name(is));
+        }
+    }
+
+    /*
+     * Ship after the local write: the standby is never ahead of the file.
+     * A lost standby does not fail the save. replica_ship reconnects it
+     * (with a full snapshot) when it can; until then, in sync mode, every
+     * save that only reached the local file is reported on stderr.
+     */
+    if (st == ATM_OK && ctx->replica.addr[0]) {
+        TRACE_BEGIN_EVENT(TRACE_REPLICATE, ctx->replica.seq + 1);
+        AtmStatus rs = replica_ship(&ctx->replica, &ctx->store, crcs ? ctx->reload.base : NULL);
+        TRACE_END_EVENT(TRACE_REPLICATE, rs, ctx->replica.seq);
+        if (rs != ATM_OK) {
+            replica_mark_resync(&ctx->replica);
+            if (ctx->replica.sync) {
+                fprintf(stderr, "replica: save not replicated, standby unreachable (%s)\n",
+                        atm_status_name(rs));
+            }
+        }
+    }
+    if (st == ATM_OK) {
+        /* The save has landed: a history gap is reported and closed by a new segment. */
+        AtmStatus hs = history_log(&ctx->history, &ctx->store, crcs ? ctx->reload.base : NULL);
+        if (hs != ATM_OK) {
+            fprintf(stderr, "history: logging a save failed (%s)\n", atm_status_name(hs));
+            history_mark_resync(&ctx->history);
+        }
+    }
+    if (st == ATM_OK) {
+        /* Best effort: a view that cannot grow keeps its last values. */
+        shmview_publish(&ctx->view, &ctx->store, crcs ? ctx->reload.base : NULL);
+    }
+
+    TRACE_END_EVENT(TRACE_PERSIST, st, ctx->store.size);
+    record_op(RECORD_PERSIST, st);
+    return st;
+}
+
+AtmStatus atm_refresh(AtmContext *ctx, Account **session, ReloadReport *report) {
+    if (!ctx) return ATM_ERR_INTERNAL;
+
+    ReloadFileId file;
+    if (!reload_pending(&ctx->reload, ctx->db_path, &file)) {
+        return ATM_OK;
+    }
+
+    TRACE_BEGIN_EVENT(TRACE_RELOAD, 0);
+
+    AccountStore incoming;
+    AtmStatus    st = account_store_init(&incoming);
+    if (st == ATM_OK) {
+        st = ctx->use_json ? account_store_load_json(&incoming, ctx->db_path)
+                           : account_store_load(&incoming, ctx->db_path);
+    }
+    if (st != ATM_OK) {
+        account_store_free(&incoming);
+        TRACE_END_EVENT(TRACE_RELOAD, st, 0);
+        return st;
+    }
+
+    char session_id[MAX_ACCOUNT_ID_LEN] = "";
+    if (session && *session) {
+        strcpy(session_id, (*session)->id);
+    }
+
+    ReloadReport local;
+    if (!report) report = &local;
+
+    st = reload_apply(&ctx->reload, &ctx->store, &incoming, &file, report);
+
+    if (report->removed) {
+        replica_mark_resync(&ctx->replica);
+        history_mark_resync(&ctx->history);
+    }
+    if (report->updated || report->added || report->removed) {
+        shmview_publish(&ctx->view, &ctx->store, NULL);
+    }
+
+    /* Added records are appended; the filter must know their IDs. */
+    for (size_t i = ctx->store.size - report->added; i < ctx->store.size; ++i) {
+        bloom_add(&ctx->id_filter, ctx->store.items[i].id);
+    }
+    if (session && *session) {
+        *session = account_store_find(&ctx->store, session_id);
+    }
+
+    account_store_free(&incoming);
+    TRACE_END_EVENT(TRACE_RELOAD, st, report->updated + report->added + report->removed);
+    return st;
+}
+
+/* Drops the persisted filter so it is rebuilt from the current contents. */
+static void atm_rebuild_id_filter(AtmContext *ctx) {
+    char path[MAX_DB_PATH_LEN + sizeof(BLOOM_FILE_SUFFIX)];
+    snprintf(path, sizeof(path), "%s%s", ctx->db_path, BLOOM_FILE_SUFFIX);
+    remove(path);
+    bloom_free(&ctx->id_filter);
+    atm_load_id_filter(ctx);
+}
+
+AtmStatus atm_store_replaced(AtmContext *ctx) {
+    if (!ctx) return ATM_ERR_INTERNAL;
+
+    atm_rebuild_id_filter(ctx);
+    history_mark_resync(&ctx->history);
+
+    return atm_persist(ctx);
+}
+
+int atm_valid_field(const char *text, size_t cap) {
+    size_t n = text ? strlen(text) : 0;
+    if (n == 0 || n >= cap) {
+        return 0;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)text[i];
+        if (c < 0x20 || c == ',' || c == '"' || c == '\\') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Admin changes start from the file as it is now: their save overwrites nothing unseen. */
+static AtmStatus atm_admin_begin(AtmContext *ctx, Account **session) {
+    AtmStatus st = atm_refresh(ctx, session, NULL);
+    return (st == ATM_ERR_CONFLICT) ? ATM_OK : st;
+}
+
+/* Drops the tombstones; every reader of record positions must start over. */
+static size_t atm_drop_tombstones(AtmContext *ctx, Account **session) {
+    char session_id[MAX_ACCOUNT_ID_LEN] = "";
+    if (session && *session) {
+        strcpy(session_id, (*session)->id);
+    }
+
+    size_t dropped = account_store_compact(&ctx->store);
+    if (dropped) {
+        replica_mark_resync(&ctx->replica);
+        history_mark_resync(&ctx->history);
+        atm_rebuild_id_filter(ctx);
+    }
+    if (session && *session) {
+        *session = account_store_find(&ctx->store, session_id);
+    }
+    return dropped;
+}
+
+AtmStatus atm_open_account(AtmContext *ctx, const char *account_id, const char *holder,
+                           const char *pin, double balance, Account **session) {
+    if (!ctx) return ATM_ERR_INTERNAL;
+    if (!atm_valid_field(account_id, MAX_ACCOUNT_ID_LEN) ||
+        !atm_valid_field(holder, MAX_NAME_LEN) || !atm_valid_field(pin, MAX_PIN_LEN)) {
+        return ATM_ERR_PARSE;
+    }
+    if (!(balance >= 0.0) || balance > ACCOUNT_MAX_BALANCE) {
+        return ATM_ERR_INVALID_AMOUNT;
+    }
+
+    Account acc;
+    memset(&acc, 0, sizeof(acc));
+    strcpy(acc.id, account_id);
+    strcpy(acc.holder_name, holder);
+    acc.balance  = balance;
+    AtmStatus st = auth_set_pin(&acc, pin);
+    if (st == ATM_OK) {
+        st = atm_admin_begin(ctx, session);
+    }
+    if (st == ATM_OK) {
+        st = account_open(&ctx->store, &acc, NULL);
+    }
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    bloom_add(&ctx->id_filter, acc.id);
+    return atm_persist(ctx);
+}
+
+AtmStatus atm_close_account(AtmContext *ctx, const char *account_id, Account **session) {
+    if (!ctx || !account_id) return ATM_ERR_INTERNAL;
+
+    AtmStatus st = atm_admin_begin(ctx, session);
+    if (st == ATM_OK) {
+        st = account_close(&ctx->store, account_id);
+    }
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    if (session && *session && account_is_closed(*session)) {
+        *session = NULL;
+    }
+    size_t closed = account_store_closed(&ctx->store);
+    if (closed >= ATM_COMPACT_MIN_CLOSED && closed * ATM_COMPACT_RATIO >= ctx->store.size) {
+        atm_drop_tombstones(ctx, session);
+    }
+    return atm_persist(ctx);
+}
+
+AtmStatus atm_compact(AtmContext *ctx, Account **session, size_t *dropped) {
+    if (!ctx) return ATM_ERR_INTERNAL;
+
+    AtmStatus st = atm_admin_begin(ctx, session);
+    size_t    n  = 0;
+    if (st == ATM_OK) {
+        n = atm_drop_tombstones(ctx, session);
+    }
+    if (dropped) {
+        *dropped = n;
+    }
+    return (st == ATM_OK && n) ? atm_persist(ctx) : st;
+}
+
+AtmStatus atm_commit(AtmContext *ctx, Account **session) {
+    AtmStatus st = atm_refresh(ctx, session, NULL);
+    if (st != ATM_OK && st != ATM_ERR_CONFLICT) {
+        return st;
+    }
+
+    AtmStatus saved = atm_persist(ctx);
+    return saved != ATM_OK ? saved : st;
+}
+
+/*
+ * Splits "from_id,to_id,amount[,key]" (line end included) into `t` and
+ * `key`. Fields that do not fit are rejected rather than cut, so a row
+ * can never name a different account; the amount must be a finite number.
+ */
+static AtmStatus atm_parse_transfer_line(char *line, AccountTransfer *t,
+                                         char key[IDEM_MAX_KEY_LEN]) {
+    char  *fields[4];
+    size_t n = 0;
+
+    line[strcspn(line, "\r\n")] = '\0';
+    fields[n++] = line;
+    for (char *p = line; *p; ++p) {
+        if (*p == ',') {
+            if (n == 4) {
+                return ATM_ERR_PARSE;
+            }
+            *p          = '\0';
+            fields[n++] = p + 1;
+        }
+    }
+    while (*fields[0] == ' ' || *fields[0] == '\t') {
+        fields[0]++;
+    }
+    if (n < 3 || fields[0][0] == '\0' || fields[1][0] == '\0' ||
+        strlen(fields[0]) >= MAX_ACCOUNT_ID_LEN || strlen(fields[1]) >= MAX_ACCOUNT_ID_LEN ||
+        (n == 4 && (fields[3][0] == '\0' || strlen(fields[3]) >= IDEM_MAX_KEY_LEN))) {
+        return ATM_ERR_PARSE;
+    }
+
+    char *end = NULL;
+    errno     = 0;
+    double v  = strtod(fields[2], &end);
+    if (end == fields[2] || *end != '\0' || errno != 0 || !isfinite(v)) {
+        return ATM_ERR_PARSE;
+    }
+
+    strcpy(t->from_id, fields[0]);
+    strcpy(t->to_id, fields[1]);
+    t->amount = v;
+    strcpy(key, n == 4 ? fields[3] : "");
+    return ATM_OK;
+}
+
+AtmStatus atm_transfer_batch(AtmContext *ctx, FILE *in, FILE *out) {
+    if (!ctx || !in || !out) return ATM_ERR_INTERNAL;
+
+    AccountTransfer *items    = NULL;
+    AtmStatus       *results  = NULL;
+    char           (*keys)[IDEM_MAX_KEY_LEN] = NULL;
+    size_t           count    = 0;
+    size_t           capacity = 0;
+    char             line[MAX_LINE_LEN];
+
+    /* Read the whole batch first so it can be applied and persisted once. */
+    while (fgets(line, sizeof(line), in)) {
+        size_t len = strlen(line);
+        int    cut = (len == sizeof(line) - 1 && line[len - 1] != '\n');
+        if (cut) {
+            /* Overlong: skip the rest of the line and report it as one bad row. */
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') {
+            }
+        }
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+
+        if (count == capacity) {
+            size_t new_cap = capacity ? capacity * 2 : 64;
+            AccountTransfer *ti = realloc(items, new_cap * sizeof(*ti));
+            if (ti) items = ti;
+            AtmStatus *tr = ti ? realloc(results, new_cap * sizeof(*tr)) : NULL;
+            if (tr) results = tr;
+            char (*tk)[IDEM_MAX_KEY_LEN] = tr ? realloc(keys, new_cap * sizeof(*tk)) : NULL;
+            if (tk) keys = tk;
+            if (!ti || !tr || !tk) {
+                free(items);
+                free(results);
+                free(keys);
+                return ATM_ERR_INTERNAL;
+            }
+            capacity = new_cap;
+        }
+
+        AccountTransfer *t = &items[count];
+        memset(t, 0, sizeof(*t));
+        keys[count][0] = '\0';
+        results[count] = cut ? ATM_ERR_PARSE : atm_parse_transfer_line(line, t, keys[count]);
+        count++;
+    }
+
+    /* Apply the well-formed entries in order; unparsable ones keep ATM_ERR_PARSE. */
+    for (size_t i = 0; i < count; ++i) {
+        if (results[i] == ATM_OK) {
+            results[i] = atm_transfer(ctx, items[i].from_id, items[i].to_id,
+                                      items[i].amount, keys[i]);
+        }
+    }
+
+    AtmStatus st = atm_persist(ctx);
+    for (size_t i = 0; i < count; ++i) {
+        AtmStatus r = results[i];
+        if (r == ATM_OK && st != ATM_OK) {
+            r = st; /* applied, but the batch was not saved */
+        }
+        fprintf(out, "%zu %d %s\n", i + 1, (int)r, atm_status_name(r));
+    }
+
+    free(items);
+    free(results);
+    free(keys);
+    return st;
+}
+
+const char *atm_status_name(AtmStatus status) {
+    switch (status) {
+    case ATM_OK:                     return "OK";
+    case ATM_ERR_IO:                 return "ERR_IO";
+    case ATM_ERR_PARSE:              return "ERR_PARSE";
+    case ATM_ERR_NOT_FOUND:          return "ERR_NOT_FOUND";
+    case ATM_ERR_AUTH_FAILED:        return "ERR_AUTH_FAILED";
+    case ATM_ERR_LOCKED:             return "ERR_LOCKED";
+    case ATM_ERR_INVALID_AMOUNT:     return "ERR_INVALID_AMOUNT";
+    case ATM_ERR_INSUFFICIENT_FUNDS: return "ERR_INSUFFICIENT_FUNDS";
+    case ATM_ERR_CHECKSUM:           return "ERR_CHECKSUM";
+    case ATM_ERR_THROTTLED:          return "ERR_THROTTLED";
+    case ATM_ERR_CONFLICT:           return "ERR_CONFLICT";
+    case ATM_ERR_INTERNAL:
+    default:                         return "ERR_INTERNAL";
     }
-    return account_store_save(&ctx->store, ctx->db_path);
 }
 
 static void atm_print_status_from_code(AtmStatus status) {
@@ -222,6 +822,15 @@ static void atm_print_status_from_code(AtmStatus status) {
     case ATM_ERR_INSUFFICIENT_FUNDS:
         ui_print_error("Insufficient funds for transaction.");
         break;
+    case ATM_ERR_CHECKSUM:
+        ui_print_error("Account database record failed its checksum. The file may be corrupted.");
+        break;
+    case ATM_ERR_THROTTLED:
+        ui_print_error("Too many failed attempts. Please wait before trying again.");
+        break;
+    case ATM_ERR_CONFLICT:
+        ui_print_error("The database file was edited externally. Records also changed here kept their local values.");
+        break;
     case ATM_ERR_INTERNAL:
     default:
         ui_print_error("Internal error occurred.");
@@ -6,12 +6,21 @@
  *
  * Description:
  *   Implementation of PIN hashing and login verification logic.
- *   Note: This is a demonstration-only, non-cryptographic hash.
+ *   New PINs use salted PBKDF2-HMAC-SHA256 with a tunable cost; the
+ *   original unsalted FNV-1a hash is still recognised for old records
+ *   and upgraded on the next successful login.
  */
 
 #include "auth.h"
+#include "parallel.h"
+#include "sha256.h"
+#include "trace.h"
 
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
+
+static unsigned auth_cost = AUTH_KDF_DEFAULT_COST;
 
 uint32_t auth_hash_pin(const char *pin) {
     /* FNV-1a style 32-bit hash (not cryptographically secure). */
@@ -28,6 +37,149 @@ uint32_t auth_hash_pin(const char *pin) {
     return hash;
 }
 
+void auth_set_kdf_cost(unsigned cost) {
+    if (cost < AUTH_KDF_MIN_COST) cost = AUTH_KDF_MIN_COST;
+    if (cost > AUTH_KDF_MAX_COST) cost = AUTH_KDF_MAX_COST;
+    auth_cost = cost;
+}
+
+unsigned auth_kdf_cost(void) {
+    return auth_cost;
+}
+
+/*
+ * Salt source: the OS random device where there is one. Elsewhere, a
+ * SHA-256 of the clock, a counter, and stack addresses — unique per
+ * call, which is all a salt needs.
+ */
+static void auth_random_bytes(uint8_t *out, size_t len) {
+    static FILE *urandom = NULL;
+    static int   tried   = 0;
+
+    if (!tried) {
+        urandom = fopen("/dev/urandom", "rb");
+        tried   = 1;
+    }
+    if (urandom && fread(out, 1, len, urandom) == len) {
+        return;
+    }
+
+    static uint64_t counter = 0;
+    while (len > 0) {
+        struct {
+            time_t   now;
+            clock_t  ticks;
+            uint64_t count;
+            void    *where;
+        } seed;
+        seed.now   = time(NULL);
+        seed.ticks = clock();
+        seed.count = ++counter;
+        seed.where = &seed;
+
+        uint8_t digest[SHA256_DIGEST_LEN];
+        Sha256  ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, &seed, sizeof(seed));
+        sha256_final(&ctx, digest);
+
+        size_t take = len < sizeof(digest) ? len : sizeof(digest);
+        memcpy(out, digest, take);
+        out += take;
+        len -= take;
+    }
+}
+
+static int auth_ct_equal(const uint8_t *a, const uint8_t *b, size_t len) {
+    volatile uint8_t diff = 0;
+    for (size_t i = 0; i < len; ++i) {
+        diff |= (uint8_t)(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+/* Input to the KDF for a wrapped legacy hash: FNV-1a as 4 big-endian bytes. */
+static void auth_fnv_bytes(uint32_t h, uint8_t out[4]) {
+    out[0] = (uint8_t)(h >> 24);
+    out[1] = (uint8_t)(h >> 16);
+    out[2] = (uint8_t)(h >> 8);
+    out[3] = (uint8_t)h;
+}
+
+AtmStatus auth_set_pin(Account *account, const char *pin) {
+    if (!account || !pin) return ATM_ERR_INTERNAL;
+
+    auth_random_bytes(account->pin_salt, AUTH_SALT_LEN);
+    pbkdf2_sha256(pin, strlen(pin), account->pin_salt, AUTH_SALT_LEN,
+                  (uint32_t)1 << auth_cost, account->pin_kdf);
+
+    account->hash_version = AUTH_HASH_PBKDF2;
+    account->kdf_cost     = auth_cost;
+    account->pin_hash     = 0; /* the legacy hash is no longer kept */
+    return ATM_OK;
+}
+
+AtmStatus auth_replace_pin(Account *account, const char *pin) {
+    if (!account || !pin) return ATM_ERR_INTERNAL;
+
+    uint8_t legacy[4];
+    switch (account->hash_version) {
+    case AUTH_HASH_FNV1A:
+        account->pin_hash = auth_hash_pin(pin);
+        return ATM_OK;
+
+    case AUTH_HASH_PBKDF2:
+    case AUTH_HASH_PBKDF2_FNV:
+        if (account->kdf_cost < AUTH_KDF_MIN_COST || account->kdf_cost > AUTH_KDF_MAX_COST) {
+            return ATM_ERR_INTERNAL;
+        }
+        auth_random_bytes(account->pin_salt, AUTH_SALT_LEN);
+        if (account->hash_version == AUTH_HASH_PBKDF2) {
+            pbkdf2_sha256(pin, strlen(pin), account->pin_salt, AUTH_SALT_LEN,
+                          (uint32_t)1 << account->kdf_cost, account->pin_kdf);
+        } else {
+            auth_fnv_bytes(auth_hash_pin(pin), legacy);
+            pbkdf2_sha256(legacy, sizeof(legacy), account->pin_salt, AUTH_SALT_LEN,
+                          (uint32_t)1 << account->kdf_cost, account->pin_kdf);
+        }
+        return ATM_OK;
+
+    default:
+        return ATM_ERR_INTERNAL;
+    }
+}
+
+static int auth_pin_matches(const Account *account, const char *pin) {
+    uint8_t derived[AUTH_KDF_LEN];
+
+    switch (account->hash_version) {
+    case AUTH_HASH_FNV1A: {
+        uint8_t a[4], b[4];
+        auth_fnv_bytes(auth_hash_pin(pin), a);
+        auth_fnv_bytes(account->pin_hash, b);
+        return auth_ct_equal(a, b, sizeof(a));
+    }
+
+    case AUTH_HASH_PBKDF2:
+        if (account->kdf_cost > AUTH_KDF_MAX_COST) return 0;
+        pbkdf2_sha256(pin, strlen(pin), account->pin_salt, AUTH_SALT_LEN,
+                      (uint32_t)1 << account->kdf_cost, derived);
+        return auth_ct_equal(derived, account->pin_kdf, AUTH_KDF_LEN);
+
+    case AUTH_HASH_PBKDF2_FNV: {
+        uint8_t legacy[4];
+        if (account->kdf_cost > AUTH_KDF_MAX_COST) return 0;
+        auth_fnv_bytes(auth_hash_pin(pin), legacy);
+        pbkdf2_sha256(legacy, sizeof(legacy), account->pin_salt, AUTH_SALT_LEN,
+                      (uint32_t)1 << account->kdf_cost, derived);
+        return auth_ct_equal(derived, account->pin_kdf, AUTH_KDF_LEN);
+    }
+
+    default:
+        return 0;
+    }
+}
+
 AtmStatus auth_verify_login(Account *account, const char *pin) {
     if (!account || !pin) {
         return ATM_ERR_INTERNAL;
@@ -37,11 +189,17 @@ AtmStatus auth_verify_login(Account *account, const char *pin) {
         return ATM_ERR_LOCKED;
     }
 
-    uint32_t h = auth_hash_pin(pin);
-    if (h == account->pin_hash) {
+    /* Traced with the upgrade: it costs one more KDF run. */
+    TRACE_BEGIN_EVENT(TRACE_AUTH, account->kdf_cost);
+    if (auth_pin_matches(account, pin)) {
         account->failed_attempts = 0;
+        if (account->hash_version != AUTH_HASH_PBKDF2 || account->kdf_cost < auth_cost) {
+            auth_set_pin(account, pin);
+        }
+        TRACE_END_EVENT(TRACE_AUTH, ATM_OK, account->kdf_cost);
         return ATM_OK;
     }
+    TRACE_END_EVENT(TRACE_AUTH, ATM_ERR_AUTH_FAILED, account->kdf_cost);
 
     /* Wrong PIN */
     account->failed_attempts++;
@@ -52,3 +210,147 @@ AtmStatus auth_verify_login(Account *account, const char *pin) {
 
     return ATM_ERR_AUTH_FAILED;
 }
+
+/* ---------------------------------------------------------------------- */
+/* Bulk migration                                                         */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    AccountStore *store;
+    uint32_t      iterations;
+    unsigned      cost;
+} AuthRehashJob;
+
+static void auth_rehash_range(void *arg, size_t begin, size_t end) {
+    AuthRehashJob *job = (AuthRehashJob *)arg;
+
+    Account       *lanes[SHA256_LANES];
+    uint8_t        inputs[SHA256_LANES][4];
+    const void    *passwords[SHA256_LANES];
+    size_t         lens[SHA256_LANES];
+    const uint8_t *salts[SHA256_LANES];
+    uint8_t        out[SHA256_LANES][SHA256_DIGEST_LEN];
+    int            filled = 0;
+
+    for (size_t i = begin; i <= end; ++i) {
+        if (i < end) {
+            Account *acc = &job->store->items[i];
+            if (acc->hash_version != AUTH_HASH_FNV1A || account_is_closed(acc)) {
+                continue;
+            }
+            auth_fnv_bytes(acc->pin_hash, inputs[filled]);
+            lanes[filled++] = acc;
+            if (filled < SHA256_LANES) {
+                continue;
+            }
+        }
+        if (filled == 0) {
+            break;
+        }
+
+        /* Idle lanes (final partial group) repeat lane 0's work. */
+        for (int l = 0; l < SHA256_LANES; ++l) {
+            Account *acc = lanes[l < filled ? l : 0];
+            passwords[l] = inputs[l < filled ? l : 0];
+            lens[l]      = 4;
+            salts[l]     = acc->pin_salt;
+        }
+        pbkdf2_sha256_x4(passwords, lens, salts, AUTH_SALT_LEN, job->iterations, out);
+
+        for (int l = 0; l < filled; ++l) {
+            memcpy(lanes[l]->pin_kdf, out[l], AUTH_KDF_LEN);
+            lanes[l]->hash_version = AUTH_HASH_PBKDF2_FNV;
+            lanes[l]->kdf_cost     = job->cost;
+            lanes[l]->pin_hash     = 0;
+        }
+        filled = 0;
+    }
+}
+
+AtmStatus auth_rehash_store(AccountStore *store, unsigned threads, size_t *upgraded) {
+    if (!store) return ATM_ERR_INTERNAL;
+
+    /* Salts are drawn up front, on this thread, from one random stream. */
+    size_t count = 0;
+    for (size_t i = 0; i < store->size; ++i) {
+        if (store->items[i].hash_version == AUTH_HASH_FNV1A &&
+            !account_is_closed(&store->items[i])) {
+            auth_random_bytes(store->items[i].pin_salt, AUTH_SALT_LEN);
+            count++;
+        }
+    }
+
+    AuthRehashJob job;
+    job.store      = store;
+    job.cost       = auth_cost;
+    job.iterations = (uint32_t)1 << auth_cost;
+
+    AtmStatus st = parallel_for(store->size, threads, auth_rehash_range, &job);
+    if (upgraded) {
+        *upgraded = (st == ATM_OK) ? count : 0;
+    }
+    return st;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Bulk onboarding                                                        */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    Account *const    *accounts;
+    const char *const *pins;
+    size_t             count;
+    uint32_t           iterations;
+    unsigned           cost;
+} AuthSetPinsJob;
+
+/* Works on whole groups of SHA256_LANES accounts, so only the last group can be partial. */
+static void auth_set_pins_group(void *arg, size_t begin, size_t end) {
+    AuthSetPinsJob *job = (AuthSetPinsJob *)arg;
+
+    const void    *passwords[SHA256_LANES];
+    size_t         lens[SHA256_LANES];
+    const uint8_t *salts[SHA256_LANES];
+    uint8_t        out[SHA256_LANES][SHA256_DIGEST_LEN];
+
+    for (size_t g = begin; g < end; ++g) {
+        size_t i      = g * SHA256_LANES;
+        size_t filled = (job->count - i < SHA256_LANES) ? job->count - i : SHA256_LANES;
+
+        /* Idle lanes (final partial group) repeat lane 0's work. */
+        for (size_t l = 0; l < SHA256_LANES; ++l) {
+            size_t k     = i + (l < filled ? l : 0);
+            passwords[l] = job->pins[k];
+            lens[l]      = strlen(job->pins[k]);
+            salts[l]     = job->accounts[k]->pin_salt;
+        }
+        pbkdf2_sha256_x4(passwords, lens, salts, AUTH_SALT_LEN, job->iterations, out);
+
+        for (size_t l = 0; l < filled; ++l) {
+            Account *acc = job->accounts[i + l];
+            memcpy(acc->pin_kdf, out[l], AUTH_KDF_LEN);
+            acc->hash_version = AUTH_HASH_PBKDF2;
+            acc->kdf_cost     = job->cost;
+            acc->pin_hash     = 0;
+        }
+    }
+}
+
+AtmStatus auth_set_pins(Account *const *accounts, const char *const *pins, size_t count,
+                        unsigned threads) {
+    if ((!accounts || !pins) && count > 0) return ATM_ERR_INTERNAL;
+
+    for (size_t i = 0; i < count; ++i) {
+        auth_random_bytes(accounts[i]->pin_salt, AUTH_SALT_LEN);
+    }
+
+    AuthSetPinsJob job;
+    job.accounts   = accounts;
+    job.pins       = pins;
+    job.count      = count;
+    job.cost       = auth_cost;
+    job.iterations = (uint32_t)1 << auth_cost;
+
+    size_t groups = (count + SHA256_LANES - 1) / SHA256_LANES;
+    return parallel_for(groups, threads, auth_set_pins_group, &job);
+}
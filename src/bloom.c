@@ -0,0 +1,218 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      bloom.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Bloom filter implementation using double hashing over a 64-bit
+ *   FNV-1a hash of the account ID. The sidecar file is a small header
+ *   followed by the raw bit array in host byte order.
+ */
+
+#include "bloom.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char BLOOM_MAGIC[8] = { 'A', 'T', 'M', 'B', 'L', 'M', '1', '\0' };
+
+typedef struct {
+    char     magic[8];
+    uint64_t nbits;
+    uint64_t nitems;
+    uint64_t digest;
+    uint32_t nhashes;
+    uint32_t reserved;
+} BloomFileHeader;
+
+static uint64_t bloom_hash_key(const char *key) {
+    const uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const uint64_t FNV_PRIME  = 1099511628211ull;
+
+    uint64_t hash = FNV_OFFSET;
+    const unsigned char *p = (const unsigned char *)key;
+    size_t n = 0;
+
+    while (*p && n++ < MAX_ACCOUNT_ID_LEN) {
+        hash ^= (uint64_t)(*p++);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/* Second, independent hash derived from the first (splitmix64 finalizer). */
+static uint64_t bloom_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+AtmStatus bloom_init(BloomFilter *bf, size_t expected_items, double fp_rate) {
+    if (!bf) return ATM_ERR_INTERNAL;
+    if (fp_rate <= 0.0 || fp_rate >= 1.0) fp_rate = BLOOM_TARGET_FP_RATE;
+    if (expected_items == 0) expected_items = 1;
+
+    /* m = -n ln p / (ln 2)^2, k = m/n ln 2 */
+    const double ln2 = 0.69314718055994530942;
+    double m = -(double)expected_items * log(fp_rate) / (ln2 * ln2);
+    uint64_t nbits = (uint64_t)m;
+    nbits = (nbits + 63) & ~(uint64_t)63;
+    if (nbits < 64) nbits = 64;
+
+    uint32_t k = (uint32_t)((double)nbits / (double)expected_items * ln2 + 0.5);
+    if (k < 1) k = 1;
+    if (k > 16) k = 16;
+
+    uint64_t *bits = calloc((size_t)(nbits / 64), sizeof(uint64_t));
+    if (!bits) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    bf->bits    = bits;
+    bf->nbits   = nbits;
+    bf->nhashes = k;
+    bf->nitems  = 0;
+    bf->digest  = 0;
+    return ATM_OK;
+}
+
+void bloom_free(BloomFilter *bf) {
+    if (!bf) return;
+    free(bf->bits);
+    bf->bits    = NULL;
+    bf->nbits   = 0;
+    bf->nhashes = 0;
+    bf->nitems  = 0;
+    bf->digest  = 0;
+}
+
+void bloom_add(BloomFilter *bf, const char *key) {
+    if (!bf || !bf->bits || !key) return;
+
+    uint64_t h1 = bloom_hash_key(key);
+    uint64_t h2 = bloom_mix(h1) | 1;
+
+    for (uint32_t i = 0; i < bf->nhashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % bf->nbits;
+        bf->bits[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    }
+
+    bf->nitems++;
+    bf->digest += bloom_mix(h1);
+}
+
+int bloom_maybe_contains(const BloomFilter *bf, const char *key) {
+    /* Without a filter we cannot rule anything out. */
+    if (!bf || !bf->bits) return 1;
+    if (!key) return 0;
+
+    uint64_t h1 = bloom_hash_key(key);
+    uint64_t h2 = bloom_mix(h1) | 1;
+
+    for (uint32_t i = 0; i < bf->nhashes; ++i) {
+        uint64_t bit = (h1 + i * h2) % bf->nbits;
+        if (!(bf->bits[bit >> 6] & ((uint64_t)1 << (bit & 63)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+uint64_t bloom_store_digest(const AccountStore *store) {
+    uint64_t digest = 0;
+    if (!store) return digest;
+
+    /* A sum, not XOR: two copies of an ID must not cancel out. */
+    for (size_t i = 0; i < store->size; ++i) {
+        digest += bloom_mix(bloom_hash_key(store->items[i].id));
+    }
+    return digest;
+}
+
+AtmStatus bloom_build(BloomFilter *bf, const AccountStore *store) {
+    if (!bf || !store) return ATM_ERR_INTERNAL;
+
+    AtmStatus st = bloom_init(bf, store->size, BLOOM_TARGET_FP_RATE);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    for (size_t i = 0; i < store->size; ++i) {
+        bloom_add(bf, store->items[i].id);
+    }
+    return ATM_OK;
+}
+
+AtmStatus bloom_save(const BloomFilter *bf, const char *path) {
+    if (!bf || !bf->bits || !path) return ATM_ERR_INTERNAL;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        return ATM_ERR_IO;
+    }
+
+    BloomFileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, BLOOM_MAGIC, sizeof(hdr.magic));
+    hdr.nbits   = bf->nbits;
+    hdr.nitems  = bf->nitems;
+    hdr.digest  = bf->digest;
+    hdr.nhashes = bf->nhashes;
+
+    size_t words = (size_t)(bf->nbits / 64);
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(bf->bits, sizeof(uint64_t), words, f) != words) {
+        fclose(f);
+        return ATM_ERR_IO;
+    }
+
+    if (fclose(f) != 0) {
+        return ATM_ERR_IO;
+    }
+    return ATM_OK;
+}
+
+AtmStatus bloom_load(BloomFilter *bf, const char *path) {
+    if (!bf || !path) return ATM_ERR_INTERNAL;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ATM_ERR_NOT_FOUND;
+    }
+
+    BloomFileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, BLOOM_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.nbits == 0 || (hdr.nbits & 63) != 0 ||
+        hdr.nhashes == 0 || hdr.nhashes > 16) {
+        fclose(f);
+        return ATM_ERR_PARSE;
+    }
+
+    size_t words = (size_t)(hdr.nbits / 64);
+    uint64_t *bits = malloc(words * sizeof(uint64_t));
+    if (!bits) {
+        fclose(f);
+        return ATM_ERR_INTERNAL;
+    }
+
+    if (fread(bits, sizeof(uint64_t), words, f) != words) {
+        free(bits);
+        fclose(f);
+        return ATM_ERR_PARSE;
+    }
+    fclose(f);
+
+    bf->bits    = bits;
+    bf->nbits   = hdr.nbits;
+    bf->nhashes = hdr.nhashes;
+    bf->nitems  = hdr.nitems;
+    bf->digest  = hdr.digest;
+    return ATM_OK;
+}
@@ -0,0 +1,132 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      crc32c.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   CRC32C implementation. The hardware path is compiled with a per-function
+ *   target attribute and selected at runtime, so the binary still runs on
+ *   CPUs without SSE4.2 and builds with compilers that lack the intrinsics.
+ */
+
+#include "crc32c.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define CRC32C_HAVE_SSE42 1
+#  include <nmmintrin.h>
+#else
+#  define CRC32C_HAVE_SSE42 0
+#endif
+
+#define CRC32C_POLY 0x82F63B78u /* reflected Castagnoli polynomial */
+
+static uint32_t crc32c_table[8][256];
+static int      crc32c_table_ready = 0;
+
+static void crc32c_init_table(void) {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc32c_table[0][n] = c;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = crc32c_table[0][n];
+        for (int t = 1; t < 8; ++t) {
+            c = crc32c_table[0][c & 0xFF] ^ (c >> 8);
+            crc32c_table[t][n] = c;
+        }
+    }
+    crc32c_table_ready = 1;
+}
+
+/* Portable slicing-by-8 (little-endian word loads, bytewise otherwise). */
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char *p, size_t len) {
+    if (!crc32c_table_ready) {
+        crc32c_init_table();
+    }
+
+    const uint16_t endian_probe = 1;
+    if (*(const unsigned char *)&endian_probe == 1) {
+        while (len >= 8) {
+            uint32_t lo, hi;
+            memcpy(&lo, p, 4);
+            memcpy(&hi, p + 4, 4);
+            lo ^= crc;
+            crc = crc32c_table[7][lo & 0xFF] ^
+                  crc32c_table[6][(lo >> 8) & 0xFF] ^
+                  crc32c_table[5][(lo >> 16) & 0xFF] ^
+                  crc32c_table[4][lo >> 24] ^
+                  crc32c_table[3][hi & 0xFF] ^
+                  crc32c_table[2][(hi >> 8) & 0xFF] ^
+                  crc32c_table[1][(hi >> 16) & 0xFF] ^
+                  crc32c_table[0][hi >> 24];
+            p   += 8;
+            len -= 8;
+        }
+    }
+
+    while (len--) {
+        crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if CRC32C_HAVE_SSE42
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len) {
+#  if defined(__x86_64__)
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c    = _mm_crc32_u64(c, v);
+        p   += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+#  endif
+    while (len >= 4) {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        crc  = _mm_crc32_u32(crc, v);
+        p   += 4;
+        len -= 4;
+    }
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+/* -1 = not probed yet, 0 = software, 1 = SSE4.2 */
+static int crc32c_use_hw = -1;
+
+int crc32c_hw_available(void) {
+    if (crc32c_use_hw < 0) {
+#if CRC32C_HAVE_SSE42
+        __builtin_cpu_init();
+        crc32c_use_hw = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#else
+        crc32c_use_hw = 0;
+#endif
+    }
+    return crc32c_use_hw;
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    const unsigned char *p = (const unsigned char *)data;
+    crc = ~crc;
+
+#if CRC32C_HAVE_SSE42
+    if (crc32c_hw_available()) {
+        return ~crc32c_hw(crc, p, len);
+    }
+#endif
+    return ~crc32c_sw(crc, p, len);
+}
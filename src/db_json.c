@@ -11,6 +11,8 @@
  */
 
 #include "db_json.h"
+#include "account_codec.h"
+#include "fileio.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -47,17 +49,6 @@ static char *read_file(const char *path) {
     return buf;
 }
 
-static void normalize(char *s) {
-    if (!s) return;
-    char *p = s;
-    while (*p) {
-        if (*p == '\n' || *p == '\r' || *p == '\t') {
-            *p = ' ';
-        }
-        p++;
-    }
-}
-
 AtmStatus account_store_load_json(AccountStore *store, const char *path) {
     if (!store || !path) return ATM_ERR_INTERNAL;
 
@@ -67,7 +58,6 @@ AtmStatus account_store_load_json(AccountStore *store, const char *path) {
         return ATM_OK;
     }
 
-    normalize(text);
     char *p = text;
 
     /* Locate "accounts" keyword */
@@ -105,46 +95,23 @@ AtmStatus account_store_load_json(AccountStore *store, const char *path) {
          *   "balance": 1500.00,
          *   "pin_hash": 3356862322,
          *   "locked": 0,
-         *   "failed": 0
+         *   "failed": 0,
+         *   "crc32c": "fe0836cc"
          * }
+         * with keys in ACCOUNT_FIELDS order; "crc32c" is optional.
          */
-        int matched = sscanf(
-            p,
-            " { \"id\" : \"%15[^\"]\" ,"
-            " \"holder\" : \"%63[^\"]\" ,"
-            " \"balance\" : %lf ,"
-            " \"pin_hash\" : %u ,"
-            " \"locked\" : %d ,"
-            " \"failed\" : %u",
-            acc.id,
-            acc.holder_name,
-            &acc.balance,
-            &acc.pin_hash,
-            &acc.is_locked,
-            &acc.failed_attempts
-        );
-
-        if (matched != 6) {
-            free(text);
-            return ATM_ERR_PARSE;
+        const char *end = p;
+        AtmStatus   st  = account_parse_json(&end, &acc, NULL);
+        if (st == ATM_OK) {
+            st = account_store_append(store, &acc);
         }
-
-        /* Grow store if needed */
-        if (store->size == store->capacity) {
-            size_t new_cap = (store->capacity == 0) ? 8 : store->capacity * 2;
-            Account *tmp   = realloc(store->items, new_cap * sizeof(Account));
-            if (!tmp) {
-                free(text);
-                return ATM_ERR_INTERNAL;
-            }
-            store->items    = tmp;
-            store->capacity = new_cap;
+        if (st != ATM_OK) {
+            free(text);
+            return st;
         }
 
-        store->items[store->size++] = acc;
-
         /* Move to next object */
-        p = strchr(p, '}');
+        p = strchr(end, '}');
         if (!p) {
             break;
         }
@@ -155,39 +122,94 @@ AtmStatus account_store_load_json(AccountStore *store, const char *path) {
     return ATM_OK;
 }
 
-AtmStatus account_store_save_json(const AccountStore *store, const char *path) {
+AtmStatus account_store_save_json(const AccountStore *store, const char *path, uint32_t *crcs) {
     if (!store || !path) return ATM_ERR_INTERNAL;
 
-    FILE *f = fopen(path, "w");
-    if (!f) {
+    FileReplace out;
+    if (fileio_replace_begin(&out, path) != ATM_OK) {
         return ATM_ERR_IO;
     }
 
-    fprintf(f, "{\n  \"accounts\": [\n");
-
-    for (size_t i = 0; i < store->size; ++i) {
-        const Account *a = &store->items[i];
-
-        fprintf(f,
-                "    {\n"
-                "      \"id\": \"%s\",\n"
-                "      \"holder\": \"%s\",\n"
-                "      \"balance\": %.2f,\n"
-                "      \"pin_hash\": %u,\n"
-                "      \"locked\": %d,\n"
-                "      \"failed\": %u\n"
-                "    }%s\n",
-                a->id,
-                a->holder_name,
-                a->balance,
-                a->pin_hash,
-                a->is_locked,
-                a->failed_attempts,
-                (i + 1 == store->size) ? "" : ",");
+    static const char head[] = "{\n  \"accounts\": [\n";
+    static const char tail[] = "  ]\n}\n";
+
+    int ok = fileio_replace_write(&out, head, sizeof(head) - 1);
+
+    for (size_t i = 0; i < store->size && ok; ++i) {
+        /* Room for the object plus ",\n". */
+        char *dst = fileio_replace_reserve(&out, ACCOUNT_JSON_RECORD_MAX + 2);
+        if (!dst) {
+            ok = 0;
+            break;
+        }
+        size_t len = account_format_json(&store->items[i], dst, crcs ? &crcs[i] : NULL);
+        if (i + 1 != store->size) {
+            dst[len++] = ',';
+        }
+        dst[len++] = '\n';
+        fileio_replace_advance(&out, len);
+    }
+
+    if (ok) {
+        ok = fileio_replace_write(&out, tail, sizeof(tail) - 1);
     }
+    return fileio_replace_commit(&out, ok);
+}
 
-    fprintf(f, "  ]\n}\n");
-    fclose(f);
+AtmStatus account_store_verify_json(const char *path, AccountVerifyReport *report) {
+    if (!path || !report) return ATM_ERR_INTERNAL;
+    memset(report, 0, sizeof(*report));
+
+    char *text = read_file(path);
+    if (!text) {
+        return ATM_ERR_IO;
+    }
+
+    const char *p = strstr(text, "\"accounts\"");
+    p = p ? strchr(p, '[') : NULL;
+    if (!p) {
+        free(text);
+        report->malformed = 1;
+        report->first_bad = 1;
+        return ATM_ERR_PARSE;
+    }
+    p++;
+
+    while (*p) {
+        while (*p == ' ' || *p == ',' || *p == '\n' || *p == '\r' || *p == '\t') {
+            p++;
+        }
+        if (*p == ']' || *p == '\0') {
+            break;
+        }
+
+        Account     acc;
+        const char *end     = p;
+        int         checked = 0;
+        AtmStatus   st      = account_parse_json(&end, &acc, &checked);
+
+        report->records++;
+        if (st == ATM_OK) {
+            if (checked) report->verified++;
+            else         report->unchecked++;
+        } else {
+            if (st == ATM_ERR_CHECKSUM) report->corrupted++;
+            else                        report->malformed++;
+            if (report->first_bad == 0) report->first_bad = report->records;
+            end = p;
+        }
+
+        /* Resynchronize on the end of the object either way. */
+        p = strchr(end, '}');
+        if (!p) {
+            break;
+        }
+        p++;
+    }
+
+    free(text);
 
+    if (report->corrupted) return ATM_ERR_CHECKSUM;
+    if (report->malformed) return ATM_ERR_PARSE;
     return ATM_OK;
 }
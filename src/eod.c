@@ -0,0 +1,423 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      eod.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   End-of-day batch engine (see eod.h). Balances are worked in integer
+ *   cents; one parallel pass applies the rules and digests the store
+ *   before and after, and the checkpoint file brackets the single save.
+ */
+
+#include "eod.h"
+#include "crc32c.h"
+#include "fileio.h"
+#include "parallel.h"
+#include "timeutil.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EOD_DAYS_PER_YEAR 365.0
+
+typedef enum {
+    EOD_STATE_APPLYING,
+    EOD_STATE_COMMITTING,
+    EOD_STATE_DONE
+} EodState;
+
+static const char *const eod_state_names[] = { "applying", "committing", "done" };
+
+typedef struct {
+    char     run[EOD_MAX_RUN_ID_LEN];
+    uint32_t rules;
+    EodState state;
+    uint64_t before;
+    uint64_t after;
+    size_t   accounts;
+    int64_t  interest_cents;
+    int64_t  fee_cents;
+} EodCheckpoint;
+
+/* Per-chunk results, combined in chunk order once all workers finish. */
+typedef struct {
+    uint32_t hash_before;    /* sum of per-account (ID, cents) CRCs */
+    uint32_t hash_after;
+    int64_t  sum_before;
+    int64_t  sum_after;
+    size_t   changed;
+    int64_t  interest;
+    int64_t  fees;
+} EodChunk;
+
+typedef struct {
+    AccountStore   *store;
+    const EodRules *rules;   /* NULL: digest only */
+    EodChunk       *chunks;
+} EodJob;
+
+/* ---------------------------------------------------------------------- */
+/* Rules                                                                  */
+/* ---------------------------------------------------------------------- */
+
+static int eod_parse_cents(const char *tok, int64_t *out) {
+    if (!tok) return 0;
+    char *end = NULL;
+    errno = 0;
+    double v = strtod(tok, &end);
+    if (errno != 0 || *end != '\0' || !isfinite(v) || v < 0.0 || v > 1e15) {
+        return 0;
+    }
+    *out = llround(v * 100.0);
+    return 1;
+}
+
+/* Parses "<keyword> <value>" options after a rule; 0 on anything else. */
+static int eod_parse_threshold(const char *keyword, EodRule *rule) {
+    char *key = strtok(NULL, " \t\r\n");
+    if (!key) {
+        return 1;
+    }
+    if (strcmp(key, keyword) != 0 || !eod_parse_cents(strtok(NULL, " \t\r\n"), &rule->threshold)) {
+        return 0;
+    }
+    rule->has_threshold = 1;
+    return strtok(NULL, " \t\r\n") == NULL;
+}
+
+static int eod_parse_line(EodRules *rules, char *line) {
+    char *hash = strchr(line, '#');
+    if (hash) {
+        *hash = '\0';
+    }
+    char *kw = strtok(line, " \t\r\n");
+    if (!kw) {
+        return 1;
+    }
+
+    if (strcmp(kw, "days") == 0) {
+        char         *arg = strtok(NULL, " \t\r\n");
+        char         *end = NULL;
+        unsigned long v   = arg ? strtoul(arg, &end, 10) : 0;
+        if (!arg || *end != '\0' || v == 0 || v > 366 || strtok(NULL, " \t\r\n")) {
+            return 0;
+        }
+        rules->days = (unsigned)v;
+        return 1;
+    }
+
+    if (rules->count == EOD_MAX_RULES) {
+        return 0;
+    }
+    EodRule *rule = &rules->rules[rules->count];
+    memset(rule, 0, sizeof(*rule));
+
+    if (strcmp(kw, "interest") == 0) {
+        char  *arg = strtok(NULL, " \t\r\n");
+        char  *end = NULL;
+        double pct = arg ? strtod(arg, &end) : 0.0;
+        if (!arg || *end != '\0' || !isfinite(pct) || pct < 0.0 || pct > 100.0 ||
+            !eod_parse_threshold("min", rule)) {
+            return 0;
+        }
+        rule->kind = EOD_RULE_INTEREST;
+        rule->rate = pct / 100.0 / EOD_DAYS_PER_YEAR;
+    } else if (strcmp(kw, "fee") == 0) {
+        if (!eod_parse_cents(strtok(NULL, " \t\r\n"), &rule->cents) ||
+            !eod_parse_threshold("below", rule)) {
+            return 0;
+        }
+        rule->kind = EOD_RULE_FEE;
+    } else {
+        return 0;
+    }
+    rules->count++;
+    return 1;
+}
+
+AtmStatus eod_rules_load(EodRules *rules, const char *path, size_t *bad_line) {
+    if (!rules || !path) return ATM_ERR_INTERNAL;
+
+    memset(rules, 0, sizeof(*rules));
+    rules->days = 1;
+    if (bad_line) *bad_line = 0;
+
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+
+    char   line[MAX_LINE_LEN];
+    size_t lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        rules->digest = crc32c(rules->digest, line, strlen(line));
+        if (!eod_parse_line(rules, line)) {
+            fclose(fp);
+            if (bad_line) *bad_line = lineno;
+            return ATM_ERR_PARSE;
+        }
+    }
+    fclose(fp);
+    return ATM_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Parallel pass                                                          */
+/* ---------------------------------------------------------------------- */
+
+static int64_t eod_apply_rules(const EodRules *rules, int64_t cents, EodChunk *c) {
+    for (size_t r = 0; r < rules->count; ++r) {
+        const EodRule *rule = &rules->rules[r];
+        if (rule->kind == EOD_RULE_INTEREST) {
+            if (cents > 0 && (!rule->has_threshold || cents >= rule->threshold)) {
+                int64_t interest = llround((double)cents * rule->rate * (double)rules->days);
+                cents       += interest;
+                c->interest += interest;
+            }
+        } else if (!rule->has_threshold || cents < rule->threshold) {
+            int64_t fee = rule->cents < cents ? rule->cents : cents;
+            if (fee > 0) {
+                cents   -= fee;
+                c->fees += fee;
+            }
+        }
+    }
+    return cents;
+}
+
+static void eod_chunk_range(void *arg, size_t begin, size_t end) {
+    EodJob *job = (EodJob *)arg;
+
+    for (size_t k = begin; k < end; ++k) {
+        EodChunk *c     = &job->chunks[k];
+        size_t    first = k * EOD_CHUNK_ACCOUNTS;
+        size_t    last  = first + EOD_CHUNK_ACCOUNTS;
+        if (last > job->store->size) {
+            last = job->store->size;
+        }
+        memset(c, 0, sizeof(*c));
+
+        for (size_t i = first; i < last; ++i) {
+            Account *acc   = &job->store->items[i];
+            int64_t  cents = llround(acc->balance * 100.0);
+            uint32_t idh   = crc32c(0, acc->id, strlen(acc->id));
+            c->hash_before += crc32c(idh, &cents, sizeof(cents));
+            c->sum_before += cents;
+
+            if (job->rules && !account_is_closed(acc)) {
+                int64_t next = eod_apply_rules(job->rules, cents, c);
+                if (next != cents) {
+                    acc->balance = (double)next / 100.0;
+                    cents        = next;
+                    c->changed++;
+                }
+            }
+            c->hash_after += crc32c(idh, &cents, sizeof(cents));
+            c->sum_after += cents;
+        }
+    }
+}
+
+/* 64-bit store digest: CRC of the chunk hashes, and the balance total. */
+static uint64_t eod_digest(const EodChunk *chunks, size_t n, int after) {
+    uint32_t crc = 0;
+    int64_t  sum = 0;
+    for (size_t k = 0; k < n; ++k) {
+        uint32_t part = after ? chunks[k].hash_after : chunks[k].hash_before;
+        crc  = crc32c(crc, &part, sizeof(part));
+        sum += after ? chunks[k].sum_after : chunks[k].sum_before;
+    }
+    return ((uint64_t)crc << 32) | (uint32_t)(uint64_t)sum;
+}
+
+/* Runs the pass; rules == NULL leaves the store untouched. */
+static AtmStatus eod_pass(AccountStore *store, const EodRules *rules, unsigned threads,
+                          uint64_t *before, uint64_t *after, EodReport *report) {
+    size_t    n      = (store->size + EOD_CHUNK_ACCOUNTS - 1) / EOD_CHUNK_ACCOUNTS;
+    EodChunk *chunks = calloc(n ? n : 1, sizeof(EodChunk));
+    if (!chunks) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    EodJob    job = { store, rules, chunks };
+    AtmStatus st  = parallel_for(n, threads, eod_chunk_range, &job);
+    if (st == ATM_OK) {
+        *before = eod_digest(chunks, n, 0);
+        *after  = eod_digest(chunks, n, 1);
+        for (size_t k = 0; k < n && report; ++k) {
+            report->accounts       += chunks[k].changed;
+            report->interest_cents += chunks[k].interest;
+            report->fee_cents      += chunks[k].fees;
+        }
+    }
+    free(chunks);
+    return st;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Checkpoint                                                             */
+/* ---------------------------------------------------------------------- */
+
+static AtmStatus eod_checkpoint_read(const char *path, EodCheckpoint *cp) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ATM_ERR_NOT_FOUND;
+    }
+
+    char               state[16] = "";
+    unsigned long      rules     = 0;
+    unsigned long long before = 0, after = 0, accounts = 0;
+    long long          interest = 0, fees = 0;
+    int fields = fscanf(fp, "run %63s\nrules %lx\nstate %15s\nbefore %llx\nafter %llx\n"
+                            "accounts %llu\ninterest %lld\nfees %lld\n",
+                        cp->run, &rules, state, &before, &after, &accounts, &interest, &fees);
+    fclose(fp);
+    if (fields != 8) {
+        return ATM_ERR_PARSE;
+    }
+
+    cp->rules          = (uint32_t)rules;
+    cp->before         = before;
+    cp->after          = after;
+    cp->accounts       = (size_t)accounts;
+    cp->interest_cents = interest;
+    cp->fee_cents      = fees;
+    for (int s = EOD_STATE_APPLYING; s <= EOD_STATE_DONE; ++s) {
+        if (strcmp(state, eod_state_names[s]) == 0) {
+            cp->state = (EodState)s;
+            return ATM_OK;
+        }
+    }
+    return ATM_ERR_PARSE;
+}
+
+/* Replaces the checkpoint file atomically and durably. */
+static AtmStatus eod_checkpoint_write(const char *path, const EodCheckpoint *cp) {
+    char text[EOD_MAX_RUN_ID_LEN + 256];
+    int  len = snprintf(text, sizeof(text),
+                        "run %s\nrules %08lx\nstate %s\nbefore %016llx\nafter %016llx\n"
+                        "accounts %llu\ninterest %lld\nfees %lld\n",
+                        cp->run, (unsigned long)cp->rules, eod_state_names[cp->state],
+                        (unsigned long long)cp->before, (unsigned long long)cp->after,
+                        (unsigned long long)cp->accounts, (long long)cp->interest_cents,
+                        (long long)cp->fee_cents);
+    if (len < 0 || (size_t)len >= sizeof(text)) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    FileReplace out;
+    if (fileio_replace_begin(&out, path) != ATM_OK) {
+        return ATM_ERR_IO;
+    }
+    int ok = fileio_replace_write(&out, text, (size_t)len);
+    return fileio_replace_commit(&out, ok);
+}
+
+static int eod_valid_run_id(const char *run_id) {
+    size_t len = strlen(run_id);
+    if (len == 0 || len >= EOD_MAX_RUN_ID_LEN) {
+        return 0;
+    }
+    for (const char *p = run_id; *p; ++p) {
+        if (!isalnum((unsigned char)*p) && !strchr("-_.:", *p)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Run                                                                    */
+/* ---------------------------------------------------------------------- */
+
+AtmStatus eod_run(AtmContext *ctx, const EodRules *rules, const char *run_id,
+                  unsigned threads, EodReport *report) {
+    if (!ctx || !rules || !run_id || !report) return ATM_ERR_INTERNAL;
+
+    memset(report, 0, sizeof(*report));
+    if (!eod_valid_run_id(run_id)) {
+        return ATM_ERR_PARSE;
+    }
+
+    char path[MAX_DB_PATH_LEN + sizeof(EOD_CHECKPOINT_SUFFIX)];
+    snprintf(path, sizeof(path), "%s%s", ctx->db_path, EOD_CHECKPOINT_SUFFIX);
+
+    EodCheckpoint cp;
+    memset(&cp, 0, sizeof(cp));
+    AtmStatus st = eod_checkpoint_read(path, &cp);
+    if (st == ATM_ERR_PARSE) {
+        return st;
+    }
+
+    if (st == ATM_OK && strcmp(cp.run, run_id) != 0) {
+        /* Never skip past a run that may not have been applied. */
+        if (cp.state != EOD_STATE_DONE) {
+            return ATM_ERR_CONFLICT;
+        }
+    } else if (st == ATM_OK) {
+        if (cp.state == EOD_STATE_COMMITTING) {
+            uint64_t now = 0, unused = 0;
+            st = eod_pass(&ctx->store, NULL, threads, &now, &unused, NULL);
+            if (st != ATM_OK) {
+                return st;
+            }
+            if (now == cp.after) {
+                /* The save landed before the crash: only the bookkeeping is left. */
+                cp.state = EOD_STATE_DONE;
+                st       = eod_checkpoint_write(path, &cp);
+                report->resumed = 1;
+            } else if (now != cp.before) {
+                return ATM_ERR_CONFLICT;
+            }
+        }
+        if (cp.state == EOD_STATE_DONE) {
+            report->already_done   = !report->resumed;
+            report->accounts       = cp.accounts;
+            report->interest_cents = cp.interest_cents;
+            report->fee_cents      = cp.fee_cents;
+            return st;
+        }
+        report->resumed = 1;
+    }
+
+    memset(&cp, 0, sizeof(cp));
+    strcpy(cp.run, run_id);
+    cp.rules = rules->digest;
+    cp.state = EOD_STATE_APPLYING;
+    st       = eod_checkpoint_write(path, &cp);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    uint64_t start = time_monotonic_ns();
+    st = eod_pass(&ctx->store, rules, threads, &cp.before, &cp.after, report);
+    report->apply_ns = time_monotonic_ns() - start;
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    cp.state          = EOD_STATE_COMMITTING;
+    cp.accounts       = report->accounts;
+    cp.interest_cents = report->interest_cents;
+    cp.fee_cents      = report->fee_cents;
+    st = eod_checkpoint_write(path, &cp);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    start = time_monotonic_ns();
+    st    = atm_persist(ctx);
+    report->persist_ns = time_monotonic_ns() - start;
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    cp.state = EOD_STATE_DONE;
+    return eod_checkpoint_write(path, &cp);
+}
@@ -0,0 +1,432 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      fileio.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Implementation of write-to-temp-and-rename file replacement with an
+ *   io_uring backend (raw system calls, no liburing) and a stdio fallback.
+ */
+
+#if defined(__linux__)
+#  define _DEFAULT_SOURCE /* syscall() */
+#endif
+#define _POSIX_C_SOURCE 200809L
+
+#include "fileio.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  include <io.h>
+#  define FILEIO_SYNC(f) _commit(_fileno(f))
+#else
+#  include <fcntl.h>
+#  include <unistd.h>
+#  define FILEIO_SYNC(f) fsync(fileno(f))
+#endif
+
+#if defined(__linux__)
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <linux/io_uring.h>
+#  include <stdatomic.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <sys/uio.h>
+#  define FILEIO_HAVE_URING 1
+#endif
+
+static _Alignas(4096) char fileio_pool[FILEIO_BUFFERS][FILEIO_BUF_LEN];
+
+static FileioBackend fileio_wanted = FILEIO_STDIO;
+static int           fileio_configured;
+
+/* ---------------------------------------------------------------------- */
+/* io_uring                                                               */
+/* ---------------------------------------------------------------------- */
+
+#ifdef FILEIO_HAVE_URING
+
+#define FILEIO_RING_ENTRIES 8u
+#define FILEIO_FSYNC_TAG    FILEIO_BUFFERS /* user_data of the fsync */
+
+typedef struct {
+    int                  fd;
+    int                  state;      /* 0 untried, 1 ready, -1 unavailable */
+    int                  registered; /* pool registered: use WRITE_FIXED */
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    unsigned             inflight;
+    int                  busy[FILEIO_BUFFERS];
+    size_t               expect[FILEIO_BUFFERS];
+    int                  failed;     /* a completion reported an error */
+} FileioRing;
+
+static FileioRing fileio_ring = { .fd = -1 };
+
+static unsigned fileio_load_acquire(const unsigned *p) {
+    return atomic_load_explicit((const _Atomic unsigned *)p, memory_order_acquire);
+}
+
+static void fileio_store_release(unsigned *p, unsigned v) {
+    atomic_store_explicit((_Atomic unsigned *)p, v, memory_order_release);
+}
+
+static int fileio_ring_setup(FileioRing *r) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+
+    int fd = (int)syscall(__NR_io_uring_setup, FILEIO_RING_ENTRIES, &p);
+    if (fd < 0) {
+        return 0;
+    }
+
+    size_t sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if ((p.features & IORING_FEAT_SINGLE_MMAP) && cq_len > sq_len) {
+        sq_len = cq_len;
+    }
+
+    char *sq = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+    char *cq = sq;
+    if (sq != MAP_FAILED && !(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+    }
+    void *sqes = MAP_FAILED;
+    if (sq != MAP_FAILED && cq != MAP_FAILED) {
+        sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+    }
+    if (sqes == MAP_FAILED) {
+        /* The process exits or stays on stdio: the mappings are not reused. */
+        close(fd);
+        return 0;
+    }
+
+    r->fd       = fd;
+    r->sq_head  = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail  = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->sqes     = sqes;
+    r->cqes     = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    /* Pin the pool once; without it (e.g. RLIMIT_MEMLOCK) plain writes. */
+    struct iovec iov[FILEIO_BUFFERS];
+    for (unsigned i = 0; i < FILEIO_BUFFERS; ++i) {
+        iov[i].iov_base = fileio_pool[i];
+        iov[i].iov_len  = FILEIO_BUF_LEN;
+    }
+    r->registered = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                            iov, FILEIO_BUFFERS) == 0;
+    return 1;
+}
+
+static int fileio_ring_ready(void) {
+    FileioRing *r = &fileio_ring;
+    if (r->state == 0) {
+        r->state = fileio_ring_setup(r) ? 1 : -1;
+    }
+    return r->state == 1;
+}
+
+/* Next free SQE; fileio_ring_push publishes it once filled in. */
+static struct io_uring_sqe *fileio_ring_sqe(FileioRing *r) {
+    unsigned index = *r->sq_tail & *r->sq_mask;
+
+    struct io_uring_sqe *sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[index] = index;
+    return sqe;
+}
+
+static void fileio_ring_push(FileioRing *r) {
+    fileio_store_release(r->sq_tail, *r->sq_tail + 1);
+    r->inflight++;
+}
+
+/* Consumes every available completion (one pass over the CQ ring). */
+static void fileio_ring_reap(FileioRing *r) {
+    unsigned head = *r->cq_head;
+    unsigned tail = fileio_load_acquire(r->cq_tail);
+
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        if (cqe->user_data < FILEIO_BUFFERS) {
+            unsigned slot = (unsigned)cqe->user_data;
+            if (cqe->res < 0 || (size_t)cqe->res != r->expect[slot]) {
+                r->failed = 1; /* error or short write */
+            }
+            r->busy[slot] = 0;
+        } else if (cqe->res < 0) {
+            r->failed = 1;
+        }
+        r->inflight--;
+    }
+    fileio_store_release(r->cq_head, head);
+}
+
+/* Submits queued SQEs and waits until at most `max_inflight` remain. */
+static int fileio_ring_enter(FileioRing *r, unsigned max_inflight) {
+    for (;;) {
+        unsigned pending = *r->sq_tail - fileio_load_acquire(r->sq_head);
+        unsigned wait    = r->inflight > max_inflight ? 1 : 0;
+        if (!pending && !wait) {
+            return 1;
+        }
+        long n = syscall(__NR_io_uring_enter, r->fd, pending, wait,
+                         wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return 0;
+        }
+        fileio_ring_reap(r);
+    }
+}
+
+static void fileio_ring_write(FileioRing *r, FileReplace *fr, unsigned flags) {
+    struct io_uring_sqe *sqe = fileio_ring_sqe(r);
+    sqe->opcode    = r->registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->flags     = (unsigned char)flags;
+    sqe->fd        = fr->fd;
+    sqe->off       = fr->offset;
+    sqe->addr      = (uint64_t)(uintptr_t)fr->buf;
+    sqe->len       = (unsigned)fr->used;
+    sqe->buf_index = (unsigned short)fr->slot;
+    sqe->user_data = fr->slot;
+
+    fileio_ring_push(r);
+
+    r->busy[fr->slot]   = 1;
+    r->expect[fr->slot] = fr->used;
+    fr->offset += fr->used;
+}
+
+#endif /* FILEIO_HAVE_URING */
+
+/* ---------------------------------------------------------------------- */
+/* Backend selection                                                      */
+/* ---------------------------------------------------------------------- */
+
+void fileio_set_backend(FileioBackend backend) {
+    fileio_wanted     = backend;
+    fileio_configured = 1;
+}
+
+FileioBackend fileio_backend(void) {
+    if (!fileio_configured) {
+        const char *env = getenv(FILEIO_ENV);
+        fileio_set_backend((env && strcmp(env, "io_uring") == 0) ? FILEIO_URING : FILEIO_STDIO);
+    }
+#ifdef FILEIO_HAVE_URING
+    if (fileio_wanted == FILEIO_URING && fileio_ring_ready()) {
+        return FILEIO_URING;
+    }
+#endif
+    return FILEIO_STDIO;
+}
+
+const char *fileio_backend_name(FileioBackend backend) {
+    return backend == FILEIO_URING ? "io_uring" : "stdio";
+}
+
+/* ---------------------------------------------------------------------- */
+/* Replacement                                                            */
+/* ---------------------------------------------------------------------- */
+
+AtmStatus fileio_replace_begin(FileReplace *fr, const char *path) {
+    if (!fr || !path) return ATM_ERR_INTERNAL;
+
+    if (strlen(path) >= sizeof(fr->path)) {
+        return ATM_ERR_IO;
+    }
+    strcpy(fr->path, path);
+    snprintf(fr->tmp_path, sizeof(fr->tmp_path), "%s%s", path, FILEIO_TMP_SUFFIX);
+
+    fr->fp     = NULL;
+    fr->fd     = -1;
+    fr->slot   = 0;
+    fr->buf    = fileio_pool[0];
+    fr->used   = 0;
+    fr->offset = 0;
+    fr->ok     = 1;
+
+#ifdef FILEIO_HAVE_URING
+    if (fileio_backend() == FILEIO_URING) {
+        fr->fd = open(fr->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        if (fr->fd < 0) {
+            return ATM_ERR_IO;
+        }
+        fileio_ring.failed = 0;
+        return ATM_OK;
+    }
+#endif
+
+    fr->fp = fopen(fr->tmp_path, "w");
+    if (!fr->fp) {
+        return ATM_ERR_IO;
+    }
+    return ATM_OK;
+}
+
+/* Hands the filled buffer to the backend and moves on to a free one. */
+static void fileio_replace_flush(FileReplace *fr) {
+    if (!fr->used || !fr->ok) {
+        fr->used = 0;
+        return;
+    }
+#ifdef FILEIO_HAVE_URING
+    if (fr->fd >= 0) {
+        FileioRing *r = &fileio_ring;
+        fileio_ring_write(r, fr, 0);
+        fr->slot = (fr->slot + 1) % FILEIO_BUFFERS;
+        fr->buf  = fileio_pool[fr->slot];
+        fr->used = 0;
+
+        /* Start the write now; block only if the next buffer is still busy. */
+        if (!fileio_ring_enter(r, r->inflight)) {
+            fr->ok = 0;
+        }
+        while (fr->ok && r->busy[fr->slot]) {
+            if (!fileio_ring_enter(r, r->inflight - 1)) {
+                fr->ok = 0;
+            }
+        }
+        if (r->failed) {
+            fr->ok = 0;
+        }
+        return;
+    }
+#endif
+    if (fwrite(fr->buf, 1, fr->used, fr->fp) != fr->used) {
+        fr->ok = 0;
+    }
+    fr->used = 0;
+}
+
+char *fileio_replace_reserve(FileReplace *fr, size_t len) {
+    if (!fr || len > FILEIO_BUF_LEN) return NULL;
+    if (FILEIO_BUF_LEN - fr->used < len) {
+        fileio_replace_flush(fr);
+    }
+    return fr->ok ? fr->buf + fr->used : NULL;
+}
+
+void fileio_replace_advance(FileReplace *fr, size_t len) {
+    if (!fr) return;
+    fr->used += len;
+}
+
+int fileio_replace_write(FileReplace *fr, const void *data, size_t len) {
+    char *dst = fileio_replace_reserve(fr, len);
+    if (!dst) {
+        return 0;
+    }
+    memcpy(dst, data, len);
+    fileio_replace_advance(fr, len);
+    return 1;
+}
+
+#ifdef FILEIO_HAVE_URING
+/* Last buffer and fsync as one linked submission, once earlier writes
+ * are done (a link only orders requests within its own chain). */
+static int fileio_ring_finish(FileReplace *fr) {
+    FileioRing *r  = &fileio_ring;
+    int         ok = fileio_ring_enter(r, 0);
+
+    if (ok && fr->ok && !r->failed) {
+        if (fr->used) {
+            fileio_ring_write(r, fr, IOSQE_IO_LINK);
+        }
+        struct io_uring_sqe *sqe = fileio_ring_sqe(r);
+        sqe->opcode    = IORING_OP_FSYNC;
+        sqe->fd        = fr->fd;
+        sqe->user_data = FILEIO_FSYNC_TAG;
+        fileio_ring_push(r);
+        ok = fileio_ring_enter(r, 0);
+    }
+    ok = ok && fr->ok && !r->failed;
+    if (close(fr->fd) != 0) ok = 0;
+    fr->fd = -1;
+    return ok;
+}
+#endif
+
+#if !defined(_WIN32) && !defined(_WIN64)
+/* A rename is durable only once the directory holding the entry is synced. */
+static int fileio_sync_parent(const char *path) {
+    char        dir[MAX_DB_PATH_LEN];
+    const char *slash = strrchr(path, '/');
+
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        size_t len = (size_t)(slash - path);
+        if (len >= sizeof(dir)) return 0;
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return 0;
+    int ok = fsync(fd) == 0;
+    if (close(fd) != 0) ok = 0;
+    return ok;
+}
+#endif
+
+AtmStatus fileio_replace_commit(FileReplace *fr, int write_ok) {
+    if (!fr || (!fr->fp && fr->fd < 0)) return ATM_ERR_INTERNAL;
+
+    int ok = write_ok && fr->ok;
+#ifdef FILEIO_HAVE_URING
+    if (fr->fd >= 0) {
+        if (!ok) {
+            fr->ok = 0; /* still drain: the pool may be in flight */
+        }
+        ok = fileio_ring_finish(fr) && ok;
+    } else
+#endif
+    {
+        if (ok) {
+            fileio_replace_flush(fr);
+            ok = fr->ok;
+        }
+        if (ok && fflush(fr->fp) != 0) ok = 0;
+        if (ok && FILEIO_SYNC(fr->fp) != 0) ok = 0;
+        if (fclose(fr->fp) != 0) ok = 0;
+        fr->fp = NULL;
+    }
+
+    if (!ok) {
+        remove(fr->tmp_path);
+        return ATM_ERR_IO;
+    }
+
+#if defined(_WIN32) || defined(_WIN64)
+    /* rename() does not replace an existing file on Windows. */
+    remove(fr->path);
+#endif
+    if (rename(fr->tmp_path, fr->path) != 0) {
+        remove(fr->tmp_path);
+        return ATM_ERR_IO;
+    }
+#if !defined(_WIN32) && !defined(_WIN64)
+    if (!fileio_sync_parent(fr->path)) return ATM_ERR_IO;
+#endif
+    return ATM_OK;
+}
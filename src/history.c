@@ -0,0 +1,476 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      history.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Segmented change log with a per-segment ID index and base snapshots,
+ *   and the point-in-time query that reads them (see history.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "history.h"
+#include "account_codec.h"
+#include "crc32c.h"
+#include "snapshot.h"
+#include "timeutil.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  include <direct.h>
+#  include <io.h>
+#  define HISTORY_SYNC(f)  _commit(_fileno(f))
+#  define HISTORY_MKDIR(d) _mkdir(d)
+#else
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define HISTORY_SYNC(f)  fsync(fileno(f))
+#  define HISTORY_MKDIR(d) mkdir((d), 0755)
+#endif
+
+#define HISTORY_HEADER_LEN 16 /* magic + u64 (segment start / slot count) */
+#define HISTORY_PATH_LEN   (MAX_DB_PATH_LEN + 32)
+
+static void history_path(char *out, const History *h, const char *dir, uint64_t start,
+                         const char *ext) {
+    snprintf(out, HISTORY_PATH_LEN, "%s/%llu%s", h ? h->dir : dir,
+             (unsigned long long)start, ext);
+}
+
+static uint64_t history_hash(const char *id) {
+    return crc32c(0, id, strlen(id));
+}
+
+static uint32_t history_entry_crc(const HistoryEntry *e, const char *record) {
+    uint32_t crc = crc32c(0, &e->ts_ms, sizeof(e->ts_ms));
+    crc = crc32c(crc, &e->prev, sizeof(e->prev));
+    crc = crc32c(crc, &e->len, sizeof(e->len));
+    return crc32c(crc, record, e->len);
+}
+
+static int history_write_header(FILE *fp, const char *magic, uint64_t value) {
+    char head[HISTORY_HEADER_LEN] = { 0 };
+    memcpy(head, magic, strlen(magic) + 1);
+    memcpy(head + 8, &value, sizeof(value));
+    return fwrite(head, 1, sizeof(head), fp) == sizeof(head);
+}
+
+static int history_read_header(FILE *fp, const char *magic, uint64_t *value) {
+    char head[HISTORY_HEADER_LEN];
+    if (fread(head, 1, sizeof(head), fp) != sizeof(head) ||
+        memcmp(head, magic, strlen(magic) + 1) != 0) {
+        return 0;
+    }
+    memcpy(value, head + 8, sizeof(*value));
+    return 1;
+}
+
+static int history_flush(FILE *fp) {
+    return fflush(fp) == 0 && HISTORY_SYNC(fp) == 0;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Writer                                                                 */
+/* ---------------------------------------------------------------------- */
+
+void history_init(History *h) {
+    if (!h) return;
+    memset(h, 0, sizeof(*h));
+}
+
+static void history_close_segment(History *h) {
+    if (h->log) {
+        history_flush(h->log);
+        fclose(h->log);
+        h->log = NULL;
+    }
+    if (h->idx) {
+        history_flush(h->idx);
+        fclose(h->idx);
+        h->idx = NULL;
+    }
+    free(h->table);
+    h->table = NULL;
+}
+
+/*
+ * Closes the current segment and starts the next one at the state of
+ * `store`: snapshot, empty log, empty index, then the manifest line, so
+ * the manifest only ever lists complete segments.
+ */
+static AtmStatus history_new_segment(History *h, const AccountStore *store) {
+    history_close_segment(h);
+
+    uint64_t start = time_wall_ms();
+    if (start <= h->start_ms) {
+        start = h->start_ms + 1; /* segment names must increase */
+    }
+
+    uint64_t slots = HISTORY_MIN_SLOTS;
+    while (slots < 2 * (uint64_t)store->size) {
+        slots *= 2;
+    }
+
+    char path[HISTORY_PATH_LEN];
+    history_path(path, h, NULL, start, ".snap");
+    AtmStatus st = snapshot_write(store, path, NULL, NULL);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    h->table = calloc((size_t)slots, sizeof(HistorySlot));
+    if (!h->table) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    history_path(path, h, NULL, start, ".log");
+    h->log = fopen(path, "wb");
+    history_path(path, h, NULL, start, ".idx");
+    h->idx = fopen(path, "w+b");
+    if (!h->log || !h->idx) {
+        history_close_segment(h);
+        return ATM_ERR_IO;
+    }
+
+    /* The index is created sparse: seek to its last byte and write it. */
+    int ok = history_write_header(h->log, HISTORY_LOG_MAGIC, start) && history_flush(h->log) &&
+             history_write_header(h->idx, HISTORY_IDX_MAGIC, slots) &&
+             fseek(h->idx, (long)(HISTORY_HEADER_LEN + slots * sizeof(HistorySlot) - 1),
+                   SEEK_SET) == 0 &&
+             fputc(0, h->idx) != EOF && history_flush(h->idx);
+
+    snprintf(path, sizeof(path), "%s/%s", h->dir, HISTORY_SEGMENTS_FILE);
+    FILE *manifest = ok ? fopen(path, "a") : NULL;
+    ok = manifest && fprintf(manifest, "%llu\n", (unsigned long long)start) > 0 &&
+         history_flush(manifest);
+    if (manifest) {
+        fclose(manifest);
+    }
+    if (!ok) {
+        history_close_segment(h);
+        return ATM_ERR_IO;
+    }
+
+    h->start_ms = start;
+    h->log_end  = HISTORY_HEADER_LEN;
+    h->slots    = slots;
+    h->used     = 0;
+    h->resync   = 0;
+    return ATM_OK;
+}
+
+static int history_reserve_logged(History *h, size_t count) {
+    if (count <= h->logged_cap) {
+        return 1;
+    }
+    size_t    cap   = h->logged_cap ? h->logged_cap : 1024;
+    while (cap < count) cap *= 2;
+    uint32_t *grown = realloc(h->logged, cap * sizeof(uint32_t));
+    if (!grown) {
+        return 0;
+    }
+    h->logged     = grown;
+    h->logged_cap = cap;
+    return 1;
+}
+
+AtmStatus history_open(History *h, const char *dir, const AccountStore *store,
+                       const uint32_t *crcs) {
+    if (!h || !dir || !store) return ATM_ERR_INTERNAL;
+
+    history_init(h);
+    if (strlen(dir) >= sizeof(h->dir)) {
+        return ATM_ERR_IO;
+    }
+    strcpy(h->dir, dir);
+    if (HISTORY_MKDIR(dir) != 0 && errno != EEXIST) {
+        return ATM_ERR_IO;
+    }
+
+    const char   *env      = getenv(HISTORY_INTERVAL_ENV);
+    unsigned long interval = env ? strtoul(env, NULL, 10) : 0;
+    h->interval_ms = (uint64_t)(interval ? interval : HISTORY_INTERVAL_S) * 1000u;
+
+    if (!history_reserve_logged(h, store->size)) {
+        return ATM_ERR_INTERNAL;
+    }
+    for (size_t i = 0; i < store->size; ++i) {
+        h->logged[i] = crcs ? crcs[i] : account_record_crc(&store->items[i]);
+    }
+    h->logged_len = store->size;
+
+    AtmStatus st = history_new_segment(h, store);
+    if (st != ATM_OK) {
+        history_close(h);
+        return st;
+    }
+    h->enabled = 1;
+    return ATM_OK;
+}
+
+void history_close(History *h) {
+    if (!h) return;
+    history_close_segment(h);
+    free(h->dirty);
+    free(h->logged);
+    history_init(h);
+}
+
+void history_mark_resync(History *h) {
+    if (h) h->resync = 1;
+}
+
+/* Returns the slot for `id`, claiming an empty one if needed; SIZE_MAX if the table is full. */
+static size_t history_slot(History *h, const char *id) {
+    uint64_t mask = h->slots - 1;
+    uint64_t i    = history_hash(id) & mask;
+    for (uint64_t n = 0; n < h->slots; ++n, i = (i + 1) & mask) {
+        HistorySlot *s = &h->table[i];
+        if (s->last == 0 && s->id[0] == '\0') {
+            strcpy(s->id, id);
+            h->used++;
+            return (size_t)i;
+        }
+        if (strcmp(s->id, id) == 0) {
+            return (size_t)i;
+        }
+    }
+    return SIZE_MAX;
+}
+
+static int history_mark_dirty(History *h, size_t slot) {
+    if (h->dirty_len == h->dirty_cap) {
+        size_t  cap   = h->dirty_cap ? h->dirty_cap * 2 : 256;
+        size_t *grown = realloc(h->dirty, cap * sizeof(size_t));
+        if (!grown) {
+            return 0;
+        }
+        h->dirty     = grown;
+        h->dirty_cap = cap;
+    }
+    h->dirty[h->dirty_len++] = slot;
+    return 1;
+}
+
+/* Appends one entry; returns 0 on failure. */
+static int history_append(History *h, const Account *acc, uint64_t now) {
+    size_t slot = history_slot(h, acc->id);
+    if (slot == SIZE_MAX) {
+        return 0;
+    }
+    HistorySlot *s = &h->table[slot];
+    char         record[ACCOUNT_CSV_RECORD_MAX];
+
+    HistoryEntry e;
+    e.ts_ms = now;
+    e.prev  = s->last;
+    e.len   = (uint32_t)account_format_csv(acc, record, NULL);
+    e.crc   = history_entry_crc(&e, record);
+    if (fwrite(&e, sizeof(e), 1, h->log) != 1 || fwrite(record, 1, e.len, h->log) != e.len) {
+        return 0;
+    }
+
+    /* A slot changed twice in one call is written twice: harmless. */
+    s->last     = h->log_end + 1;
+    h->log_end += sizeof(e) + e.len;
+    return history_mark_dirty(h, slot);
+}
+
+AtmStatus history_log(History *h, const AccountStore *store, const uint32_t *crcs) {
+    if (!h || !store) return ATM_ERR_INTERNAL;
+    if (!h->enabled) return ATM_OK;
+
+    if (!history_reserve_logged(h, store->size)) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    /*
+     * Once another ID would take the index past half full, the remaining
+     * changes are not logged: the next segment's snapshot, taken below,
+     * holds them instead.
+     */
+    uint64_t now  = time_wall_ms();
+    int      ok   = 1;
+    int      full = 0;
+    h->dirty_len  = 0;
+    for (size_t i = 0; i < store->size && ok; ++i) {
+        uint32_t crc = crcs ? crcs[i] : account_record_crc(&store->items[i]);
+        if (i >= h->logged_len || h->logged[i] != crc) {
+            full = full || 2 * (h->used + 1) > h->slots;
+            if (!full) {
+                ok = history_append(h, &store->items[i], now);
+            }
+        }
+        h->logged[i] = crc;
+    }
+    h->logged_len = store->size;
+
+    /* Entries are on disk before any index slot points at them. */
+    ok = ok && (h->dirty_len == 0 || history_flush(h->log));
+    for (size_t d = 0; d < h->dirty_len && ok; ++d) {
+        size_t pos = h->dirty[d];
+        ok = fseek(h->idx, (long)(HISTORY_HEADER_LEN + pos * sizeof(HistorySlot)), SEEK_SET) == 0 &&
+             fwrite(&h->table[pos], sizeof(HistorySlot), 1, h->idx) == 1;
+    }
+    ok = ok && (h->dirty_len == 0 || history_flush(h->idx));
+    if (!ok) {
+        return ATM_ERR_IO;
+    }
+
+    if (full || h->resync || now - h->start_ms >= h->interval_ms || 2 * h->used > h->slots) {
+        return history_new_segment(h, store);
+    }
+    return ATM_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Query                                                                  */
+/* ---------------------------------------------------------------------- */
+
+/* Start of the last segment that began at or before `at_ms`. */
+static AtmStatus history_find_segment(const char *dir, uint64_t at_ms, uint64_t *start) {
+    char path[HISTORY_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, HISTORY_SEGMENTS_FILE);
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+
+    unsigned long long s     = 0;
+    int                found = 0;
+    while (fscanf(fp, "%llu", &s) == 1 && s <= at_ms) {
+        *start = s;
+        found  = 1;
+    }
+    fclose(fp);
+    return found ? ATM_OK : ATM_ERR_NOT_FOUND;
+}
+
+/* Offset + 1 of the newest entry for `id`, 0 if the segment has none. */
+static AtmStatus history_lookup(const char *path, const char *id, uint64_t *last) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+
+    uint64_t  slots = 0;
+    AtmStatus st    = ATM_ERR_PARSE;
+    *last = 0;
+    if (history_read_header(fp, HISTORY_IDX_MAGIC, &slots) && slots &&
+        (slots & (slots - 1)) == 0) {
+        st = ATM_OK;
+        for (uint64_t n = 0, i = history_hash(id) & (slots - 1); n < slots;
+             ++n, i = (i + 1) & (slots - 1)) {
+            HistorySlot s;
+            if (fseek(fp, (long)(HISTORY_HEADER_LEN + i * sizeof(s)), SEEK_SET) != 0 ||
+                fread(&s, sizeof(s), 1, fp) != 1) {
+                st = ATM_ERR_PARSE;
+                break;
+            }
+            if (s.last == 0) {
+                break;
+            }
+            if (strncmp(s.id, id, sizeof(s.id)) == 0) {
+                *last = s.last;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    return st;
+}
+
+/*
+ * Follows the account's chain from `last` back to the newest entry at or
+ * before `at_ms`. Returns ATM_ERR_NOT_FOUND if every entry is later.
+ */
+static AtmStatus history_walk(const char *path, uint64_t last, uint64_t at_ms,
+                              Account *out, HistoryAnswer *answer) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+
+    uint64_t  start = 0;
+    AtmStatus st    = history_read_header(fp, HISTORY_LOG_MAGIC, &start) ? ATM_ERR_NOT_FOUND
+                                                                         : ATM_ERR_PARSE;
+    while (st == ATM_ERR_NOT_FOUND && last) {
+        HistoryEntry e;
+        char         record[ACCOUNT_CSV_RECORD_MAX + 1];
+        if (fseek(fp, (long)(last - 1), SEEK_SET) != 0 || fread(&e, sizeof(e), 1, fp) != 1 ||
+            e.len >= sizeof(record) || fread(record, 1, e.len, fp) != e.len ||
+            history_entry_crc(&e, record) != e.crc || e.prev >= last) {
+            st = ATM_ERR_CHECKSUM;
+            break;
+        }
+        answer->entries_read++;
+        if (e.ts_ms <= at_ms) {
+            record[e.len] = '\0';
+            st = account_parse_csv(record, out, NULL);
+            answer->as_of_ms = e.ts_ms;
+            answer->from_log = 1;
+            break;
+        }
+        last = e.prev;
+    }
+    fclose(fp);
+    return st;
+}
+
+AtmStatus history_query(const char *dir, const char *account_id, uint64_t at_ms,
+                        Account *out, HistoryAnswer *answer) {
+    if (!dir || !account_id || !out || !answer) return ATM_ERR_INTERNAL;
+
+    memset(answer, 0, sizeof(*answer));
+    if (strlen(dir) >= MAX_DB_PATH_LEN || strlen(account_id) >= MAX_ACCOUNT_ID_LEN) {
+        return ATM_ERR_PARSE;
+    }
+
+    uint64_t  start = 0;
+    AtmStatus st    = history_find_segment(dir, at_ms, &start);
+    if (st != ATM_OK) {
+        return st;
+    }
+    answer->segment_ms = start;
+
+    char     path[HISTORY_PATH_LEN];
+    uint64_t last = 0;
+    history_path(path, NULL, dir, start, ".idx");
+    st = history_lookup(path, account_id, &last);
+    if (st == ATM_OK && last) {
+        history_path(path, NULL, dir, start, ".log");
+        st = history_walk(path, last, at_ms, out, answer);
+        if (st != ATM_ERR_NOT_FOUND) {
+            return st;
+        }
+    } else if (st != ATM_OK) {
+        return st;
+    }
+
+    /* No change between the segment start and at_ms: the snapshot has it. */
+    AccountStore store;
+    st = account_store_init(&store);
+    if (st == ATM_OK) {
+        history_path(path, NULL, dir, start, ".snap");
+        st = snapshot_restore(path, &store, NULL);
+    }
+    if (st == ATM_OK) {
+        /* Not account_store_find: a closed account is answered as closed. */
+        st = ATM_ERR_NOT_FOUND;
+        for (size_t i = 0; i < store.size; ++i) {
+            if (strcmp(store.items[i].id, account_id) == 0) {
+                *out             = store.items[i];
+                answer->as_of_ms = start;
+                st               = ATM_OK;
+                break;
+            }
+        }
+    }
+    account_store_free(&store);
+    return st;
+}
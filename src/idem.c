@@ -0,0 +1,424 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      idem.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Expiring idempotency-key table and its journal (see idem.h). The
+ *   index uses linear probing with backward-shift deletion, so popping
+ *   the oldest key never leaves tombstones behind.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "idem.h"
+#include "crc32c.h"
+#include "fileio.h"
+#include "timeutil.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  include <io.h>
+#  define IDEM_SYNC(f) _commit(_fileno(f))
+#else
+#  include <unistd.h>
+#  define IDEM_SYNC(f) fsync(fileno(f))
+#endif
+
+#define IDEM_RING_MASK   (IDEM_CAPACITY - 1u)
+#define IDEM_INDEX_SLOTS (2u * IDEM_CAPACITY)
+#define IDEM_INDEX_MASK  (IDEM_INDEX_SLOTS - 1u)
+#define IDEM_MAGIC_LEN   8
+
+static uint32_t idem_entry_crc(const IdemEntry *e) {
+    return crc32c(0, e, offsetof(IdemEntry, crc));
+}
+
+static uint32_t idem_digest(const uint32_t *crcs, size_t count) {
+    return crcs ? crc32c(0, crcs, count * sizeof(uint32_t)) : 0;
+}
+
+void idem_init(IdemTable *t) {
+    if (!t) return;
+    memset(t, 0, sizeof(*t));
+}
+
+/* ---------------------------------------------------------------------- */
+/* Table                                                                  */
+/* ---------------------------------------------------------------------- */
+
+#define IDEM_SLOT(hash, pos) ((uint64_t)(hash) << 32 | ((uint64_t)(pos) + 1))
+#define IDEM_SLOT_POS(slot)   ((size_t)(uint32_t)(slot) - 1)
+#define IDEM_SLOT_HOME(slot)  ((size_t)((slot) >> 32) & IDEM_INDEX_MASK)
+
+/* Index slot holding `key`, or the empty slot where it would go. */
+static size_t idem_slot(const IdemTable *t, const char *key, uint32_t hash) {
+    size_t i = hash & IDEM_INDEX_MASK;
+    while (t->index[i] && ((uint32_t)(t->index[i] >> 32) != hash ||
+                           strcmp(t->ring[IDEM_SLOT_POS(t->index[i])].key, key) != 0)) {
+        i = (i + 1) & IDEM_INDEX_MASK;
+    }
+    return i;
+}
+
+static void idem_unindex(IdemTable *t, size_t pos) {
+    uint64_t want = IDEM_SLOT(t->ring[pos].hash, pos);
+    size_t   i    = t->ring[pos].hash & IDEM_INDEX_MASK;
+    while (t->index[i] && t->index[i] != want) {
+        i = (i + 1) & IDEM_INDEX_MASK;
+    }
+    if (!t->index[i]) {
+        return; /* superseded by a later entry for the same key */
+    }
+
+    /* Pull back later entries of the run that may no longer be reachable. */
+    for (size_t j = i;;) {
+        j = (j + 1) & IDEM_INDEX_MASK;
+        if (!t->index[j]) {
+            break;
+        }
+        size_t home = IDEM_SLOT_HOME(t->index[j]);
+        int    stay = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stay) {
+            t->index[i] = t->index[j];
+            i           = j;
+        }
+    }
+    t->index[i] = 0;
+}
+
+static void idem_pop(IdemTable *t, uint64_t now) {
+    if (t->ring[t->head].expires_ms > now) {
+        t->dropped++;
+    }
+    idem_unindex(t, t->head);
+    t->head = (t->head + 1) & IDEM_RING_MASK;
+    t->count--;
+    if (t->unsynced > t->count) {
+        t->unsynced = t->count;
+    }
+}
+
+static void idem_expire(IdemTable *t, uint64_t now) {
+    while (t->count && t->ring[t->head].expires_ms <= now) {
+        idem_pop(t, now);
+    }
+}
+
+static void idem_insert(IdemTable *t, const IdemEntry *e, uint64_t now) {
+    if (t->count == IDEM_CAPACITY) {
+        idem_pop(t, now);
+    }
+    size_t pos  = (t->head + t->count) & IDEM_RING_MASK;
+    t->ring[pos] = *e;
+    t->count++;
+    t->index[idem_slot(t, e->key, e->hash)] = IDEM_SLOT(e->hash, pos);
+}
+
+static void idem_fill(IdemEntry *e, const char *key, const IdemRequest *req) {
+    memset(e, 0, sizeof(*e));
+    strcpy(e->key, key);
+    strncpy(e->account_id, req->account_id ? req->account_id : "", MAX_ACCOUNT_ID_LEN - 1);
+    strncpy(e->to_id, req->to_id ? req->to_id : "", MAX_ACCOUNT_ID_LEN - 1);
+    e->cents = (int64_t)llround(req->amount * 100.0);
+    e->op    = (int32_t)req->op;
+    e->hash  = crc32c(0, key, strlen(key));
+}
+
+int idem_check(IdemTable *t, const char *key, const IdemRequest *req, AtmStatus *status) {
+    if (!t || !t->ring || !key || !req || strlen(key) >= IDEM_MAX_KEY_LEN) return 0;
+
+    uint64_t now = time_wall_ms();
+    idem_expire(t, now);
+
+    uint32_t hash = crc32c(0, key, strlen(key));
+    size_t   slot = idem_slot(t, key, hash);
+    if (!t->index[slot]) {
+        return 0;
+    }
+    const IdemEntry *e = &t->ring[IDEM_SLOT_POS(t->index[slot])];
+    if (e->expires_ms <= now) {
+        return 0;
+    }
+
+    IdemEntry want;
+    idem_fill(&want, key, req);
+    int same = e->op == want.op && e->cents == want.cents &&
+               strcmp(e->account_id, want.account_id) == 0 && strcmp(e->to_id, want.to_id) == 0;
+    *status = same ? (AtmStatus)e->status : ATM_ERR_CONFLICT;
+    return 1;
+}
+
+AtmStatus idem_remember(IdemTable *t, const char *key, const IdemRequest *req, AtmStatus status) {
+    if (!t || !key || !req) return ATM_ERR_INTERNAL;
+    if (!t->ring) return ATM_OK;
+    if (strlen(key) >= IDEM_MAX_KEY_LEN) return ATM_ERR_PARSE;
+
+    uint64_t  now = time_wall_ms();
+    IdemEntry e;
+    idem_fill(&e, key, req);
+    e.expires_ms = now + t->ttl_ms;
+    e.status     = (int32_t)status;
+    e.crc        = idem_entry_crc(&e);
+
+    idem_expire(t, now);
+    idem_insert(t, &e, now);
+    t->unsynced++;
+    return ATM_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Journal                                                                */
+/* ---------------------------------------------------------------------- */
+
+static void idem_group(IdemEntry *g, uint32_t digest, int landed) {
+    memset(g, 0, sizeof(*g));
+    g->op         = IDEM_GROUP;
+    g->expires_ms = digest;
+    g->status     = landed;
+    g->crc        = idem_entry_crc(g);
+}
+
+/* Appends and syncs a commit marker: every group before it landed. */
+static AtmStatus idem_commit(IdemTable *t) {
+    IdemEntry marker;
+    idem_group(&marker, 0, 1);
+    if (fwrite(&marker, sizeof(marker), 1, t->journal) != 1 || fflush(t->journal) != 0 ||
+        IDEM_SYNC(t->journal) != 0) {
+        return ATM_ERR_IO;
+    }
+    t->journal_records++;
+    t->pending = 0;
+    return ATM_OK;
+}
+
+/* Opens the journal for appending, creating it (with its magic) if needed. */
+static AtmStatus idem_append_open(IdemTable *t) {
+    char magic[IDEM_MAGIC_LEN] = IDEM_MAGIC;
+    t->journal = fopen(t->path, "ab");
+    if (!t->journal || fseek(t->journal, 0, SEEK_END) != 0) {
+        return ATM_ERR_IO;
+    }
+    if (ftell(t->journal) == 0 && fwrite(magic, sizeof(magic), 1, t->journal) != 1) {
+        return ATM_ERR_IO;
+    }
+    return ATM_OK;
+}
+
+/*
+ * Replaces the journal with one landed group holding every live key.
+ * Only valid when no key is waiting for a save.
+ */
+static AtmStatus idem_rewrite(IdemTable *t) {
+    if (t->journal) {
+        fclose(t->journal);
+        t->journal = NULL;
+    }
+
+    char magic[IDEM_MAGIC_LEN] = IDEM_MAGIC;
+    IdemEntry   group;
+    idem_group(&group, 0, 1);
+
+    FileReplace fr;
+    AtmStatus   st = fileio_replace_begin(&fr, t->path);
+    if (st == ATM_OK) {
+        int ok = fileio_replace_write(&fr, magic, sizeof(magic)) &&
+                 fileio_replace_write(&fr, &group, sizeof(group));
+        for (size_t i = 0; i < t->count && ok; ++i) {
+            ok = fileio_replace_write(&fr, &t->ring[(t->head + i) & IDEM_RING_MASK],
+                                      sizeof(IdemEntry));
+        }
+        st = fileio_replace_commit(&fr, ok);
+    }
+    if (st == ATM_OK) {
+        t->journal_records = 1 + t->count;
+        t->unsynced        = 0;
+        t->pending         = 0;
+    }
+
+    /* On failure the old journal is intact: keep appending to it. */
+    AtmStatus reopened = idem_append_open(t);
+    return st != ATM_OK ? st : reopened;
+}
+
+/*
+ * Reads the journal into `recs` up to the first torn or damaged record.
+ * Returns ATM_ERR_PARSE if the file is not a journal.
+ */
+static AtmStatus idem_read(FILE *fp, IdemEntry **recs, size_t *n, int *torn) {
+    char   magic[IDEM_MAGIC_LEN];
+    size_t cap = 0;
+    *recs = NULL;
+    *n    = 0;
+    *torn = 0;
+
+    size_t got = fread(magic, 1, sizeof(magic), fp);
+    if (got < sizeof(magic)) {
+        *torn = 1; /* created, but the crash came before its first sync */
+        return ATM_OK;
+    }
+    if (memcmp(magic, IDEM_MAGIC, sizeof(IDEM_MAGIC)) != 0) {
+        return ATM_ERR_PARSE;
+    }
+
+    for (;;) {
+        if (*n == cap) {
+            cap = cap ? cap * 2 : 1024;
+            IdemEntry *grown = realloc(*recs, cap * sizeof(IdemEntry));
+            if (!grown) {
+                return ATM_ERR_INTERNAL;
+            }
+            *recs = grown;
+        }
+        size_t got = fread(&(*recs)[*n], 1, sizeof(IdemEntry), fp);
+        if (got == 0) {
+            return ATM_OK;
+        }
+        const IdemEntry *e = &(*recs)[*n];
+        if (got != sizeof(IdemEntry) || idem_entry_crc(e) != e->crc ||
+            memchr(e->key, '\0', sizeof(e->key)) == NULL) {
+            *torn = 1;
+            return ATM_OK;
+        }
+        (*n)++;
+    }
+}
+
+AtmStatus idem_open(IdemTable *t, const char *db_path, const uint32_t *crcs, size_t count) {
+    if (!t || !db_path) return ATM_ERR_INTERNAL;
+
+    idem_init(t);
+    snprintf(t->path, sizeof(t->path), "%s%s", db_path, IDEM_FILE_SUFFIX);
+
+    const char   *env = getenv(IDEM_TTL_ENV);
+    unsigned long ttl = env ? strtoul(env, NULL, 10) : 0;
+    t->ttl_ms = (uint64_t)(ttl ? ttl : IDEM_TTL_S) * 1000u;
+
+    t->ring  = malloc(IDEM_CAPACITY * sizeof(IdemEntry));
+    t->index = calloc(IDEM_INDEX_SLOTS, sizeof(uint64_t));
+    if (!t->ring || !t->index) {
+        idem_close(t);
+        return ATM_ERR_INTERNAL;
+    }
+
+    /* Without a journal, the first key creates one (idem_prepare). */
+    FILE *fp = fopen(t->path, "rb");
+    if (!fp) {
+        if (errno == ENOENT) return ATM_OK;
+        idem_close(t);
+        return ATM_ERR_IO;
+    }
+
+    IdemEntry *recs = NULL;
+    size_t     n    = 0;
+    int        torn = 0;
+    AtmStatus  st   = idem_read(fp, &recs, &n, &torn);
+    fclose(fp);
+    if (st != ATM_OK) {
+        free(recs);
+        idem_close(t);
+        return st;
+    }
+
+    /*
+     * Trailing groups after the last commit marker whose digest still
+     * describes the file on disk never got saved. (A save that landed but
+     * left the file as it was is indistinguishable, and safe to drop: its
+     * marker is synced before any of its responses go out.)
+     */
+    uint32_t digest = idem_digest(crcs, count);
+    size_t   cut    = n;
+    for (size_t i = n; crcs && i-- > 0;) {
+        if (recs[i].op != IDEM_GROUP) {
+            continue;
+        }
+        if (recs[i].status || recs[i].expires_ms != digest) {
+            break;
+        }
+        cut = i;
+    }
+
+    uint64_t now = time_wall_ms();
+    for (size_t i = 0; i < cut; ++i) {
+        if (recs[i].op != IDEM_GROUP && recs[i].expires_ms > now) {
+            idem_insert(t, &recs[i], now);
+        }
+    }
+    /* Kept groups did land: say so before the store can change again. */
+    int mark = n > 0 && !(recs[n - 1].op == IDEM_GROUP && recs[n - 1].status);
+    free(recs);
+
+    if (torn || cut < n || n > 2 * t->count + IDEM_COMPACT_SLACK) {
+        st = idem_rewrite(t);
+    } else {
+        t->journal_records = n;
+        st = idem_append_open(t);
+        if (st == ATM_OK && mark) {
+            st = idem_commit(t);
+        }
+    }
+    if (st != ATM_OK) {
+        idem_close(t);
+    }
+    return st;
+}
+
+void idem_close(IdemTable *t) {
+    if (!t) return;
+    if (t->journal) {
+        fclose(t->journal);
+    }
+    free(t->ring);
+    free(t->index);
+    idem_init(t);
+}
+
+AtmStatus idem_prepare(IdemTable *t, const uint32_t *crcs, size_t count) {
+    if (!t) return ATM_ERR_INTERNAL;
+    if (!t->ring || t->unsynced == 0) return ATM_OK;
+
+    if (!t->journal) {
+        AtmStatus st = idem_append_open(t);
+        if (st != ATM_OK) {
+            return st;
+        }
+    }
+
+    IdemEntry group;
+    idem_group(&group, idem_digest(crcs, count), 0);
+
+    int ok = fwrite(&group, sizeof(group), 1, t->journal) == 1;
+    for (size_t i = t->count - t->unsynced; i < t->count && ok; ++i) {
+        ok = fwrite(&t->ring[(t->head + i) & IDEM_RING_MASK], sizeof(IdemEntry), 1,
+                    t->journal) == 1;
+    }
+    if (!ok || fflush(t->journal) != 0 || IDEM_SYNC(t->journal) != 0) {
+        return ATM_ERR_IO;
+    }
+
+    t->journal_records += 1 + t->unsynced;
+    t->pending          = 1;
+    t->unsynced         = 0;
+    return ATM_OK;
+}
+
+AtmStatus idem_saved(IdemTable *t) {
+    if (!t) return ATM_ERR_INTERNAL;
+    if (!t->journal) return ATM_OK;
+
+    AtmStatus st = t->pending ? idem_commit(t) : ATM_OK;
+    if (!t->unsynced && t->journal_records > 2 * t->count + IDEM_COMPACT_SLACK) {
+        /* A rewrite starts with a marker of its own. */
+        AtmStatus rw = idem_rewrite(t);
+        if (rw == ATM_OK) {
+            st = ATM_OK;
+        }
+    }
+    return st;
+}
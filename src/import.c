@@ -0,0 +1,226 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      import.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Bulk account onboarding (see import.h). The whole file is read and
+ *   checked first, then merged into the store in one pass, hashed and
+ *   persisted once.
+ */
+
+#include "import.h"
+#include "auth.h"
+#include "timeutil.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMPORT_FIELDS 4 /* id, holder, pin, balance */
+
+typedef struct {
+    Account   *accounts;
+    char     (*pins)[MAX_PIN_LEN];
+    AtmStatus *results;
+    size_t    *lines;
+    size_t    *slots;
+    size_t     count;
+    size_t     capacity;
+} ImportBatch;
+
+static void import_batch_free(ImportBatch *b) {
+    free(b->accounts);
+    free(b->pins);
+    free(b->results);
+    free(b->lines);
+    free(b->slots);
+    memset(b, 0, sizeof(*b));
+}
+
+static AtmStatus import_batch_grow(ImportBatch *b) {
+    size_t new_cap = b->capacity ? b->capacity * 2 : 1024;
+
+    Account *ta = realloc(b->accounts, new_cap * sizeof(*ta));
+    if (ta) b->accounts = ta;
+    char (*tp)[MAX_PIN_LEN] = ta ? realloc(b->pins, new_cap * sizeof(*tp)) : NULL;
+    if (tp) b->pins = tp;
+    AtmStatus *tr = tp ? realloc(b->results, new_cap * sizeof(*tr)) : NULL;
+    if (tr) b->results = tr;
+    size_t *tl = tr ? realloc(b->lines, new_cap * sizeof(*tl)) : NULL;
+    if (tl) b->lines = tl;
+    size_t *ts = tl ? realloc(b->slots, new_cap * sizeof(*ts)) : NULL;
+    if (ts) b->slots = ts;
+    if (!ts) {
+        return ATM_ERR_INTERNAL;
+    }
+    b->capacity = new_cap;
+    return ATM_OK;
+}
+
+/* Checks one row (line end already stripped) and fills in the account and PIN. */
+static AtmStatus import_parse_row(char *line, Account *acc, char pin[MAX_PIN_LEN]) {
+    char  *fields[IMPORT_FIELDS];
+    size_t n = 0;
+    char  *p = line;
+
+    fields[n++] = p;
+    for (; *p; ++p) {
+        if (*p == ',') {
+            if (n == IMPORT_FIELDS) {
+                return ATM_ERR_PARSE;
+            }
+            *p          = '\0';
+            fields[n++] = p + 1;
+        }
+    }
+    if (n < 3 || !atm_valid_field(fields[0], MAX_ACCOUNT_ID_LEN) ||
+        !atm_valid_field(fields[1], MAX_NAME_LEN) || !atm_valid_field(fields[2], MAX_PIN_LEN)) {
+        return ATM_ERR_PARSE;
+    }
+
+    double balance = 0.0;
+    if (n == IMPORT_FIELDS) {
+        char *end = NULL;
+        errno     = 0;
+        balance   = strtod(fields[3], &end);
+        if (end == fields[3] || *end != '\0' || errno != 0 || !isfinite(balance)) {
+            return ATM_ERR_PARSE;
+        }
+        if (balance < 0.0 || balance > ACCOUNT_MAX_BALANCE) {
+            return ATM_ERR_INVALID_AMOUNT;
+        }
+    }
+
+    memset(acc, 0, sizeof(*acc));
+    strcpy(acc->id, fields[0]);
+    strcpy(acc->holder_name, fields[1]);
+    acc->balance = balance;
+    strcpy(pin, fields[2]);
+    return ATM_OK;
+}
+
+static AtmStatus import_read(FILE *in, ImportBatch *b) {
+    char   line[MAX_LINE_LEN];
+    size_t line_no = 0;
+
+    while (fgets(line, sizeof(line), in)) {
+        line_no++;
+        size_t len = strlen(line);
+        int    cut = (len == sizeof(line) - 1 && line[len - 1] != '\n');
+        if (cut) {
+            /* Overlong: skip the rest of the line and report it as malformed. */
+            int c;
+            while ((c = fgetc(in)) != EOF && c != '\n') {
+            }
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (line[0] == '#' || len == 0) {
+            continue;
+        }
+
+        if (b->count == b->capacity && import_batch_grow(b) != ATM_OK) {
+            return ATM_ERR_INTERNAL;
+        }
+        size_t i      = b->count++;
+        b->lines[i]   = line_no;
+        b->results[i] = cut ? ATM_ERR_PARSE
+                            : import_parse_row(line, &b->accounts[i], b->pins[i]);
+    }
+    return ferror(in) ? ATM_ERR_IO : ATM_OK;
+}
+
+/* Hashes the accepted rows' PINs in their store slots. */
+static AtmStatus import_hash(AtmContext *ctx, const ImportBatch *b, size_t accepted,
+                             unsigned threads) {
+    Account   **targets = malloc((accepted ? accepted : 1) * sizeof(*targets));
+    const char **pins   = malloc((accepted ? accepted : 1) * sizeof(*pins));
+    if (!targets || !pins) {
+        free(targets);
+        free(pins);
+        return ATM_ERR_INTERNAL;
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < b->count && k < accepted; ++i) {
+        if (b->results[i] == ATM_OK) {
+            targets[k] = &ctx->store.items[b->slots[i]];
+            pins[k++]  = b->pins[i];
+        }
+    }
+    AtmStatus st = auth_set_pins(targets, pins, k, threads);
+
+    free(targets);
+    free(pins);
+    return st;
+}
+
+AtmStatus import_accounts(AtmContext *ctx, FILE *in, FILE *out, unsigned threads,
+                          ImportReport *report) {
+    if (!ctx || !in || !out) return ATM_ERR_INTERNAL;
+
+    ImportReport local;
+    if (!report) report = &local;
+    memset(report, 0, sizeof(*report));
+
+    ImportBatch b;
+    memset(&b, 0, sizeof(b));
+
+    uint64_t  t0 = time_monotonic_ns();
+    AtmStatus st = import_read(in, &b);
+    if (st == ATM_OK) {
+        /* Start from the file as it is now, as atm_open_account does. */
+        st = atm_refresh(ctx, NULL, NULL);
+        if (st == ATM_ERR_CONFLICT) {
+            st = ATM_OK;
+        }
+    }
+    uint64_t t1 = time_monotonic_ns();
+    report->read_ns = t1 - t0;
+    if (st != ATM_OK) {
+        import_batch_free(&b);
+        return st;
+    }
+
+    size_t accepted = account_open_batch(&ctx->store, b.accounts, b.count, b.results, b.slots);
+    uint64_t t2 = time_monotonic_ns();
+    report->merge_ns = t2 - t1;
+
+    if (accepted > 0) {
+        /* The new records hold no PIN yet: nothing may be saved if this fails. */
+        st = import_hash(ctx, &b, accepted, threads);
+        uint64_t t3 = time_monotonic_ns();
+        report->hash_ns = t3 - t2;
+
+        if (st == ATM_OK) {
+            for (size_t i = 0; i < b.count; ++i) {
+                if (b.results[i] == ATM_OK) {
+                    bloom_add(&ctx->id_filter, b.accounts[i].id);
+                }
+            }
+            st = atm_persist(ctx);
+            report->persist_ns = time_monotonic_ns() - t3;
+        }
+    }
+
+    report->rows     = b.count;
+    report->imported = (st == ATM_OK) ? accepted : 0;
+    for (size_t i = 0; i < b.count; ++i) {
+        AtmStatus r = b.results[i];
+        if (r == ATM_ERR_PARSE || r == ATM_ERR_INVALID_AMOUNT) {
+            report->malformed++;
+        } else if (r == ATM_ERR_CONFLICT) {
+            report->duplicates++;
+        } else if (r == ATM_OK && st != ATM_OK) {
+            r = st; /* accepted, but the import as a whole failed */
+        }
+        fprintf(out, "%zu %d %s\n", b.lines[i], (int)r, atm_status_name(r));
+    }
+
+    import_batch_free(&b);
+    return st;
+}
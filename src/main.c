@@ -9,35 +9,731 @@
  *
  *   Usage:
  *     ./atm_cli [accounts_db_file]
+ *     ./atm_cli protocol [accounts_db_file]
+ *     ./atm_cli verify [accounts_db_file]
+ *     ./atm_cli transfers [accounts_db_file] < batch.csv
+ *     ./atm_cli rehash <accounts_db_file> [kdf_cost] [threads]
+ *     ./atm_cli import <accounts_db_file> [kdf_cost] [threads] < accounts.csv
+ *     ./atm_cli standby <accounts_db_file> <listen_addr>
+ *     ./atm_cli trace <dump_file> [--timeline]
+ *     ./atm_cli snapshot <accounts_db_file> <snapshot_file> [--base <snapshot_file>]
+ *     ./atm_cli restore <snapshot_file> <accounts_db_file>
+ *     ./atm_cli replay <accounts_db_file> <recording> [--speed <n> | --max]
+ *     ./atm_cli eod <accounts_db_file> <rules_file> <run_id> [threads]
+ *     ./atm_cli history <history_dir> <account_id> <time>
+ *     ./atm_cli open <accounts_db_file> <account_id> <holder> <pin> [balance]
+ *     ./atm_cli close <accounts_db_file> <account_id>
+ *     ./atm_cli compact [accounts_db_file]
+ *     ./atm_cli view <view_file> [account_id | --bench <seconds>]
  *
- *   If no DB file is provided, "accounts.db" in the current directory is used.
+ *   The interactive and "protocol" modes also accept
+ *     --replica <addr> [--sync]
+ *   to ship every persist to a standby (see replica.h).
+ *
+ *   Commands that take further arguments need the DB file first. Elsewhere,
+ *   if no DB file is provided, "accounts.db" in the current directory is used.
  *   The format is auto-detected:
  *     - *.db or *.csv → CSV format
  *     - *.json        → JSON format
+ *
+ *   The "protocol" command runs the headless line protocol (see protocol.h)
+ *   instead of the interactive menu. The "verify" command scrubs every
+ *   record checksum in the database without loading it. The "transfers"
+ *   command applies "from_id,to_id,amount[,key]" lines from stdin as one batch
+ *   with a single persist. The "rehash" command wraps every legacy PIN
+ *   hash in the salted KDF (see auth.h) and saves the database. The
+ *   "import" command opens the "id,holder,pin[,balance]" lines from stdin
+ *   as new accounts with a single persist, hashing their PINs at
+ *   kdf_cost (default: the current cost) on `threads` threads, and
+ *   reports "<line> <code> <name>" per line (see import.h). The
+ *   "standby" command mirrors a primary's store in memory until PROMOTE
+ *   arrives on stdin; it then saves it to its own DB file and continues
+ *   as a protocol-mode primary on the same stdin. The "trace" command
+ *   decodes a trace dump (see trace.h) into per-phase latencies and,
+ *   with --timeline, every event. The "snapshot" command writes a compact
+ *   archival copy of the database (see snapshot.h), as a delta against
+ *   --base if given; "restore" turns a snapshot back into a database.
+ *   With ATM_RECORD=<file>, the interactive and protocol modes record
+ *   their operations; "replay" runs a recording against the database at
+ *   n times the recorded pace (default 1) or as fast as possible, saving
+ *   to "<accounts_db_file>.replay" (see record.h). The "eod" command
+ *   applies the end-of-day interest and fee rules to every account and
+ *   saves once; rerunning an interrupted run resumes it (see eod.h).
+ *   With ATM_HISTORY=<dir>, every save is also logged for point-in-time
+ *   queries; "history" prints an account as it was at <time>, given as
+ *   local "YYYY-MM-DD HH:MM[:SS]" or "@<epoch_ms>" (see history.h).
+ *   The "open" and "close" commands add and retire accounts; closed
+ *   accounts stay behind as tombstones whose slots are reused, and
+ *   "compact" drops them (see account.h). A running ATM picks all three
+ *   up through hot reload.
+ *   With ATM_SHM_VIEW=<file>, the balances are published to shared memory
+ *   for read-only clients; "view" lists them, prints one account or
+ *   measures lookup throughput (see shmview.h).
  */
 
 #include "atm.h"
+#include "auth.h"
+#include "db_json.h"
+#include "eod.h"
+#include "history.h"
+#include "import.h"
+#include "protocol.h"
+#include "record.h"
+#include "shmview.h"
+#include "snapshot.h"
+#include "timeutil.h"
+#include "trace.h"
 #include "ui.h"
 
+#include <errno.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Commands that run against a database. Those with positional arguments
+ * of their own require the DB file before them, so that a missing one is
+ * reported instead of the first argument being taken as the database.
+ */
+typedef struct {
+    const char *name;
+    int         db_required;
+    int         min_args;  /* positional arguments after the DB file */
+    const char *usage;
+} CliCommand;
+
+static const CliCommand cli_commands[] = {
+    { "protocol",  0, 0, "protocol [accounts_db_file] [--replica <addr> [--sync]]" },
+    { "verify",    0, 0, "verify [accounts_db_file]" },
+    { "transfers", 0, 0, "transfers [accounts_db_file] < batch.csv" },
+    { "compact",   0, 0, "compact [accounts_db_file]" },
+    { "rehash",    1, 0, "rehash <accounts_db_file> [kdf_cost] [threads]" },
+    { "import",    1, 0, "import <accounts_db_file> [kdf_cost] [threads] < accounts.csv" },
+    { "standby",   1, 1, "standby <accounts_db_file> <listen_addr>" },
+    { "snapshot",  1, 1, "snapshot <accounts_db_file> <snapshot_file> [--base <snapshot_file>]" },
+    { "replay",    1, 1, "replay <accounts_db_file> <recording> [--speed <n> | --max]" },
+    { "eod",       1, 2, "eod <accounts_db_file> <rules_file> <run_id> [threads]" },
+    { "open",      1, 3, "open <accounts_db_file> <account_id> <holder> <pin> [balance]" },
+    { "close",     1, 1, "close <accounts_db_file> <account_id>" },
+};
+
+static const CliCommand *cli_find(const char *name) {
+    for (size_t i = 0; i < sizeof(cli_commands) / sizeof(cli_commands[0]); ++i) {
+        if (strcmp(cli_commands[i].name, name) == 0) {
+            return &cli_commands[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Counts the positional arguments from argi on, skipping options and their
+ * values. Returns -1 if an option lacks its value or the value is invalid.
+ */
+static int cli_positionals(int argc, char *argv[], int argi) {
+    int n = 0;
+    for (int i = argi; i < argc; ++i) {
+        if (strcmp(argv[i], "--speed") == 0) {
+            char  *end   = NULL;
+            double speed = (i + 1 < argc) ? strtod(argv[i + 1], &end) : -1.0;
+            if (i + 1 >= argc || end == argv[i + 1] || *end != '\0' || !(speed >= 0.0)) {
+                return -1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--base") == 0 || strcmp(argv[i], "--replica") == 0) {
+            if (++i >= argc) {
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--", 2) != 0) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static int cmd_verify(const char *db_path) {
+    AccountVerifyReport report;
+    AtmStatus st = atm_path_is_json(db_path)
+                 ? account_store_verify_json(db_path, &report)
+                 : account_store_verify(db_path, &report);
+
+    if (st == ATM_ERR_IO || st == ATM_ERR_INTERNAL) {
+        fprintf(stderr, "Failed to read DB '%s' (%s).\n", db_path, atm_status_name(st));
+        return 1;
+    }
+
+    printf("records:   %zu\n", report.records);
+    printf("verified:  %zu\n", report.verified);
+    printf("unchecked: %zu\n", report.unchecked);
+    printf("corrupted: %zu\n", report.corrupted);
+    printf("malformed: %zu\n", report.malformed);
+    if (report.first_bad) {
+        printf("first bad %s: %zu\n",
+               atm_path_is_json(db_path) ? "record" : "line", report.first_bad);
+    }
+    return (st == ATM_OK) ? 0 : 2;
+}
+
+static int cmd_trace(int argc, char *argv[], int argi) {
+    if (argc <= argi) {
+        fprintf(stderr, "Usage: atm_cli trace <dump_file> [--timeline]\n");
+        return 1;
+    }
+    int       timeline = argc > argi + 1 && strcmp(argv[argi + 1], "--timeline") == 0;
+    AtmStatus st       = trace_decode(argv[argi], stdout, timeline);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to decode trace '%s' (%s).\n", argv[argi], atm_status_name(st));
+        return 1;
+    }
+    return 0;
+}
+
+static long file_size(const char *path) {
+    FILE *f    = fopen(path, "rb");
+    long  size = -1;
+    if (f) {
+        if (fseek(f, 0, SEEK_END) == 0) {
+            size = ftell(f);
+        }
+        fclose(f);
+    }
+    return size;
+}
+
+static void print_snapshot_info(const char *verb, const SnapshotInfo *info, uint64_t ns) {
+    printf("%s %zu accounts in %.3f s (%.0f accounts/s)\n", verb, info->records,
+           (double)ns / 1e9, ns ? (double)info->records * 1e9 / (double)ns : 0.0);
+    printf("snapshot: %zu bytes, %s%s\n", info->bytes,
+           info->delta ? "delta against " : "full", info->base);
+    printf("records:  %zu kept, %zu changed, %zu inserted, %zu removed\n",
+           info->kept, info->changed, info->inserted, info->removed);
+}
+
+static int cmd_snapshot(AtmContext *ctx, int argc, char *argv[], int argi) {
+    const char *out  = NULL;
+    const char *base = NULL;
+    for (int i = argi; i < argc; ++i) {
+        if (strcmp(argv[i], "--base") == 0 && i + 1 < argc) {
+            base = argv[++i];
+        } else if (!out) {
+            out = argv[i];
+        }
+    }
+
+    SnapshotInfo info;
+    uint64_t     start = time_monotonic_ns();
+    AtmStatus    st    = snapshot_write(&ctx->store, out, base, &info);
+    uint64_t     ns    = time_monotonic_ns() - start;
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to write snapshot '%s' (%s).\n", out, atm_status_name(st));
+        if (base) {
+            fprintf(stderr, "The base snapshot must be readable and in the same directory.\n");
+        }
+        return 1;
+    }
+
+    print_snapshot_info("wrote", &info, ns);
+    long db_bytes = file_size(ctx->db_path);
+    if (db_bytes > 0 && info.bytes > 0) {
+        printf("ratio:    %.1fx smaller than %s (%ld bytes)\n",
+               (double)db_bytes / (double)info.bytes, ctx->db_path, db_bytes);
+    }
+    return 0;
+}
+
+static int cmd_restore(int argc, char *argv[], int argi) {
+    if (argc <= argi + 1) {
+        fprintf(stderr, "Usage: atm_cli restore <snapshot_file> <accounts_db_file>\n");
+        return 1;
+    }
+    const char *snap = argv[argi];
+    const char *db   = argv[argi + 1];
+
+    AccountStore store;
+    SnapshotInfo info;
+    AtmStatus    st    = account_store_init(&store);
+    uint64_t     start = time_monotonic_ns();
+    if (st == ATM_OK) {
+        st = snapshot_restore(snap, &store, &info);
+    }
+    uint64_t ns = time_monotonic_ns() - start;
+    if (st == ATM_OK) {
+        st = atm_path_is_json(db) ? account_store_save_json(&store, db, NULL)
+                                  : account_store_save(&store, db, NULL);
+    }
+    account_store_free(&store);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to restore '%s' into '%s' (%s).\n", snap, db, atm_status_name(st));
+        return 1;
+    }
+
+    print_snapshot_info("restored", &info, ns);
+    printf("chain:    %zu snapshot file(s) read\n", info.chain);
+    return 0;
+}
+
+/* "YYYY-MM-DD HH:MM[:SS]" in local time, or "@<ms since the epoch>". */
+static int parse_history_time(const char *text, uint64_t *at_ms) {
+    if (text[0] == '@') {
+        char *end = NULL;
+        *at_ms = strtoull(text + 1, &end, 10);
+        return end != text + 1 && *end == '\0';
+    }
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    int n = sscanf(text, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec);
+    if (n < 5) {
+        return 0;
+    }
+    if (n == 5) {
+        tm.tm_sec = 59; /* the whole named minute */
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    time_t t = mktime(&tm);
+    if (t == (time_t)-1) {
+        return 0;
+    }
+    *at_ms = (uint64_t)t * 1000u + 999u;
+    return 1;
+}
+
+static void format_history_time(uint64_t ms, char *out, size_t len) {
+    time_t     t  = (time_t)(ms / 1000u);
+    struct tm *tm = localtime(&t);
+    size_t     n  = tm ? strftime(out, len, "%Y-%m-%d %H:%M:%S", tm) : 0;
+    snprintf(out + n, len - n, ".%03u", (unsigned)(ms % 1000u));
+}
+
+static int cmd_history(int argc, char *argv[], int argi) {
+    uint64_t at_ms = 0;
+    if (argc <= argi + 2 || !parse_history_time(argv[argi + 2], &at_ms)) {
+        fprintf(stderr, "Usage: atm_cli history <history_dir> <account_id> "
+                        "<\"YYYY-MM-DD HH:MM[:SS]\" | @epoch_ms>\n");
+        return 1;
+    }
+    const char *dir = argv[argi];
+    const char *id  = argv[argi + 1];
+
+    Account       acc;
+    HistoryAnswer answer;
+    uint64_t      start = time_monotonic_ns();
+    AtmStatus     st    = history_query(dir, id, at_ms, &acc, &answer);
+    uint64_t      ns    = time_monotonic_ns() - start;
+    if (st != ATM_OK) {
+        fprintf(stderr, "No state for '%s' at that time in '%s' (%s).\n", id, dir,
+                atm_status_name(st));
+        return 1;
+    }
+
+    char as_of[48];
+    char segment[48];
+    format_history_time(answer.as_of_ms, as_of, sizeof(as_of));
+    format_history_time(answer.segment_ms, segment, sizeof(segment));
+    printf("account:  %s (%s)\n", acc.id, acc.holder_name);
+    printf("balance:  %.2f\n", acc.balance);
+    printf("locked:   %s, %u failed attempt(s)\n",
+           account_is_closed(&acc) ? "closed" : acc.is_locked ? "yes" : "no",
+           acc.failed_attempts);
+    printf("as of:    %s (%s)\n", as_of, answer.from_log ? "change log" : "segment snapshot");
+    printf("segment:  %s, %zu log entries read\n", segment, answer.entries_read);
+    printf("query:    %.3f ms\n", (double)ns / 1e6);
+    return 0;
+}
+
+static void print_view_balance(const ShmViewBalance *b) {
+    printf("%s %.2f %s\n", b->id, (double)b->cents / 100.0,
+           b->is_locked == ACCOUNT_CLOSED ? "closed" : b->is_locked ? "locked" : "open");
+}
+
+/* Random lookups for `seconds`; reports reads/s and seqlock retries. */
+static int view_bench(ShmViewReader *r, double seconds) {
+    size_t count = shmview_count(r);
+    if (count == 0 || !(seconds > 0.0)) {
+        fprintf(stderr, "Nothing to read.\n");
+        return 1;
+    }
+
+    size_t sample = count < 4096 ? count : 4096;
+    char (*ids)[MAX_ACCOUNT_ID_LEN] = malloc(sample * sizeof(*ids));
+    if (!ids) {
+        return 1;
+    }
+    ShmViewBalance b;
+    for (size_t i = 0; i < sample; ++i) {
+        ids[i][0] = '\0';
+        if (shmview_at(r, (size_t)((uint64_t)i * count / sample), &b) == ATM_OK) {
+            memcpy(ids[i], b.id, sizeof(ids[i]));
+        }
+    }
+
+    uint64_t publishes = atomic_load(&r->hdr->publishes);
+    uint64_t start     = time_monotonic_ns();
+    uint64_t deadline  = start + (uint64_t)(seconds * 1e9);
+    uint64_t reads     = 0;
+    uint64_t found     = 0;
+    uint64_t seed      = start | 1u;
+    uint64_t now       = start;
+    while (now < deadline) {
+        for (int k = 0; k < 1024; ++k) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            found += shmview_get(r, ids[seed % sample], &b) == ATM_OK;
+        }
+        reads += 1024;
+        now = time_monotonic_ns();
+    }
+    free(ids);
+
+    double secs = (double)(now - start) / 1e9;
+    printf("reads: %llu in %.2f s (%.0f reads/s, %.0f ns each), %llu found, %llu retries, "
+           "%llu publishes meanwhile\n",
+           (unsigned long long)reads, secs, (double)reads / secs,
+           (double)(now - start) / (double)reads, (unsigned long long)found,
+           (unsigned long long)r->retries,
+           (unsigned long long)(atomic_load(&r->hdr->publishes) - publishes));
+    return 0;
+}
+
+static int cmd_view(int argc, char *argv[], int argi) {
+    if (argc <= argi) {
+        fprintf(stderr, "Usage: atm_cli view <view_file> [account_id | --bench <seconds>]\n");
+        return 1;
+    }
+
+    ShmViewReader r;
+    AtmStatus     st = shmview_attach(&r, argv[argi]);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to attach to view '%s' (%s).\n", argv[argi], atm_status_name(st));
+        return 1;
+    }
+
+    int rc = 0;
+    if (argc > argi + 2 && strcmp(argv[argi + 1], "--bench") == 0) {
+        rc = view_bench(&r, strtod(argv[argi + 2], NULL));
+    } else if (argc > argi + 1) {
+        ShmViewBalance b;
+        st = shmview_get(&r, argv[argi + 1], &b);
+        if (st == ATM_OK) {
+            print_view_balance(&b);
+        } else {
+            fprintf(stderr, "%s: %s\n", argv[argi + 1], atm_status_name(st));
+            rc = 1;
+        }
+    } else {
+        size_t count = shmview_count(&r);
+        char   updated[48];
+        format_history_time(atomic_load(&r.hdr->updated_ms), updated, sizeof(updated));
+        printf("# %zu records, updated %s by pid %llu\n", count, updated,
+               (unsigned long long)r.hdr->writer_pid);
+        for (size_t i = 0; i < count; ++i) {
+            ShmViewBalance b;
+            if (shmview_at(&r, i, &b) == ATM_OK && b.is_locked != ACCOUNT_CLOSED) {
+                print_view_balance(&b);
+            }
+        }
+    }
+    shmview_detach(&r);
+    return rc;
+}
+
+static int cmd_rehash(AtmContext *ctx, int argc, char *argv[], int argi) {
+    if (argc > argi) {
+        auth_set_kdf_cost((unsigned)strtoul(argv[argi], NULL, 10));
+    }
+    unsigned threads = (argc > argi + 1) ? (unsigned)strtoul(argv[argi + 1], NULL, 10) : 0;
+
+    size_t    upgraded = 0;
+    AtmStatus st       = auth_rehash_store(&ctx->store, threads, &upgraded);
+    if (st == ATM_OK) {
+        st = atm_persist(ctx);
+    }
+
+    printf("rehashed %zu of %zu accounts at cost %u (%s)\n",
+           upgraded, ctx->store.size, auth_kdf_cost(), atm_status_name(st));
+    return (st == ATM_OK) ? 0 : 1;
+}
+
+static int cmd_import(AtmContext *ctx, int argc, char *argv[], int argi) {
+    if (argc > argi) {
+        auth_set_kdf_cost((unsigned)strtoul(argv[argi], NULL, 10));
+    }
+    unsigned threads = (argc > argi + 1) ? (unsigned)strtoul(argv[argi + 1], NULL, 10) : 0;
+
+    ImportReport report;
+    AtmStatus    st = import_accounts(ctx, stdin, stdout, threads, &report);
+
+    fprintf(stderr, "imported %zu of %zu rows at cost %u (%s): %zu malformed, %zu duplicate\n",
+            report.imported, report.rows, auth_kdf_cost(), atm_status_name(st),
+            report.malformed, report.duplicates);
+    fprintf(stderr, "read %.3f s, sort and merge %.3f s, hash %.3f s, save %.3f s\n",
+            (double)report.read_ns / 1e9, (double)report.merge_ns / 1e9,
+            (double)report.hash_ns / 1e9, (double)report.persist_ns / 1e9);
+    return (st == ATM_OK) ? 0 : 1;
+}
+
+static int cmd_open(AtmContext *ctx, int argc, char *argv[], int argi) {
+    /* Parsed as import rows are; the range is checked by atm_open_account. */
+    double    balance = 0.0;
+    AtmStatus st      = ATM_OK;
+    if (argc > argi + 3) {
+        const char *text = argv[argi + 3];
+        char       *end  = NULL;
+        errno            = 0;
+        balance          = strtod(text, &end);
+        if (end == text || *end != '\0' || errno != 0 || !isfinite(balance)) {
+            st = ATM_ERR_PARSE;
+        }
+    }
+    if (st == ATM_OK) {
+        st = atm_open_account(ctx, argv[argi], argv[argi + 1], argv[argi + 2], balance, NULL);
+    }
+    printf("open %s: %s\n", argv[argi], atm_status_name(st));
+    return (st == ATM_OK) ? 0 : 1;
+}
+
+static int cmd_close(AtmContext *ctx, char *argv[], int argi) {
+    size_t    before = ctx->store.size;
+    AtmStatus st     = atm_close_account(ctx, argv[argi], NULL);
+    printf("close %s: %s\n", argv[argi], atm_status_name(st));
+    if (st == ATM_OK && ctx->store.size < before) {
+        printf("compacted %zu closed accounts, %zu left\n",
+               before - ctx->store.size, ctx->store.size);
+    }
+    return (st == ATM_OK) ? 0 : 1;
+}
+
+static int cmd_compact(AtmContext *ctx) {
+    size_t    dropped = 0;
+    uint64_t  start   = time_monotonic_ns();
+    AtmStatus st      = atm_compact(ctx, NULL, &dropped);
+    uint64_t  ns      = time_monotonic_ns() - start;
+
+    printf("compacted %zu closed accounts, %zu left, in %.3f s (%s)\n",
+           dropped, ctx->store.size, (double)ns / 1e9, atm_status_name(st));
+    return (st == ATM_OK) ? 0 : 1;
+}
+
+static int cmd_replay(AtmContext *ctx, int argc, char *argv[], int argi) {
+    const char *path  = NULL;
+    double      speed = 1.0;
+    for (int i = argi; i < argc; ++i) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--max") == 0) {
+            speed = 0.0;
+        } else if (!path) {
+            path = argv[i];
+        }
+    }
+
+    /* Never save over the source database: the replay PINs would stick. */
+    if (strlen(ctx->db_path) + sizeof(RECORD_REPLAY_SUFFIX) > sizeof(ctx->db_path)) {
+        fprintf(stderr, "Database path too long.\n");
+        return 1;
+    }
+    strcat(ctx->db_path, RECORD_REPLAY_SUFFIX);
+
+    AtmStatus st = record_replay(ctx, path, speed, stdout);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to replay '%s' (%s).\n", path, atm_status_name(st));
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_eod(AtmContext *ctx, int argc, char *argv[], int argi) {
+    unsigned threads = (argc > argi + 2) ? (unsigned)strtoul(argv[argi + 2], NULL, 10) : 0;
+
+    EodRules  rules;
+    size_t    bad_line = 0;
+    AtmStatus st       = eod_rules_load(&rules, argv[argi], &bad_line);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Failed to read rules '%s' (%s", argv[argi], atm_status_name(st));
+        if (bad_line) {
+            fprintf(stderr, " at line %zu", bad_line);
+        }
+        fprintf(stderr, ").\n");
+        return 1;
+    }
+
+    EodReport report;
+    st = eod_run(ctx, &rules, argv[argi + 1], threads, &report);
+    if (st == ATM_ERR_CONFLICT) {
+        fprintf(stderr, "Run '%s' refused: another run is unfinished or the database no longer "
+                        "matches '%s%s'.\n", argv[argi + 1], ctx->db_path, EOD_CHECKPOINT_SUFFIX);
+        return 1;
+    }
+    if (st != ATM_OK) {
+        fprintf(stderr, "Run '%s' failed (%s); rerun it to resume.\n",
+                argv[argi + 1], atm_status_name(st));
+        return 1;
+    }
+
+    printf("eod %s: %zu of %zu accounts changed, interest %.2f, fees %.2f%s\n",
+           argv[argi + 1], report.accounts, ctx->store.size,
+           (double)report.interest_cents / 100.0, (double)report.fee_cents / 100.0,
+           report.already_done ? " (already applied)" : report.resumed ? " (resumed)" : "");
+    if (!report.already_done && report.apply_ns) {
+        printf("applied in %.3f s (%.0f accounts/s), saved in %.3f s\n",
+               (double)report.apply_ns / 1e9,
+               (double)ctx->store.size * 1e9 / (double)report.apply_ns,
+               (double)report.persist_ns / 1e9);
+    }
+    return 0;
+}
+
+static int cmd_standby(AtmContext *ctx, char *argv[], int argi) {
+    int       promoted = 0;
+    AtmStatus st       = replica_standby_run(&ctx->store, argv[argi], &promoted);
+    if (st != ATM_OK) {
+        fprintf(stderr, "Standby failed on '%s' (%s).\n", argv[argi], atm_status_name(st));
+        return 1;
+    }
+    if (!promoted) {
+        return 0;
+    }
+
+    st = atm_store_replaced(ctx);
+    fprintf(stderr, "standby: promoted with %zu accounts (%s)\n",
+            ctx->store.size, atm_status_name(st));
+    if (st != ATM_OK) {
+        return 1;
+    }
+    return (protocol_run(ctx) == ATM_OK) ? 0 : 1;
+}
 
 int main(int argc, char *argv[]) {
-    const char *default_db = "accounts.db";
-    const char *db_path    = default_db;
+    const char *default_db   = "accounts.db";
+    const char *db_path      = default_db;
+    const char *command      = NULL;
+    const char *replica_addr = NULL;
+    int         replica_sync = 0;
+    int         argi         = 1;
+
+    if (argc > argi && (strcmp(argv[argi], "protocol") == 0 ||
+                        strcmp(argv[argi], "verify") == 0 ||
+                        strcmp(argv[argi], "transfers") == 0 ||
+                        strcmp(argv[argi], "rehash") == 0 ||
+                        strcmp(argv[argi], "import") == 0 ||
+                        strcmp(argv[argi], "standby") == 0 ||
+                        strcmp(argv[argi], "trace") == 0 ||
+                        strcmp(argv[argi], "snapshot") == 0 ||
+                        strcmp(argv[argi], "restore") == 0 ||
+                        strcmp(argv[argi], "replay") == 0 ||
+                        strcmp(argv[argi], "eod") == 0 ||
+                        strcmp(argv[argi], "history") == 0 ||
+                        strcmp(argv[argi], "open") == 0 ||
+                        strcmp(argv[argi], "close") == 0 ||
+                        strcmp(argv[argi], "compact") == 0 ||
+                        strcmp(argv[argi], "view") == 0)) {
+        command = argv[argi++];
+    }
+
+    if (command && strcmp(command, "trace") == 0) {
+        return cmd_trace(argc, argv, argi);
+    }
+    if (command && strcmp(command, "restore") == 0) {
+        return cmd_restore(argc, argv, argi);
+    }
+    if (command && strcmp(command, "history") == 0) {
+        return cmd_history(argc, argv, argi);
+    }
+    if (command && strcmp(command, "view") == 0) {
+        return cmd_view(argc, argv, argi);
+    }
+
+    /* Checked before anything is created next to the database. */
+    const CliCommand *cli = command ? cli_find(command) : NULL;
+    if (cli && cli->db_required && (argc <= argi || strncmp(argv[argi], "--", 2) == 0)) {
+        fprintf(stderr, "Usage: atm_cli %s\n", cli->usage);
+        return 1;
+    }
+    if (argc > argi && strncmp(argv[argi], "--", 2) != 0) {
+        db_path = argv[argi++];
+    }
+    if (cli && cli_positionals(argc, argv, argi) < cli->min_args) {
+        fprintf(stderr, "Usage: atm_cli %s\n", cli->usage);
+        return 1;
+    }
+
+    if (!command || strcmp(command, "protocol") == 0) {
+        for (int i = argi; i < argc; ++i) {
+            if (strcmp(argv[i], "--replica") == 0 && i + 1 < argc) {
+                replica_addr = argv[++i];
+            } else if (strcmp(argv[i], "--sync") == 0) {
+                replica_sync = 1;
+            }
+        }
+    }
 
-    if (argc > 1) {
-        db_path = argv[1];
+    if (command && strcmp(command, "verify") == 0) {
+        return cmd_verify(db_path);
+    }
+
+    trace_init();
+    if (!command || strcmp(command, "protocol") == 0) {
+        record_init();
     }
 
     AtmContext ctx;
     AtmStatus st = atm_init(&ctx, db_path);
     if (st != ATM_OK) {
-        fprintf(stderr, "Failed to initialize ATM with DB '%s'.\n", db_path);
+        fprintf(stderr, "Failed to initialize ATM with DB '%s' (%s).\n",
+                db_path, atm_status_name(st));
         return 1;
     }
 
-    atm_run(&ctx);
+    if (replica_addr) {
+        st = replica_connect(&ctx.replica, replica_addr, replica_sync, &ctx.store);
+        if (st != ATM_OK) {
+            fprintf(stderr, "Failed to reach standby '%s' (%s).\n",
+                    replica_addr, atm_status_name(st));
+            atm_shutdown(&ctx);
+            return 1;
+        }
+    }
+
+    int rc = 0;
+    if (command && strcmp(command, "standby") == 0) {
+        rc = cmd_standby(&ctx, argv, argi);
+    } else if (command && strcmp(command, "snapshot") == 0) {
+        rc = cmd_snapshot(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "replay") == 0) {
+        rc = cmd_replay(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "eod") == 0) {
+        rc = cmd_eod(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "open") == 0) {
+        rc = cmd_open(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "close") == 0) {
+        rc = cmd_close(&ctx, argv, argi);
+    } else if (command && strcmp(command, "compact") == 0) {
+        rc = cmd_compact(&ctx);
+    } else if (command && strcmp(command, "rehash") == 0) {
+        rc = cmd_rehash(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "import") == 0) {
+        rc = cmd_import(&ctx, argc, argv, argi);
+    } else if (command && strcmp(command, "transfers") == 0) {
+        rc = (atm_transfer_batch(&ctx, stdin, stdout) == ATM_OK) ? 0 : 1;
+    } else if (command) {
+        rc = (protocol_run(&ctx) == ATM_OK) ? 0 : 1;
+    } else {
+        atm_run(&ctx);
+    }
+
+    if (replica_addr) {
+        replica_wait(&ctx.replica, REPLICA_SYNC_TIMEOUT_MS);
+        replica_print_stats(&ctx.replica, stderr);
+    }
     atm_shutdown(&ctx);
+    record_shutdown();
+    trace_shutdown();
 
-    return 0;
+    return rc;
 }
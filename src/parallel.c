@@ -0,0 +1,107 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      parallel.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Implementation of the fork/join helper.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+
+#include <stdlib.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  define PARALLEL_HAVE_PTHREADS 0
+#else
+#  define PARALLEL_HAVE_PTHREADS 1
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#define PARALLEL_MAX_THREADS 256
+
+unsigned parallel_cpu_count(void) {
+#if PARALLEL_HAVE_PTHREADS && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) {
+        return n > PARALLEL_MAX_THREADS ? PARALLEL_MAX_THREADS : (unsigned)n;
+    }
+#endif
+    return 1;
+}
+
+#if PARALLEL_HAVE_PTHREADS
+typedef struct {
+    ParallelRangeFn fn;
+    void           *arg;
+    size_t          begin;
+    size_t          end;
+} ParallelTask;
+
+static void *parallel_worker(void *p) {
+    ParallelTask *task = (ParallelTask *)p;
+    task->fn(task->arg, task->begin, task->end);
+    return NULL;
+}
+#endif
+
+AtmStatus parallel_for(size_t count, unsigned threads, ParallelRangeFn fn, void *arg) {
+    if (!fn) return ATM_ERR_INTERNAL;
+    if (count == 0) return ATM_OK;
+
+    if (threads == 0) threads = parallel_cpu_count();
+    if (threads > PARALLEL_MAX_THREADS) threads = PARALLEL_MAX_THREADS;
+    if ((size_t)threads > count) threads = (unsigned)count;
+
+#if PARALLEL_HAVE_PTHREADS
+    if (threads > 1) {
+        pthread_t    *ids   = malloc(threads * sizeof(*ids));
+        ParallelTask *tasks = malloc(threads * sizeof(*tasks));
+        if (ids && tasks) {
+            size_t   chunk   = count / threads;
+            size_t   extra   = count % threads;
+            size_t   begin   = 0;
+            unsigned started = 0;
+
+            for (unsigned t = 0; t < threads; ++t) {
+                size_t len     = chunk + (t < extra ? 1 : 0);
+                tasks[t].fn    = fn;
+                tasks[t].arg   = arg;
+                tasks[t].begin = begin;
+                tasks[t].end   = begin + len;
+                begin         += len;
+            }
+
+            /* Thread 0's range runs on the calling thread. */
+            for (unsigned t = 1; t < threads; ++t) {
+                if (pthread_create(&ids[t], NULL, parallel_worker, &tasks[t]) != 0) {
+                    break;
+                }
+                started = t;
+            }
+            fn(arg, tasks[0].begin, tasks[0].end);
+
+            for (unsigned t = 1; t <= started; ++t) {
+                pthread_join(ids[t], NULL);
+            }
+            /* Ranges whose thread failed to start run here instead. */
+            for (unsigned t = started + 1; t < threads; ++t) {
+                fn(arg, tasks[t].begin, tasks[t].end);
+            }
+
+            free(ids);
+            free(tasks);
+            return ATM_OK;
+        }
+        free(ids);
+        free(tasks);
+    }
+#endif
+
+    fn(arg, 0, count);
+    return ATM_OK;
+}
@@ -0,0 +1,499 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      protocol.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Implementation of the headless request/response line protocol.
+ *   Input is read in large blocks straight from the stdin descriptor so
+ *   that the server knows when it has drained everything the front end
+ *   sent; that is the point at which dirty state is persisted once and
+ *   the batched responses are flushed. Responses to changes are held until
+ *   then, so that a failed save can be reported in their place.
+ */
+
+#include "protocol.h"
+#include "account_codec.h"
+#include "auth.h"
+#include "record.h"
+#include "timeutil.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  include <io.h>
+#  define PROTO_READ(fd, buf, n) _read((fd), (buf), (unsigned)(n))
+#  define PROTO_STDIN 0
+#else
+#  include <unistd.h>
+#  define PROTO_READ(fd, buf, n) read((fd), (buf), (n))
+#  define PROTO_STDIN STDIN_FILENO
+#endif
+
+#define PROTO_IN_BUF_LEN  (64 * 1024)
+#define PROTO_OUT_BUF_LEN (64 * 1024)
+#define PROTO_SOURCE_LEN  64
+#define PROTO_DEFAULT_SRC "protocol"
+#define PROTO_SAVE_RETRY_MS   30000 /* how long a failing save is retried */
+#define PROTO_SAVE_BACKOFF_MS 1000  /* longest pause between two attempts */
+
+typedef struct {
+    char   buf[PROTO_IN_BUF_LEN];
+    size_t start;
+    size_t end;
+    int    eof;
+    int    overlong; /* the line just returned did not fit in buf */
+} ProtoReader;
+
+/* Responses queued until the next sync. */
+typedef struct {
+    char   *buf;
+    size_t  len;
+    size_t  cap;
+    size_t *changes;      /* offsets of responses reporting an unsaved change */
+    size_t  changes_len;
+    size_t  changes_cap;
+} ProtoOutput;
+
+typedef struct {
+    AtmContext *ctx;
+    Account    *account; /* logged-in account, NULL when logged out */
+    int         dirty;   /* store changed since the last persist */
+    int         failed;  /* a save kept failing: the session is over */
+    AtmStatus   persist_status;
+    char        source[PROTO_SOURCE_LEN]; /* terminal identity for throttling */
+    ProtoOutput out;
+} ProtoSession;
+
+/*
+ * Queues one response line. `change` marks a response that reports a
+ * change not yet saved. If memory runs out, the queue is written as is
+ * and the line goes straight to stdout.
+ */
+static void proto_emit(ProtoSession *s, const char *line, size_t n, int change) {
+    ProtoOutput *o = &s->out;
+    if (o->len + n > o->cap) {
+        size_t cap = o->cap ? o->cap : PROTO_OUT_BUF_LEN;
+        while (cap < o->len + n) cap *= 2;
+        char *grown = realloc(o->buf, cap);
+        if (!grown) {
+            fwrite(o->buf, 1, o->len, stdout);
+            fwrite(line, 1, n, stdout);
+            o->len         = 0;
+            o->changes_len = 0;
+            return;
+        }
+        o->buf = grown;
+        o->cap = cap;
+    }
+    if (change && o->changes_len == o->changes_cap) {
+        size_t  cap   = o->changes_cap ? o->changes_cap * 2 : 256;
+        size_t *grown = realloc(o->changes, cap * sizeof(*grown));
+        if (grown) {
+            o->changes     = grown;
+            o->changes_cap = cap;
+        }
+    }
+    if (change && o->changes_len < o->changes_cap) {
+        o->changes[o->changes_len++] = o->len;
+    }
+    memcpy(o->buf + o->len, line, n);
+    o->len += n;
+}
+
+/*
+ * Writes the queued responses. With `failed` != ATM_OK, responses to
+ * changes carry that status in place of their own "<code> <name>".
+ */
+static void proto_flush_output(ProtoSession *s, AtmStatus failed) {
+    ProtoOutput *o    = &s->out;
+    size_t       done = 0;
+    for (size_t c = 0; c < o->changes_len && failed != ATM_OK; ++c) {
+        size_t start = o->changes[c];
+        size_t rest  = start;
+        int    words = 0;
+        while (rest < o->len && o->buf[rest] != '\n' && words < 2) {
+            if (o->buf[rest++] == ' ') {
+                words++;
+            }
+        }
+        if (words == 2) {
+            rest--; /* keep the space before the balance */
+        }
+        fwrite(o->buf + done, 1, start - done, stdout);
+        printf("%d %s", (int)failed, atm_status_name(failed));
+        done = rest;
+    }
+    fwrite(o->buf + done, 1, o->len - done, stdout);
+    o->len         = 0;
+    o->changes_len = 0;
+    fflush(stdout);
+}
+
+/* Merges external edits to the database; problems are reported on stderr. */
+static AtmStatus proto_refresh(ProtoSession *s) {
+    ReloadReport report;
+    AtmStatus    st = atm_refresh(s->ctx, &s->account, &report);
+    if (st == ATM_ERR_CONFLICT) {
+        fprintf(stderr, "%d %s reload %zu %s\n", (int)st, atm_status_name(st),
+                report.conflicts, report.first_conflict);
+    } else if (st != ATM_OK) {
+        fprintf(stderr, "%d %s reload\n", (int)st, atm_status_name(st));
+    }
+    return st;
+}
+
+/*
+ * Persists pending changes, then makes all queued responses visible.
+ * Pending changes are not saved while the file cannot be reloaded, so that
+ * edits made by other processes are never overwritten unseen.
+ *
+ * A change that could not be saved stays applied, and any later save would
+ * write it, so its response cannot simply report the failure. Instead the
+ * reload and save are retried, with every response held, for up to
+ * PROTO_SAVE_RETRY_MS. If they still fail, the responses to the unsaved
+ * changes carry the failing status and the session ends without saving
+ * them. Returns 0 in that case.
+ */
+static int proto_sync(ProtoSession *s) {
+    if (s->failed) return 0;
+
+    uint64_t  now      = time_monotonic_ns();
+    uint64_t  deadline = now + (uint64_t)PROTO_SAVE_RETRY_MS * 1000000u;
+    uint64_t  pause_ms = 10;
+    AtmStatus st       = ATM_OK;
+    int       tried    = 0;
+    for (;;) {
+        st = proto_refresh(s);
+        if (st == ATM_ERR_CONFLICT) {
+            st = ATM_OK;
+        }
+        if (!s->dirty) {
+            break;
+        }
+        if (st == ATM_OK) {
+            st = atm_persist(s->ctx);
+            if (st != ATM_OK && !tried) {
+                fprintf(stderr, "%d %s persist (retrying)\n", (int)st, atm_status_name(st));
+            }
+            tried = 1;
+        }
+        if (st == ATM_OK) {
+            s->dirty = 0;
+            break;
+        }
+        now = time_monotonic_ns();
+        if (now >= deadline) {
+            fprintf(stderr, "%d %s persist (giving up)\n", (int)st, atm_status_name(st));
+            s->failed = 1;
+            break;
+        }
+        time_sleep_until_ns(now + pause_ms * 1000000u);
+        pause_ms = (pause_ms * 2 < PROTO_SAVE_BACKOFF_MS) ? pause_ms * 2 : PROTO_SAVE_BACKOFF_MS;
+    }
+
+    if (st != ATM_OK || tried) {
+        s->persist_status = st;
+    }
+    proto_flush_output(s, s->failed ? st : ATM_OK);
+    return !s->failed;
+}
+
+/*
+ * Returns the next input line (without its newline) or NULL at end of
+ * input. A line that does not fit in the buffer is discarded and returned
+ * as an empty line with r->overlong set, so that it still gets a response.
+ */
+static char *proto_next_line(ProtoReader *r, ProtoSession *s) {
+    int discarding = 0;
+
+    r->overlong = 0;
+    for (;;) {
+        char *nl = NULL;
+        if (r->end > r->start) {
+            nl = memchr(r->buf + r->start, '\n', r->end - r->start);
+        }
+
+        if (nl) {
+            char *line = r->buf + r->start;
+            *nl        = '\0';
+            r->start   = (size_t)(nl - r->buf) + 1;
+            if (discarding) {
+                r->overlong = 1;
+                return nl;
+            }
+            if (nl > line && nl[-1] == '\r') {
+                nl[-1] = '\0';
+            }
+            return line;
+        }
+
+        if (r->eof) {
+            if (r->end > r->start || discarding) {
+                char *line = r->buf + r->start;
+                r->buf[r->end] = '\0';
+                r->start       = r->end;
+                r->overlong    = discarding;
+                return discarding ? r->buf + r->end : line;
+            }
+            return NULL;
+        }
+
+        /* Make room: shift the partial line to the front. */
+        if (r->start > 0) {
+            memmove(r->buf, r->buf + r->start, r->end - r->start);
+            r->end  -= r->start;
+            r->start = 0;
+        }
+        if (r->end >= sizeof(r->buf) - 1) {
+            r->end     = 0;
+            discarding = 1;
+        }
+
+        /* About to block: everything received so far has been answered. */
+        if (!proto_sync(s)) {
+            return NULL;
+        }
+
+        long n = (long)PROTO_READ(PROTO_STDIN, r->buf + r->end,
+                                  sizeof(r->buf) - 1 - r->end);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            r->eof = 1;
+            continue;
+        }
+        r->end += (size_t)n;
+
+        /* The file may have changed while we were blocked. */
+        proto_refresh(s);
+    }
+}
+
+static char *proto_next_token(char **cursor) {
+    char *p = *cursor;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0') {
+        *cursor = p;
+        return NULL;
+    }
+
+    char *tok = p;
+    while (*p && *p != ' ' && *p != '\t') p++;
+    if (*p) *p++ = '\0';
+    *cursor = p;
+    return tok;
+}
+
+static int proto_parse_amount(const char *tok, double *out) {
+    if (!tok) return 0;
+    char *endptr = NULL;
+    errno = 0;
+    double v = strtod(tok, &endptr);
+    if (errno != 0 || !endptr || endptr == tok || *endptr != '\0' || !isfinite(v)) {
+        return 0;
+    }
+    *out = v;
+    return 1;
+}
+
+static void proto_reply(ProtoSession *s, AtmStatus st) {
+    char line[64];
+    int  n = snprintf(line, sizeof(line), "%d %s\n", (int)st, atm_status_name(st));
+    proto_emit(s, line, (size_t)n, 0);
+}
+
+/* `change`: the response reports a change that the next sync must save. */
+static void proto_reply_balance(ProtoSession *s, AtmStatus st, const Account *acc, int change) {
+    char line[64 + ACCOUNT_MONEY_TEXT_MAX];
+    int  n = snprintf(line, sizeof(line), "%d %s %.2f\n", (int)st, atm_status_name(st),
+                      acc->balance);
+    if (n >= (int)sizeof(line)) n = (int)sizeof(line) - 1;
+    proto_emit(s, line, (size_t)n, change);
+}
+
+/* Replies to LOGIN and returns the status sent. */
+static AtmStatus proto_login(ProtoSession *s, char *args) {
+    char *id  = proto_next_token(&args);
+    char *pin = proto_next_token(&args);
+    if (!id || !pin) {
+        proto_reply(s, ATM_ERR_PARSE);
+        return ATM_ERR_PARSE;
+    }
+
+    s->account = NULL;
+
+    /* Throttled attempts are answered without touching the store. */
+    uint64_t retry_ms = 0;
+    if (throttle_check(&s->ctx->throttle, id, s->source,
+                       time_monotonic_ms(), &retry_ms) != ATM_OK) {
+        char line[64];
+        int  n = snprintf(line, sizeof(line), "%d %s %llu\n", (int)ATM_ERR_THROTTLED,
+                          atm_status_name(ATM_ERR_THROTTLED), (unsigned long long)retry_ms);
+        proto_emit(s, line, (size_t)n, 0);
+        return ATM_ERR_THROTTLED;
+    }
+
+    Account *acc = atm_find_account(s->ctx, id);
+    if (!acc) {
+        throttle_record(&s->ctx->throttle, id, s->source, time_monotonic_ms(), 0);
+        record_login(id, ATM_ERR_NOT_FOUND);
+        proto_reply(s, ATM_ERR_NOT_FOUND);
+        return ATM_ERR_NOT_FOUND;
+    }
+
+    unsigned prev_failed  = acc->failed_attempts;
+    int      prev_locked  = acc->is_locked;
+    unsigned prev_version = acc->hash_version;
+    unsigned prev_cost    = acc->kdf_cost;
+
+    /* Only persist when the record changed (failures, lock, hash upgrade). */
+    AtmStatus st = auth_verify_login(acc, pin);
+    throttle_record(&s->ctx->throttle, id, s->source, time_monotonic_ms(), st == ATM_OK);
+    record_login(id, st);
+    if (acc->failed_attempts != prev_failed || acc->is_locked != prev_locked ||
+        acc->hash_version != prev_version || acc->kdf_cost != prev_cost) {
+        s->dirty = 1;
+    }
+    if (st == ATM_OK) {
+        s->account = acc;
+    }
+    proto_reply(s, st);
+    return st;
+}
+
+static void proto_handle_login(ProtoSession *s, char *args) {
+    TRACE_BEGIN_EVENT(TRACE_LOGIN, 0);
+    AtmStatus st = proto_login(s, args);
+    TRACE_END_EVENT(TRACE_LOGIN, st, 0);
+}
+
+static void proto_handle_source(ProtoSession *s, char *args) {
+    char *src = proto_next_token(&args);
+    if (!src || strlen(src) >= sizeof(s->source)) {
+        proto_reply(s, ATM_ERR_PARSE);
+        return;
+    }
+    memcpy(s->source, src, strlen(src) + 1);
+    proto_reply(s, ATM_OK);
+}
+
+static void proto_handle_amount(ProtoSession *s, char *args, int deposit) {
+    if (!s->account) {
+        proto_reply(s, ATM_ERR_AUTH_FAILED);
+        return;
+    }
+
+    double amount = 0.0;
+    if (!proto_parse_amount(proto_next_token(&args), &amount)) {
+        proto_reply(s, ATM_ERR_PARSE);
+        return;
+    }
+    const char *key = proto_next_token(&args);
+
+    TraceTxnKind kind = deposit ? TRACE_TXN_DEPOSIT : TRACE_TXN_WITHDRAW;
+    TRACE_BEGIN_EVENT(TRACE_TXN, kind);
+    AtmStatus st = deposit ? atm_deposit(s->ctx, s->account, amount, key)
+                           : atm_withdraw(s->ctx, s->account, amount, key);
+    TRACE_END_EVENT(TRACE_TXN, st, kind);
+    record_amount(deposit ? RECORD_DEPOSIT : RECORD_WITHDRAW, amount, st);
+    if (st == ATM_OK) {
+        s->dirty = 1;
+    }
+    proto_reply_balance(s, st, s->account, st == ATM_OK);
+}
+
+static void proto_handle_transfer(ProtoSession *s, char *args) {
+    if (!s->account) {
+        proto_reply(s, ATM_ERR_AUTH_FAILED);
+        return;
+    }
+
+    char  *to_id  = proto_next_token(&args);
+    double amount = 0.0;
+    if (!to_id || !proto_parse_amount(proto_next_token(&args), &amount)) {
+        proto_reply(s, ATM_ERR_PARSE);
+        return;
+    }
+    const char *key = proto_next_token(&args);
+
+    TRACE_BEGIN_EVENT(TRACE_TXN, TRACE_TXN_TRANSFER);
+    AtmStatus st = atm_transfer(s->ctx, s->account->id, to_id, amount, key);
+    TRACE_END_EVENT(TRACE_TXN, st, TRACE_TXN_TRANSFER);
+    record_transfer(to_id, amount, st);
+    if (st == ATM_OK) {
+        s->dirty = 1;
+    }
+    proto_reply_balance(s, st, s->account, st == ATM_OK);
+}
+
+AtmStatus protocol_run(AtmContext *ctx) {
+    if (!ctx) return ATM_ERR_INTERNAL;
+
+    static ProtoReader reader;
+    static char        out_buf[PROTO_OUT_BUF_LEN];
+
+    memset(&reader, 0, sizeof(reader));
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+
+    ProtoSession s;
+    s.ctx            = ctx;
+    s.account        = NULL;
+    s.dirty          = 0;
+    s.failed         = 0;
+    s.persist_status = ATM_OK;
+    strcpy(s.source, PROTO_DEFAULT_SRC);
+    memset(&s.out, 0, sizeof(s.out));
+
+    char *line;
+    while ((line = proto_next_line(&reader, &s)) != NULL) {
+        if (reader.overlong) {
+            proto_reply(&s, ATM_ERR_PARSE);
+            continue;
+        }
+        char *cursor = line;
+        char *cmd    = proto_next_token(&cursor);
+        if (!cmd) {
+            continue;
+        }
+
+        if (strcmp(cmd, "LOGIN") == 0) {
+            proto_handle_login(&s, cursor);
+        } else if (strcmp(cmd, "BAL") == 0) {
+            if (!s.account) {
+                proto_reply(&s, ATM_ERR_AUTH_FAILED);
+            } else {
+                record_op(RECORD_BALANCE, ATM_OK);
+                proto_reply_balance(&s, ATM_OK, s.account, 0);
+            }
+        } else if (strcmp(cmd, "DEP") == 0) {
+            proto_handle_amount(&s, cursor, 1);
+        } else if (strcmp(cmd, "WDR") == 0) {
+            proto_handle_amount(&s, cursor, 0);
+        } else if (strcmp(cmd, "XFR") == 0) {
+            proto_handle_transfer(&s, cursor);
+        } else if (strcmp(cmd, "SRC") == 0) {
+            proto_handle_source(&s, cursor);
+        } else if (strcmp(cmd, "LOGOUT") == 0) {
+            s.account = NULL;
+            record_op(RECORD_LOGOUT, ATM_OK);
+            proto_reply(&s, ATM_OK);
+        } else if (strcmp(cmd, "QUIT") == 0) {
+            break;
+        } else {
+            proto_reply(&s, ATM_ERR_PARSE);
+        }
+    }
+
+    proto_sync(&s);
+    free(s.out.buf);
+    free(s.out.changes);
+    return s.persist_status;
+}
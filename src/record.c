@@ -0,0 +1,494 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      record.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Session recorder (a buffered append-only file) and the replay engine
+ *   that drives the store from a recording and measures it.
+ */
+
+#include "record.h"
+#include "auth.h"
+#include "timeutil.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RECORD_HEADER_LEN 8
+#define RECORD_MAX_LEN    (10 + 2 + 1 + MAX_ACCOUNT_ID_LEN + 10)
+#define RECORD_BAD_PIN    "-" /* never matches: PINs are digits */
+
+static FILE         *rec_fp;
+static unsigned char rec_buf[RECORD_BUF_LEN];
+static size_t        rec_used;
+static uint64_t      rec_last_us;
+
+/* ---------------------------------------------------------------------- */
+/* Recorder                                                               */
+/* ---------------------------------------------------------------------- */
+
+static void rec_put_varint(uint64_t v) {
+    while (v >= 0x80) {
+        rec_buf[rec_used++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    rec_buf[rec_used++] = (unsigned char)v;
+}
+
+static void rec_put_str(const char *s) {
+    size_t len = strlen(s);
+    if (len >= MAX_ACCOUNT_ID_LEN) {
+        len = MAX_ACCOUNT_ID_LEN - 1;
+    }
+    rec_put_varint(len);
+    memcpy(rec_buf + rec_used, s, len);
+    rec_used += len;
+}
+
+static int64_t rec_cents(double amount) {
+    /* Rejected amounts only need to stay rejected on replay. */
+    if (!isfinite(amount) || fabs(amount) > 1e15) {
+        return 0;
+    }
+    return llround(amount * 100.0);
+}
+
+static void rec_flush(void) {
+    if (rec_used && fwrite(rec_buf, 1, rec_used, rec_fp) != rec_used) {
+        fprintf(stderr, "record: write failed, recording stopped\n");
+        fclose(rec_fp);
+        rec_fp = NULL;
+    }
+    rec_used = 0;
+}
+
+/* Starts a record; returns 0 when not recording. */
+static int rec_begin(RecordOp op, AtmStatus status) {
+    if (!rec_fp) {
+        return 0;
+    }
+    if (rec_used + RECORD_MAX_LEN > sizeof(rec_buf)) {
+        rec_flush();
+        if (!rec_fp) {
+            return 0;
+        }
+    }
+    uint64_t now_us = time_monotonic_ns() / 1000u;
+    rec_put_varint(now_us - rec_last_us);
+    rec_last_us         = now_us;
+    rec_buf[rec_used++] = (unsigned char)op;
+    rec_buf[rec_used++] = (unsigned char)status;
+    return 1;
+}
+
+void record_init(void) {
+    const char *env = getenv(RECORD_ENV);
+    if (!env || !*env || rec_fp) {
+        return;
+    }
+    rec_fp = fopen(env, "wb");
+    if (!rec_fp) {
+        fprintf(stderr, "record: cannot write '%s'\n", env);
+        return;
+    }
+    memset(rec_buf, 0, RECORD_HEADER_LEN);
+    memcpy(rec_buf, RECORD_MAGIC, sizeof(RECORD_MAGIC));
+    rec_used = RECORD_HEADER_LEN;
+    rec_put_varint(RECORD_VERSION);
+    rec_last_us = time_monotonic_ns() / 1000u;
+}
+
+void record_shutdown(void) {
+    if (!rec_fp) {
+        return;
+    }
+    rec_flush();
+    if (rec_fp && fclose(rec_fp) != 0) {
+        fprintf(stderr, "record: write failed\n");
+    }
+    rec_fp = NULL;
+}
+
+void record_login(const char *account_id, AtmStatus status) {
+    if (account_id && rec_begin(RECORD_LOGIN, status)) {
+        rec_put_str(account_id);
+    }
+}
+
+void record_op(RecordOp op, AtmStatus status) {
+    rec_begin(op, status);
+}
+
+void record_amount(RecordOp op, double amount, AtmStatus status) {
+    if (rec_begin(op, status)) {
+        int64_t c = rec_cents(amount);
+        rec_put_varint(((uint64_t)c << 1) ^ (uint64_t)(c >> 63));
+    }
+}
+
+void record_transfer(const char *to_id, double amount, AtmStatus status) {
+    if (to_id && rec_begin(RECORD_TRANSFER, status)) {
+        int64_t c = rec_cents(amount);
+        rec_put_str(to_id);
+        rec_put_varint(((uint64_t)c << 1) ^ (uint64_t)(c >> 63));
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/* Replay                                                                 */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    uint64_t at_us;   /* since the first record */
+    uint8_t  op;
+    uint8_t  status;
+    int64_t  cents;
+    char     id[MAX_ACCOUNT_ID_LEN]; /* login or transfer target */
+} RecordEvent;
+
+typedef struct {
+    uint64_t *durations;
+    size_t    count;
+    size_t    mismatches;
+    uint64_t  total_ns;
+} RecordStats;
+
+static const char *const record_op_names[RECORD_OP_COUNT] = {
+    "?", "login", "balance", "deposit", "withdraw", "transfer", "logout", "persist"
+};
+
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    int                  ok;
+} RecordReader;
+
+static uint64_t rd_varint(RecordReader *r) {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (r->p == r->end) {
+            break;
+        }
+        unsigned char b = *r->p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            return v;
+        }
+    }
+    r->ok = 0;
+    return 0;
+}
+
+static int rd_byte(RecordReader *r) {
+    if (r->p == r->end) {
+        r->ok = 0;
+        return 0;
+    }
+    return *r->p++;
+}
+
+static void rd_str(RecordReader *r, char *out) {
+    uint64_t len = rd_varint(r);
+    if (!r->ok || len >= MAX_ACCOUNT_ID_LEN || len > (uint64_t)(r->end - r->p)) {
+        r->ok  = 0;
+        out[0] = '\0';
+        return;
+    }
+    memcpy(out, r->p, (size_t)len);
+    out[len] = '\0';
+    r->p += len;
+}
+
+static int64_t rd_cents(RecordReader *r) {
+    uint64_t u = rd_varint(r);
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+/* Reads the whole recording into an event array. */
+static AtmStatus record_load(const char *path, RecordEvent **events, size_t *count) {
+    *events = NULL;
+    *count  = 0;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+    unsigned char *data = NULL;
+    long           size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size + 1);
+    }
+    if (!data || fread(data, 1, (size_t)size, fp) != (size_t)size) {
+        free(data);
+        fclose(fp);
+        return data ? ATM_ERR_IO : ATM_ERR_INTERNAL;
+    }
+    fclose(fp);
+
+    if (size < RECORD_HEADER_LEN || memcmp(data, RECORD_MAGIC, sizeof(RECORD_MAGIC)) != 0) {
+        free(data);
+        return ATM_ERR_PARSE;
+    }
+    RecordReader r = { data + RECORD_HEADER_LEN, data + size, 1 };
+    if (rd_varint(&r) != RECORD_VERSION || !r.ok) {
+        free(data);
+        return ATM_ERR_PARSE;
+    }
+
+    /* Every record takes at least three bytes. */
+    size_t       cap  = (size_t)(r.end - r.p) / 3 + 1;
+    RecordEvent *evs  = malloc(cap * sizeof(RecordEvent));
+    size_t       n    = 0;
+    uint64_t     at   = 0;
+    if (!evs) {
+        free(data);
+        return ATM_ERR_INTERNAL;
+    }
+
+    while (r.ok && r.p < r.end) {
+        RecordEvent *ev = &evs[n];
+        uint64_t delta = rd_varint(&r);
+        at         = n ? at + delta : 0;
+        ev->at_us  = at;
+        ev->op     = (uint8_t)rd_byte(&r);
+        ev->status = (uint8_t)rd_byte(&r);
+        ev->cents  = 0;
+        ev->id[0]  = '\0';
+
+        switch (ev->op) {
+        case RECORD_LOGIN:
+            rd_str(&r, ev->id);
+            break;
+        case RECORD_DEPOSIT:
+        case RECORD_WITHDRAW:
+            ev->cents = rd_cents(&r);
+            break;
+        case RECORD_TRANSFER:
+            rd_str(&r, ev->id);
+            ev->cents = rd_cents(&r);
+            break;
+        case RECORD_BALANCE:
+        case RECORD_LOGOUT:
+        case RECORD_PERSIST:
+            break;
+        default:
+            r.ok = 0;
+            break;
+        }
+        n++;
+    }
+    free(data);
+
+    if (!r.ok) {
+        free(evs);
+        return ATM_ERR_PARSE;
+    }
+    *events = evs;
+    *count  = n;
+    return ATM_OK;
+}
+
+static int record_cmp_id(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int record_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Gives every account that logged in successfully the replay PIN, once.
+ * Returns the number of accounts prepared, or (size_t)-1 on OOM.
+ */
+static size_t record_prepare_pins(AtmContext *ctx, const RecordEvent *evs, size_t n) {
+    const char **ids = malloc((n ? n : 1) * sizeof(*ids));
+    size_t       k   = 0;
+    if (!ids) {
+        return (size_t)-1;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (evs[i].op == RECORD_LOGIN && evs[i].status == ATM_OK) {
+            ids[k++] = evs[i].id;
+        }
+    }
+    qsort(ids, k, sizeof(*ids), record_cmp_id);
+
+    size_t prepared = 0;
+    for (size_t i = 0; i < k; ++i) {
+        if (i > 0 && strcmp(ids[i], ids[i - 1]) == 0) {
+            continue;
+        }
+        Account *acc = account_store_find(&ctx->store, ids[i]);
+        if (acc && auth_replace_pin(acc, RECORD_REPLAY_PIN) == ATM_OK) {
+            prepared++;
+        }
+    }
+    free(ids);
+    return prepared;
+}
+
+/* Runs one operation as the front end did; returns its status. */
+static AtmStatus record_apply(AtmContext *ctx, const RecordEvent *ev, Account **session) {
+    Account *acc = *session;
+    double   amount = (double)ev->cents / 100.0;
+
+    switch (ev->op) {
+    case RECORD_LOGIN: {
+        *session = NULL;
+        acc      = atm_find_account(ctx, ev->id);
+        if (!acc) {
+            return ATM_ERR_NOT_FOUND;
+        }
+        AtmStatus st = auth_verify_login(acc, ev->status == ATM_OK ? RECORD_REPLAY_PIN
+                                                                   : RECORD_BAD_PIN);
+        if (st == ATM_OK) {
+            *session = acc;
+        }
+        return st;
+    }
+    case RECORD_BALANCE: {
+        if (!acc) return ATM_ERR_AUTH_FAILED;
+        volatile double balance = acc->balance;
+        (void)balance;
+        return ATM_OK;
+    }
+    case RECORD_DEPOSIT:
+        return acc ? account_deposit(acc, amount) : ATM_ERR_AUTH_FAILED;
+    case RECORD_WITHDRAW:
+        return acc ? account_withdraw(acc, amount) : ATM_ERR_AUTH_FAILED;
+    case RECORD_TRANSFER:
+        return acc ? account_transfer(&ctx->store, acc->id, ev->id, amount)
+                   : ATM_ERR_AUTH_FAILED;
+    case RECORD_LOGOUT:
+        *session = NULL;
+        return ATM_OK;
+    case RECORD_PERSIST:
+        return atm_persist(ctx);
+    default:
+        return ATM_ERR_INTERNAL;
+    }
+}
+
+static double record_us(uint64_t ns) {
+    return (double)ns / 1000.0;
+}
+
+static void record_print_row(FILE *out, const char *name, RecordStats *rs) {
+    qsort(rs->durations, rs->count, sizeof(uint64_t), record_cmp_u64);
+    fprintf(out, "%-9s %9zu %8zu %10.1f %10.1f %10.1f %10.1f %12.3f\n",
+            name, rs->count, rs->mismatches,
+            record_us(rs->total_ns / rs->count),
+            record_us(rs->durations[rs->count / 2]),
+            record_us(rs->durations[(rs->count * 99) / 100]),
+            record_us(rs->durations[rs->count - 1]),
+            (double)rs->total_ns / 1e6);
+}
+
+AtmStatus record_replay(AtmContext *ctx, const char *path, double speed, FILE *out) {
+    if (!ctx || !path || !out || speed < 0.0) return ATM_ERR_INTERNAL;
+
+    RecordEvent *evs = NULL;
+    size_t       n   = 0;
+    AtmStatus    st  = record_load(path, &evs, &n);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    /* One slab: per-op durations, all durations, late starts. */
+    uint64_t   *slab = malloc((3 * n + 1) * sizeof(uint64_t));
+    RecordStats stats[RECORD_OP_COUNT];
+    RecordStats all  = { NULL, 0, 0, 0 };
+    RecordStats late = { NULL, 0, 0, 0 };
+    memset(stats, 0, sizeof(stats));
+    if (!slab) {
+        free(evs);
+        return ATM_ERR_INTERNAL;
+    }
+
+    size_t counts[RECORD_OP_COUNT] = { 0 };
+    for (size_t i = 0; i < n; ++i) {
+        counts[evs[i].op]++;
+    }
+    uint64_t *next = slab;
+    for (int op = 1; op < RECORD_OP_COUNT; ++op) {
+        stats[op].durations = next;
+        next += counts[op];
+    }
+    all.durations  = next;
+    late.durations = next + n;
+
+    uint64_t prep_start = time_monotonic_ns();
+    size_t   prepared   = record_prepare_pins(ctx, evs, n);
+    uint64_t prep_ns    = time_monotonic_ns() - prep_start;
+    if (prepared == (size_t)-1) {
+        free(slab);
+        free(evs);
+        return ATM_ERR_INTERNAL;
+    }
+
+    Account *session = NULL;
+    uint64_t t0      = time_monotonic_ns();
+    for (size_t i = 0; i < n; ++i) {
+        const RecordEvent *ev    = &evs[i];
+        uint64_t           start = time_monotonic_ns();
+        if (speed > 0.0) {
+            uint64_t due = t0 + (uint64_t)((double)ev->at_us * 1000.0 / speed);
+            time_sleep_until_ns(due);
+            start = time_monotonic_ns();
+            late.durations[late.count++] = start - due;
+        }
+
+        AtmStatus got = record_apply(ctx, ev, &session);
+        uint64_t  dur = time_monotonic_ns() - start;
+
+        RecordStats *rs = &stats[ev->op];
+        rs->durations[rs->count++]   = dur;
+        rs->total_ns                += dur;
+        all.durations[all.count++]   = dur;
+        all.total_ns                += dur;
+        if (got != (AtmStatus)ev->status) {
+            rs->mismatches++;
+            all.mismatches++;
+        }
+    }
+    uint64_t wall_ns = time_monotonic_ns() - t0;
+
+    char pace[32] = "max";
+    if (speed > 0.0) {
+        snprintf(pace, sizeof(pace), "%gx", speed);
+    }
+    fprintf(out, "prepared %zu account(s) with the replay PIN in %.3f s\n",
+            prepared, (double)prep_ns / 1e9);
+    fprintf(out, "replayed %zu operations in %.3f s: %.0f ops/s "
+                 "(recorded span %.3f s, speed %s)\n",
+            n, (double)wall_ns / 1e9, wall_ns ? (double)n * 1e9 / (double)wall_ns : 0.0,
+            n ? (double)evs[n - 1].at_us / 1e6 : 0.0, pace);
+
+    if (n) {
+        fprintf(out, "\n%-9s %9s %8s %10s %10s %10s %10s %12s\n",
+                "op", "count", "mismatch", "avg_us", "p50_us", "p99_us", "max_us", "total_ms");
+        for (int op = 1; op < RECORD_OP_COUNT; ++op) {
+            if (stats[op].count) {
+                record_print_row(out, record_op_names[op], &stats[op]);
+            }
+        }
+        record_print_row(out, "all", &all);
+    }
+    if (late.count) {
+        qsort(late.durations, late.count, sizeof(uint64_t), record_cmp_u64);
+        fprintf(out, "\nstart delay behind schedule: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                record_us(late.durations[late.count / 2]),
+                record_us(late.durations[(late.count * 99) / 100]),
+                record_us(late.durations[late.count - 1]));
+    }
+
+    free(slab);
+    free(evs);
+    return ATM_OK;
+}
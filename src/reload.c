@@ -0,0 +1,368 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      reload.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Change detection and three-way merge for hot reloading the account
+ *   database (see reload.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "reload.h"
+#include "account_codec.h"
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#  include <errno.h>
+#  include <sys/inotify.h>
+#  include <unistd.h>
+#  define RELOAD_HAVE_INOTIFY 1
+#  define RELOAD_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+#endif
+
+static void reload_stat(const char *path, ReloadFileId *id) {
+    struct stat st;
+    memset(id, 0, sizeof(*id));
+    if (stat(path, &st) != 0) {
+        return;
+    }
+    id->dev    = (uint64_t)st.st_dev;
+    id->ino    = (uint64_t)st.st_ino;
+    id->size   = (uint64_t)st.st_size;
+#if defined(_WIN32) || defined(_WIN64)
+    id->mtime_ns = (uint64_t)st.st_mtime * 1000000000ull;
+#else
+    id->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+    id->exists = 1;
+}
+
+static int reload_same_file(const ReloadFileId *a, const ReloadFileId *b) {
+    return a->exists == b->exists && a->dev == b->dev && a->ino == b->ino &&
+           a->size == b->size && a->mtime_ns == b->mtime_ns;
+}
+
+AtmStatus reload_watch_init(ReloadWatch *w, const char *path) {
+    if (!w || !path) return ATM_ERR_INTERNAL;
+
+    memset(w, 0, sizeof(*w));
+    w->fd    = -1;
+    w->check = 1;
+
+    const char *slash = strrchr(path, '/');
+    const char *name  = slash ? slash + 1 : path;
+    if (strlen(name) >= sizeof(w->name)) {
+        return ATM_ERR_IO;
+    }
+    strcpy(w->name, name);
+
+#ifdef RELOAD_HAVE_INOTIFY
+    char dir[MAX_DB_PATH_LEN];
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        size_t len = (size_t)(slash - path);
+        memcpy(dir, path, len);
+        dir[len] = '\0';
+    }
+
+    /* The directory is watched: saves replace the file by rename. */
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd >= 0 && inotify_add_watch(w->fd, dir, RELOAD_EVENTS) < 0) {
+        close(w->fd);
+        w->fd = -1;
+    }
+#endif
+    return ATM_OK;
+}
+
+void reload_watch_free(ReloadWatch *w) {
+    if (!w) return;
+#ifdef RELOAD_HAVE_INOTIFY
+    if (w->fd >= 0) {
+        close(w->fd);
+    }
+#endif
+    w->fd = -1;
+    free(w->base);
+    free(w->next);
+    w->base     = NULL;
+    w->base_len = 0;
+    w->next     = NULL;
+    w->next_cap = 0;
+}
+
+typedef struct {
+    const Account *items;
+    uint32_t      *crcs;
+} ReloadCrcJob;
+
+static void reload_crc_range(void *arg, size_t begin, size_t end) {
+    ReloadCrcJob *job = arg;
+    for (size_t i = begin; i < end; ++i) {
+        job->crcs[i] = account_record_crc(&job->items[i]);
+    }
+}
+
+AtmStatus reload_snapshot(ReloadWatch *w, const char *path, const AccountStore *store) {
+    if (!w || !path || !store) return ATM_ERR_INTERNAL;
+
+    if (store->size > w->base_cap || !w->base) {
+        uint32_t *grown = realloc(w->base, (store->size ? store->size : 1) * sizeof(uint32_t));
+        if (!grown) {
+            return ATM_ERR_INTERNAL;
+        }
+        w->base     = grown;
+        w->base_cap = store->size;
+    }
+    w->base_len = store->size;
+
+    ReloadCrcJob job = { store->items, w->base };
+    parallel_for(store->size, 0, reload_crc_range, &job);
+
+    reload_stat(path, &w->file);
+    w->check = 0;
+    return ATM_OK;
+}
+
+uint32_t *reload_save_buffer(ReloadWatch *w, size_t count) {
+    if (!w) return NULL;
+    if (count > w->next_cap || !w->next) {
+        uint32_t *grown = realloc(w->next, (count ? count : 1) * sizeof(uint32_t));
+        if (!grown) {
+            return NULL;
+        }
+        w->next     = grown;
+        w->next_cap = count;
+    }
+    return w->next;
+}
+
+void reload_save_done(ReloadWatch *w, const char *path, size_t count) {
+    if (!w || !path || !w->next) return;
+
+    /* Swap buffers: the old base becomes scratch space for the next save. */
+    uint32_t *old_base = w->base;
+    size_t    old_cap  = w->base_cap;
+
+    w->base     = w->next;
+    w->base_cap = w->next_cap;
+    w->base_len = count;
+    w->next     = old_base;
+    w->next_cap = old_cap;
+
+    reload_stat(path, &w->file);
+    w->check = 0;
+}
+
+int reload_pending(ReloadWatch *w, const char *path, ReloadFileId *current) {
+    if (!w || !path) return 0;
+
+#ifdef RELOAD_HAVE_INOTIFY
+    if (w->fd >= 0) {
+        _Alignas(struct inotify_event) char buf[4096];
+        for (;;) {
+            ssize_t n = read(w->fd, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            for (char *p = buf; p < buf + n;) {
+                const struct inotify_event *ev = (const struct inotify_event *)p;
+                if ((ev->mask & IN_Q_OVERFLOW) ||
+                    (ev->len && strcmp(ev->name, w->name) == 0)) {
+                    w->check = 1;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    } else {
+        w->check = 1;
+    }
+#else
+    w->check = 1;
+#endif
+
+    if (!w->check) {
+        return 0;
+    }
+
+    /* Our own saves raise events too; they leave the snapshot current. */
+    ReloadFileId now;
+    reload_stat(path, &now);
+    if (!now.exists || reload_same_file(&now, &w->file)) {
+        w->check = 0;
+        return 0;
+    }
+    if (current) {
+        *current = now;
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Three-way merge                                                        */
+/* ---------------------------------------------------------------------- */
+
+#define RELOAD_SEEN   1
+#define RELOAD_REMOVE 2
+
+static uint64_t reload_hash_id(const char *id) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)id; *p; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+AtmStatus reload_apply(ReloadWatch *w, AccountStore *store, const AccountStore *incoming,
+                       const ReloadFileId *file, ReloadReport *report) {
+    if (!w || !store || !incoming || !file || !report) return ATM_ERR_INTERNAL;
+
+    memset(report, 0, sizeof(*report));
+
+    size_t n    = store->size;
+    size_t mask = 15;
+    while (mask + 1 < 2 * n) {
+        mask = mask * 2 + 1;
+    }
+
+    /* Open-addressed index of the in-memory IDs (slot = item index + 1). */
+    size_t        *slots = calloc(mask + 1, sizeof(size_t));
+    unsigned char *state = calloc(n ? n : 1, 1);
+    size_t        *added = malloc((incoming->size ? incoming->size : 1) * sizeof(size_t));
+    if (!slots || !state || !added) {
+        free(slots);
+        free(state);
+        free(added);
+        return ATM_ERR_INTERNAL;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        size_t h = (size_t)reload_hash_id(store->items[i].id) & mask;
+        while (slots[h]) h = (h + 1) & mask;
+        slots[h] = i + 1;
+    }
+
+    /* Records past base_len were created locally since the last snapshot. */
+    size_t nadded = 0;
+    for (size_t j = 0; j < incoming->size; ++j) {
+        const Account *disk = &incoming->items[j];
+        size_t         h    = (size_t)reload_hash_id(disk->id) & mask;
+        size_t         i    = 0;
+        while (slots[h]) {
+            if (strcmp(store->items[slots[h] - 1].id, disk->id) == 0) {
+                i = slots[h];
+                break;
+            }
+            h = (h + 1) & mask;
+        }
+        if (!i) {
+            added[nadded++] = j;
+            continue;
+        }
+        i -= 1;
+        state[i] = RELOAD_SEEN;
+
+        /* The common case. (If both sides made the same change, the base
+         * stays stale until the next save; that only costs a spurious
+         * conflict should the record then change on disk again.) */
+        if (account_equal(disk, &store->items[i])) {
+            continue;
+        }
+
+        uint32_t disk_crc  = account_record_crc(disk);
+        uint32_t local_crc = account_record_crc(&store->items[i]);
+        int      has_base  = i < w->base_len;
+
+        if (disk_crc == local_crc || (has_base && disk_crc == w->base[i])) {
+            /* Unchanged on disk, or both sides agree. */
+        } else if (has_base && local_crc == w->base[i]) {
+            store->items[i] = *disk;
+            report->updated++;
+        } else {
+            if (report->conflicts++ == 0) {
+                strcpy(report->first_conflict, disk->id);
+            }
+        }
+        if (has_base) {
+            w->base[i] = disk_crc;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (state[i] || i >= w->base_len) {
+            continue;
+        }
+        if (account_record_crc(&store->items[i]) == w->base[i]) {
+            state[i] = RELOAD_REMOVE;
+            report->removed++;
+        } else if (report->conflicts++ == 0) {
+            strcpy(report->first_conflict, store->items[i].id);
+        }
+    }
+
+    if (report->removed) {
+        size_t k = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (state[i] == RELOAD_REMOVE) {
+                continue;
+            }
+            store->items[k] = store->items[i];
+            if (i < w->base_len) {
+                w->base[k] = w->base[i];
+            }
+            k++;
+        }
+        store->size = k;
+        w->base_len -= report->removed; /* only based records are removed */
+    }
+
+    AtmStatus st = ATM_OK;
+    for (size_t a = 0; a < nadded && st == ATM_OK; ++a) {
+        st = account_store_append(store, &incoming->items[added[a]]);
+        if (st == ATM_OK) {
+            report->added++;
+        }
+    }
+
+    /* Extend the base over the appended records (they match the disk). */
+    if (st == ATM_OK && w->base_len == store->size - report->added) {
+        uint32_t *grown = w->base;
+        if (store->size > w->base_cap) {
+            grown = realloc(w->base, store->size * sizeof(uint32_t));
+        }
+        if (grown) {
+            w->base     = grown;
+            w->base_cap = w->base_cap > store->size ? w->base_cap : store->size;
+            for (size_t i = w->base_len; i < store->size; ++i) {
+                w->base[i] = account_record_crc(&store->items[i]);
+            }
+            w->base_len = store->size;
+        }
+    }
+
+    free(slots);
+    free(state);
+    free(added);
+
+    w->file  = *file;
+    w->check = 0;
+
+    if (st != ATM_OK) {
+        return st;
+    }
+    return report->conflicts ? ATM_ERR_CONFLICT : ATM_OK;
+}
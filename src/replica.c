@@ -0,0 +1,696 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      replica.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Primary and standby ends of log-shipping replication (see replica.h).
+ *   Windows builds compile the stubs at the end: replication needs POSIX
+ *   sockets.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "replica.h"
+#include "account_codec.h"
+#include "timeutil.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* ---------------------------------------------------------------------- */
+/* Sockets                                                                */
+/* ---------------------------------------------------------------------- */
+
+#define REPLICA_UNIX_PREFIX "unix:"
+
+/*
+ * Creates a socket for `addr` and connects it (listening == 0) or binds
+ * and listens on it. Returns the descriptor or -1.
+ */
+static int replica_socket(const char *addr, int listening) {
+    if (strncmp(addr, REPLICA_UNIX_PREFIX, sizeof(REPLICA_UNIX_PREFIX) - 1) == 0) {
+        const char        *path = addr + sizeof(REPLICA_UNIX_PREFIX) - 1;
+        struct sockaddr_un sun;
+        if (strlen(path) >= sizeof(sun.sun_path)) {
+            return -1;
+        }
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, path);
+
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int ok;
+        if (listening) {
+            unlink(path); /* stale socket from a previous run */
+            ok = bind(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0 && listen(fd, 1) == 0;
+        } else {
+            ok = connect(fd, (struct sockaddr *)&sun, sizeof(sun)) == 0;
+        }
+        if (!ok) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /*
+     * <host>:<port>. An empty host is the loopback interface; only "*"
+     * listens on every interface (peers are not authenticated).
+     */
+    const char *colon = strrchr(addr, ':');
+    if (!colon || colon[1] == '\0') {
+        return -1;
+    }
+    char host[256];
+    size_t host_len = (size_t)(colon - addr);
+    if (host_len >= sizeof(host)) {
+        return -1;
+    }
+    memcpy(host, addr, host_len);
+    host[host_len] = '\0';
+
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int any           = strcmp(host, "*") == 0;
+    hints.ai_flags    = (listening && any) ? AI_PASSIVE : 0;
+
+    const char *node = (host_len == 0 || any) ? NULL : host;
+    if (getaddrinfo(node, colon + 1, &hints, &res) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        int ok;
+        if (listening) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            ok = bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 1) == 0;
+        } else {
+            ok = connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+            /* Commits are small and latency-sensitive. */
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+static int replica_send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return 0;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Primary                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    Replica *r;
+    char     buf[REPLICA_BUF_LEN];
+    size_t   used;
+    int      ok;
+} ReplicaWriter;
+
+static void replica_flush(ReplicaWriter *w) {
+    if (w->ok && w->used > 0) {
+        w->ok = replica_send_all(w->r->fd, w->buf, w->used);
+        w->r->stats.bytes += w->used;
+    }
+    w->used = 0;
+}
+
+static void replica_put_record(ReplicaWriter *w, const Account *acc) {
+    if (sizeof(w->buf) - w->used < ACCOUNT_CSV_RECORD_MAX + 8) {
+        replica_flush(w);
+    }
+    memcpy(w->buf + w->used, "REC ", 4);
+    w->used += 4;
+    w->used += account_format_csv(acc, w->buf + w->used, NULL);
+    w->r->stats.records++;
+}
+
+static void replica_put_line(ReplicaWriter *w, const char *tag, uint64_t value) {
+    if (sizeof(w->buf) - w->used < 64) {
+        replica_flush(w);
+    }
+    w->used += (size_t)snprintf(w->buf + w->used, 64, "%s %llu\n", tag, (unsigned long long)value);
+}
+
+void replica_init(Replica *r) {
+    if (!r) return;
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+void replica_close(Replica *r) {
+    if (!r) return;
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    r->fd = -1;
+    free(r->shipped);
+    r->shipped     = NULL;
+    r->shipped_len = 0;
+    r->shipped_cap = 0;
+}
+
+static void replica_disconnect(Replica *r) {
+    if (r->fd >= 0) {
+        close(r->fd);
+        r->fd = -1;
+    }
+    r->retry_ms = time_monotonic_ms() + REPLICA_RETRY_MS;
+    fprintf(stderr, "replica: standby lost after commit %llu (acked %llu)\n",
+            (unsigned long long)r->seq, (unsigned long long)r->acked);
+}
+
+/*
+ * Reconnects to a lost standby, at most once per REPLICA_RETRY_MS. The
+ * next commit is then a full snapshot: commits shipped in between were
+ * never applied there. Returns 1 when connected.
+ */
+static int replica_reconnect(Replica *r) {
+    uint64_t now = time_monotonic_ms();
+    if (now < r->retry_ms) {
+        return 0;
+    }
+    r->fd = replica_socket(r->addr, 0);
+    if (r->fd < 0) {
+        r->retry_ms = now + REPLICA_RETRY_MS;
+        return 0;
+    }
+    r->resync = 1;
+    r->acked  = r->seq;
+    r->in_len = 0;
+    fprintf(stderr, "replica: standby reconnected after commit %llu, resending all records\n",
+            (unsigned long long)r->seq);
+    return 1;
+}
+
+/* Reads whatever ACKs are available, waiting up to timeout_ms (-1: no wait). */
+static int replica_read_acks(Replica *r, int timeout_ms) {
+    struct pollfd pfd = { r->fd, POLLIN, 0 };
+    int           rc  = poll(&pfd, 1, timeout_ms < 0 ? 0 : timeout_ms);
+    if (rc < 0) {
+        return errno == EINTR;
+    }
+    if (rc == 0) {
+        return 1;
+    }
+
+    char    buf[4096];
+    ssize_t n = recv(r->fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    uint64_t now = time_monotonic_ns();
+    for (ssize_t i = 0; i < n; ++i) {
+        char c = buf[i];
+        if (c != '\n') {
+            if (r->in_len < sizeof(r->in) - 1) {
+                r->in[r->in_len++] = c;
+            }
+            continue;
+        }
+        r->in[r->in_len] = '\0';
+        r->in_len        = 0;
+
+        unsigned long long seq = 0;
+        if (sscanf(r->in, "ACK %llu", &seq) != 1 || seq <= r->acked || seq > r->seq) {
+            continue;
+        }
+        r->acked = seq;
+        if (r->seq - seq < REPLICA_LAG_WINDOW) {
+            uint64_t lag = now - r->sent_ns[seq & (REPLICA_LAG_WINDOW - 1)];
+            r->stats.acks++;
+            r->stats.ack_total_ns += lag;
+            if (lag > r->stats.ack_max_ns) r->stats.ack_max_ns = lag;
+        }
+    }
+    return 1;
+}
+
+static int replica_reserve(Replica *r, size_t count) {
+    if (count <= r->shipped_cap) {
+        return 1;
+    }
+    size_t    cap   = r->shipped_cap ? r->shipped_cap : 1024;
+    while (cap < count) cap *= 2;
+    uint32_t *grown = realloc(r->shipped, cap * sizeof(uint32_t));
+    if (!grown) {
+        return 0;
+    }
+    r->shipped     = grown;
+    r->shipped_cap = cap;
+    return 1;
+}
+
+AtmStatus replica_ship(Replica *r, const AccountStore *store, const uint32_t *crcs) {
+    if (!r || !store) return ATM_ERR_INTERNAL;
+    if (!r->addr[0]) return ATM_OK;
+    if (r->fd < 0 && !replica_reconnect(r)) {
+        return ATM_ERR_IO;
+    }
+
+    if (!replica_reserve(r, store->size)) {
+        return ATM_ERR_INTERNAL;
+    }
+
+    static ReplicaWriter w;
+    w.r    = r;
+    w.used = 0;
+    w.ok   = 1;
+
+    /* A shrunken store means records were removed: resend everything. */
+    int    snapshot = r->resync || store->size < r->shipped_len;
+    size_t changed  = 0;
+
+    if (snapshot) {
+        replica_put_line(&w, "SNAP", store->size);
+    }
+    for (size_t i = 0; i < store->size; ++i) {
+        uint32_t crc = crcs ? crcs[i] : account_record_crc(&store->items[i]);
+        if (snapshot || i >= r->shipped_len || r->shipped[i] != crc) {
+            replica_put_record(&w, &store->items[i]);
+            changed++;
+        }
+        r->shipped[i] = crc;
+    }
+    r->shipped_len = store->size;
+    r->resync      = 0;
+
+    if (!snapshot && changed == 0) {
+        return ATM_OK; /* nothing to replicate */
+    }
+
+    r->seq++;
+    replica_put_line(&w, "COMMIT", r->seq);
+    r->sent_ns[r->seq & (REPLICA_LAG_WINDOW - 1)] = time_monotonic_ns();
+    replica_flush(&w);
+
+    r->stats.commits++;
+    r->stats.snapshots += (uint64_t)snapshot;
+    r->stats.last_ns    = r->sent_ns[r->seq & (REPLICA_LAG_WINDOW - 1)];
+    if (!r->stats.first_ns) r->stats.first_ns = r->stats.last_ns;
+
+    if (!w.ok) {
+        replica_disconnect(r);
+        return ATM_ERR_IO;
+    }
+
+    if (!r->sync) {
+        if (!replica_read_acks(r, -1)) {
+            replica_disconnect(r);
+            return ATM_ERR_IO;
+        }
+        return ATM_OK;
+    }
+    return replica_wait(r, REPLICA_SYNC_TIMEOUT_MS);
+}
+
+AtmStatus replica_wait(Replica *r, int timeout_ms) {
+    if (!r) return ATM_ERR_INTERNAL;
+    if (r->fd < 0) return ATM_OK;
+
+    uint64_t deadline = time_monotonic_ms() + (uint64_t)timeout_ms;
+    while (r->acked < r->seq) {
+        uint64_t now = time_monotonic_ms();
+        if (now >= deadline || !replica_read_acks(r, (int)(deadline - now))) {
+            replica_disconnect(r);
+            return ATM_ERR_IO;
+        }
+    }
+    return ATM_OK;
+}
+
+AtmStatus replica_connect(Replica *r, const char *addr, int sync, const AccountStore *store) {
+    if (!r || !addr || !store) return ATM_ERR_INTERNAL;
+    if (strlen(addr) >= sizeof(r->addr)) return ATM_ERR_PARSE;
+
+    r->fd = replica_socket(addr, 0);
+    if (r->fd < 0) {
+        return ATM_ERR_IO;
+    }
+    strcpy(r->addr, addr);
+    r->sync   = sync;
+    r->resync = 1;
+    return replica_ship(r, store, NULL);
+}
+
+void replica_mark_resync(Replica *r) {
+    if (r) r->resync = 1;
+}
+
+void replica_print_stats(const Replica *r, FILE *out) {
+    if (!r || !out) return;
+
+    const ReplicaStats *s    = &r->stats;
+    double              span = (double)(s->last_ns - s->first_ns) / 1e9;
+    fprintf(out,
+            "replication (%s): %llu commits (%llu snapshots), %llu records, %llu bytes, "
+            "acked %llu/%llu",
+            r->sync ? "sync" : "async",
+            (unsigned long long)s->commits, (unsigned long long)s->snapshots,
+            (unsigned long long)s->records, (unsigned long long)s->bytes,
+            (unsigned long long)r->acked, (unsigned long long)r->seq);
+    if (s->acks) {
+        /* Async mode reads ACKs only at the next commit: an upper bound. */
+        fprintf(out, ", ack latency%s avg %.1f us max %.1f us", r->sync ? "" : " (upper bound)",
+                (double)s->ack_total_ns / (double)s->acks / 1e3, (double)s->ack_max_ns / 1e3);
+    }
+    if (span > 0) {
+        fprintf(out, ", %.0f records/s", (double)s->records / span);
+    }
+    fputc('\n', out);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Standby                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    AccountStore *store;
+    size_t       *slots;   /* open-addressed ID index: item index + 1 */
+    size_t        mask;
+    AccountStore  pending; /* records of the commit being received */
+    int           snapshot;
+    uint64_t      applied; /* last commit applied */
+} Standby;
+
+static uint64_t replica_hash_id(const char *id) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)id; *p; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static int standby_reindex(Standby *sb) {
+    size_t mask = 1023;
+    while (mask + 1 < 2 * sb->store->size + 2) mask = mask * 2 + 1;
+
+    size_t *slots = calloc(mask + 1, sizeof(size_t));
+    if (!slots) {
+        return 0;
+    }
+    free(sb->slots);
+    sb->slots = slots;
+    sb->mask  = mask;
+
+    for (size_t i = 0; i < sb->store->size; ++i) {
+        size_t h = (size_t)replica_hash_id(sb->store->items[i].id) & mask;
+        while (slots[h]) h = (h + 1) & mask;
+        slots[h] = i + 1;
+    }
+    return 1;
+}
+
+static AtmStatus standby_upsert(Standby *sb, const Account *acc) {
+    size_t h = (size_t)replica_hash_id(acc->id) & sb->mask;
+    while (sb->slots[h]) {
+        Account *cur = &sb->store->items[sb->slots[h] - 1];
+        if (strcmp(cur->id, acc->id) == 0) {
+            *cur = *acc;
+            return ATM_OK;
+        }
+        h = (h + 1) & sb->mask;
+    }
+
+    AtmStatus st = account_store_append(sb->store, acc);
+    if (st != ATM_OK) {
+        return st;
+    }
+    sb->slots[h] = sb->store->size;
+    if (2 * sb->store->size + 2 > sb->mask + 1 && !standby_reindex(sb)) {
+        return ATM_ERR_INTERNAL;
+    }
+    return ATM_OK;
+}
+
+static AtmStatus standby_commit(Standby *sb) {
+    AtmStatus st = ATM_OK;
+    if (sb->snapshot) {
+        /* Swap in the snapshot wholesale. */
+        AccountStore old = *sb->store;
+        *sb->store       = sb->pending;
+        sb->pending      = old;
+        sb->snapshot     = 0;
+        if (!standby_reindex(sb)) {
+            st = ATM_ERR_INTERNAL;
+        }
+    } else {
+        for (size_t i = 0; i < sb->pending.size && st == ATM_OK; ++i) {
+            st = standby_upsert(sb, &sb->pending.items[i]);
+        }
+    }
+    sb->pending.size = 0;
+    return st;
+}
+
+/* Handles one line from the primary; returns 0 to drop the connection. */
+static int standby_line(Standby *sb, int fd, char *line) {
+    if (strncmp(line, "REC ", 4) == 0) {
+        Account acc;
+        memset(&acc, 0, sizeof(acc));
+        return account_parse_csv(line + 4, &acc, NULL) == ATM_OK &&
+               account_store_append(&sb->pending, &acc) == ATM_OK;
+    }
+
+    unsigned long long value = 0;
+    if (sscanf(line, "SNAP %llu", &value) == 1) {
+        sb->pending.size = 0;
+        sb->snapshot     = 1;
+        return 1;
+    }
+    if (sscanf(line, "COMMIT %llu", &value) == 1) {
+        if (standby_commit(sb) != ATM_OK) {
+            return 0;
+        }
+        sb->applied = value;
+
+        char ack[32];
+        int  n = snprintf(ack, sizeof(ack), "ACK %llu\n", value);
+        return replica_send_all(fd, ack, (size_t)n);
+    }
+    return 0;
+}
+
+/* Reads one stdin line byte by byte, so nothing past it is consumed. */
+static int standby_read_command(char *buf, size_t cap) {
+    size_t len = 0;
+    for (;;) {
+        char    c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            buf[len] = '\0';
+            return len > 0;
+        }
+        if (c == '\n') {
+            if (len > 0 && buf[len - 1] == '\r') len--;
+            buf[len] = '\0';
+            return 1;
+        }
+        if (len < cap - 1) {
+            buf[len++] = c;
+        }
+    }
+}
+
+AtmStatus replica_standby_run(AccountStore *store, const char *addr, int *promoted) {
+    if (!store || !addr || !promoted) return ATM_ERR_INTERNAL;
+    *promoted = 0;
+
+    int listen_fd = replica_socket(addr, 1);
+    if (listen_fd < 0) {
+        return ATM_ERR_IO;
+    }
+
+    static char buf[REPLICA_BUF_LEN + ACCOUNT_CSV_RECORD_MAX];
+    size_t      used = 0;
+    int         conn = -1;
+
+    Standby sb;
+    memset(&sb, 0, sizeof(sb));
+    sb.store = store;
+    if (account_store_init(&sb.pending) != ATM_OK || !standby_reindex(&sb)) {
+        close(listen_fd);
+        return ATM_ERR_INTERNAL;
+    }
+
+    fprintf(stderr, "standby: listening on %s\n", addr);
+
+    AtmStatus st = ATM_OK;
+    for (;;) {
+        struct pollfd pfd[2] = {
+            { STDIN_FILENO, POLLIN, 0 },
+            { conn >= 0 ? conn : listen_fd, POLLIN, 0 },
+        };
+        if (poll(pfd, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            st = ATM_ERR_IO;
+            break;
+        }
+
+        if (pfd[0].revents) {
+            char cmd[64];
+            if (!standby_read_command(cmd, sizeof(cmd))) {
+                break; /* end of stdin: shut down */
+            }
+            if (strcmp(cmd, "PROMOTE") == 0) {
+                *promoted = 1;
+                break;
+            }
+            /* Written unbuffered: stdout may become the protocol's stream. */
+            char reply[64];
+            int  len = strcmp(cmd, "STATUS") == 0
+                     ? snprintf(reply, sizeof(reply), "0 OK %llu %zu\n",
+                                (unsigned long long)sb.applied, store->size)
+                     : snprintf(reply, sizeof(reply), "%d ERR_PARSE\n", (int)ATM_ERR_PARSE);
+            if (write(STDOUT_FILENO, reply, (size_t)len) < 0) {
+                st = ATM_ERR_IO;
+                break;
+            }
+        }
+
+        if (!pfd[1].revents) {
+            continue;
+        }
+
+        if (conn < 0) {
+            conn = accept(listen_fd, NULL, NULL);
+            if (conn >= 0) {
+                fprintf(stderr, "standby: primary connected\n");
+                used = 0;
+            }
+            continue;
+        }
+
+        ssize_t n = recv(conn, buf + used, sizeof(buf) - 1 - used, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        int keep = n > 0;
+        if (keep) {
+            used += (size_t)n;
+            char *start = buf;
+            char *nl;
+            while (keep && (nl = memchr(start, '\n', used - (size_t)(start - buf))) != NULL) {
+                *nl   = '\0';
+                keep  = standby_line(&sb, conn, start);
+                start = nl + 1;
+            }
+            used -= (size_t)(start - buf);
+            memmove(buf, start, used);
+            if (used >= sizeof(buf) - 1) {
+                keep = 0; /* overlong line */
+            }
+        }
+        if (!keep) {
+            /* An unfinished commit is discarded: the primary never got its ACK. */
+            fprintf(stderr, "standby: primary disconnected at commit %llu\n",
+                    (unsigned long long)sb.applied);
+            close(conn);
+            conn            = -1;
+            sb.pending.size = 0;
+            sb.snapshot     = 0;
+        }
+    }
+
+    if (conn >= 0) close(conn);
+    close(listen_fd);
+    if (strncmp(addr, REPLICA_UNIX_PREFIX, sizeof(REPLICA_UNIX_PREFIX) - 1) == 0) {
+        unlink(addr + sizeof(REPLICA_UNIX_PREFIX) - 1);
+    }
+    account_store_free(&sb.pending);
+    free(sb.slots);
+    return st;
+}
+
+#else /* Windows: no replication */
+
+void replica_init(Replica *r) {
+    if (!r) return;
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+void replica_close(Replica *r) {
+    (void)r;
+}
+
+AtmStatus replica_connect(Replica *r, const char *addr, int sync, const AccountStore *store) {
+    (void)r; (void)addr; (void)sync; (void)store;
+    return ATM_ERR_IO;
+}
+
+AtmStatus replica_ship(Replica *r, const AccountStore *store, const uint32_t *crcs) {
+    (void)r; (void)store; (void)crcs;
+    return ATM_OK;
+}
+
+AtmStatus replica_wait(Replica *r, int timeout_ms) {
+    (void)r; (void)timeout_ms;
+    return ATM_OK;
+}
+
+void replica_mark_resync(Replica *r) {
+    (void)r;
+}
+
+void replica_print_stats(const Replica *r, FILE *out) {
+    (void)r; (void)out;
+}
+
+AtmStatus replica_standby_run(AccountStore *store, const char *addr, int *promoted) {
+    (void)store; (void)addr;
+    if (promoted) *promoted = 0;
+    return ATM_ERR_IO;
+}
+
+#endif
@@ -0,0 +1,291 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      sha256.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   SHA-256 (FIPS 180-4) and PBKDF2-HMAC-SHA256 (RFC 8018).
+ *   The PBKDF2 inner loop works on pre-padded 32-byte messages, so each
+ *   iteration is exactly two compression calls from precomputed HMAC
+ *   inner/outer states.
+ */
+
+#include "sha256.h"
+
+#include <string.h>
+
+static const uint32_t SHA256_K[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u,
+    0xd807aa98u, 0x12835b01u, 0x243185beu, 0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u,
+    0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau, 0x5cb0a9dcu, 0x76f988dau,
+    0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u,
+    0x27b70a85u, 0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u,
+    0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u, 0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u,
+    0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu, 0x682e6ff3u,
+    0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u
+};
+
+static const uint32_t SHA256_IV[8] = {
+    0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au,
+    0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define BSIG0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define BSIG1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SSIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SSIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8)  | (uint32_t)p[3];
+}
+
+static void store_be32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static void sha256_compress_words(uint32_t state[8], const uint32_t block[16]) {
+    uint32_t w[64];
+    memcpy(w, block, 16 * sizeof(uint32_t));
+    for (int t = 16; t < 64; ++t) {
+        w[t] = SSIG1(w[t - 2]) + w[t - 7] + SSIG0(w[t - 15]) + w[t - 16];
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int t = 0; t < 64; ++t) {
+        uint32_t t1 = h + BSIG1(e) + CH(e, f, g) + SHA256_K[t] + w[t];
+        uint32_t t2 = BSIG0(a) + MAJ(a, b, c);
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+/* Same as sha256_compress_words, for SHA256_LANES independent states. */
+static void sha256_compress_words_x4(uint32_t state[8][SHA256_LANES],
+                                     const uint32_t block[16][SHA256_LANES]) {
+    uint32_t w[64][SHA256_LANES];
+    memcpy(w, block, sizeof(uint32_t) * 16 * SHA256_LANES);
+    for (int t = 16; t < 64; ++t) {
+        for (int l = 0; l < SHA256_LANES; ++l) {
+            w[t][l] = SSIG1(w[t - 2][l]) + w[t - 7][l] + SSIG0(w[t - 15][l]) + w[t - 16][l];
+        }
+    }
+
+    uint32_t v[8][SHA256_LANES];
+    memcpy(v, state, sizeof(v));
+
+    for (int t = 0; t < 64; ++t) {
+        for (int l = 0; l < SHA256_LANES; ++l) {
+            uint32_t t1 = v[7][l] + BSIG1(v[4][l]) + CH(v[4][l], v[5][l], v[6][l]) +
+                          SHA256_K[t] + w[t][l];
+            uint32_t t2 = BSIG0(v[0][l]) + MAJ(v[0][l], v[1][l], v[2][l]);
+            v[7][l] = v[6][l]; v[6][l] = v[5][l]; v[5][l] = v[4][l]; v[4][l] = v[3][l] + t1;
+            v[3][l] = v[2][l]; v[2][l] = v[1][l]; v[1][l] = v[0][l]; v[0][l] = t1 + t2;
+        }
+    }
+
+    for (int i = 0; i < 8; ++i) {
+        for (int l = 0; l < SHA256_LANES; ++l) {
+            state[i][l] += v[i][l];
+        }
+    }
+}
+
+static void sha256_compress(uint32_t state[8], const uint8_t block[SHA256_BLOCK_LEN]) {
+    uint32_t w[16];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = load_be32(block + 4 * i);
+    }
+    sha256_compress_words(state, w);
+}
+
+void sha256_init(Sha256 *ctx) {
+    memcpy(ctx->state, SHA256_IV, sizeof(SHA256_IV));
+    ctx->length = 0;
+    ctx->used   = 0;
+}
+
+void sha256_update(Sha256 *ctx, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    ctx->length += len;
+
+    while (len > 0) {
+        size_t take = SHA256_BLOCK_LEN - ctx->used;
+        if (take > len) take = len;
+        memcpy(ctx->buffer + ctx->used, p, take);
+        ctx->used += take;
+        p         += take;
+        len       -= take;
+
+        if (ctx->used == SHA256_BLOCK_LEN) {
+            sha256_compress(ctx->state, ctx->buffer);
+            ctx->used = 0;
+        }
+    }
+}
+
+void sha256_final(Sha256 *ctx, uint8_t out[SHA256_DIGEST_LEN]) {
+    uint64_t bits = ctx->length * 8;
+
+    ctx->buffer[ctx->used++] = 0x80;
+    if (ctx->used > SHA256_BLOCK_LEN - 8) {
+        memset(ctx->buffer + ctx->used, 0, SHA256_BLOCK_LEN - ctx->used);
+        sha256_compress(ctx->state, ctx->buffer);
+        ctx->used = 0;
+    }
+    memset(ctx->buffer + ctx->used, 0, SHA256_BLOCK_LEN - 8 - ctx->used);
+    store_be32(ctx->buffer + 56, (uint32_t)(bits >> 32));
+    store_be32(ctx->buffer + 60, (uint32_t)bits);
+    sha256_compress(ctx->state, ctx->buffer);
+
+    for (int i = 0; i < 8; ++i) {
+        store_be32(out + 4 * i, ctx->state[i]);
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/* PBKDF2-HMAC-SHA256                                                     */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    uint32_t inner[8]; /* state after absorbing key ^ ipad */
+    uint32_t outer[8]; /* state after absorbing key ^ opad */
+} HmacKey;
+
+static void hmac_key_setup(HmacKey *hk, const void *key, size_t key_len) {
+    uint8_t k[SHA256_BLOCK_LEN];
+    memset(k, 0, sizeof(k));
+
+    if (key_len > SHA256_BLOCK_LEN) {
+        Sha256 ctx;
+        sha256_init(&ctx);
+        sha256_update(&ctx, key, key_len);
+        sha256_final(&ctx, k);
+    } else if (key_len > 0) {
+        memcpy(k, key, key_len);
+    }
+
+    uint8_t pad[SHA256_BLOCK_LEN];
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x36;
+    memcpy(hk->inner, SHA256_IV, sizeof(SHA256_IV));
+    sha256_compress(hk->inner, pad);
+
+    for (int i = 0; i < SHA256_BLOCK_LEN; ++i) pad[i] = k[i] ^ 0x5c;
+    memcpy(hk->outer, SHA256_IV, sizeof(SHA256_IV));
+    sha256_compress(hk->outer, pad);
+}
+
+/* Block for a 32-byte message following one already-absorbed key block. */
+static void hmac_digest_block(uint32_t block[16], const uint32_t digest[8]) {
+    memcpy(block, digest, 8 * sizeof(uint32_t));
+    block[8] = 0x80000000u;
+    for (int i = 9; i < 15; ++i) block[i] = 0;
+    block[15] = (SHA256_BLOCK_LEN + SHA256_DIGEST_LEN) * 8;
+}
+
+/* U1 = HMAC(P, salt || INT(1)), as words. */
+static void pbkdf2_first(const HmacKey *hk, const uint8_t *salt, size_t salt_len,
+                         uint32_t u[8]) {
+    static const uint8_t block_index[4] = { 0, 0, 0, 1 };
+    uint8_t digest[SHA256_DIGEST_LEN];
+
+    Sha256 ctx;
+    memcpy(ctx.state, hk->inner, sizeof(ctx.state));
+    ctx.length = SHA256_BLOCK_LEN;
+    ctx.used   = 0;
+    sha256_update(&ctx, salt, salt_len);
+    sha256_update(&ctx, block_index, sizeof(block_index));
+    sha256_final(&ctx, digest);
+
+    uint32_t block[16];
+    for (int i = 0; i < 8; ++i) u[i] = load_be32(digest + 4 * i);
+    hmac_digest_block(block, u);
+    memcpy(u, hk->outer, 8 * sizeof(uint32_t));
+    sha256_compress_words(u, block);
+}
+
+void pbkdf2_sha256(const void *password, size_t password_len,
+                   const uint8_t *salt, size_t salt_len,
+                   uint32_t iterations, uint8_t out[SHA256_DIGEST_LEN]) {
+    HmacKey hk;
+    hmac_key_setup(&hk, password, password_len);
+
+    uint32_t u[8], t[8], block[16];
+    pbkdf2_first(&hk, salt, salt_len, u);
+    memcpy(t, u, sizeof(t));
+
+    for (uint32_t it = 1; it < iterations; ++it) {
+        hmac_digest_block(block, u);
+        memcpy(u, hk.inner, sizeof(u));
+        sha256_compress_words(u, block);
+
+        hmac_digest_block(block, u);
+        memcpy(u, hk.outer, sizeof(u));
+        sha256_compress_words(u, block);
+
+        for (int i = 0; i < 8; ++i) t[i] ^= u[i];
+    }
+
+    for (int i = 0; i < 8; ++i) store_be32(out + 4 * i, t[i]);
+}
+
+void pbkdf2_sha256_x4(const void *const passwords[SHA256_LANES],
+                      const size_t password_lens[SHA256_LANES],
+                      const uint8_t *const salts[SHA256_LANES],
+                      size_t salt_len, uint32_t iterations,
+                      uint8_t out[SHA256_LANES][SHA256_DIGEST_LEN]) {
+    uint32_t inner[8][SHA256_LANES], outer[8][SHA256_LANES];
+    uint32_t u[8][SHA256_LANES], t[8][SHA256_LANES];
+    uint32_t block[16][SHA256_LANES];
+
+    for (int l = 0; l < SHA256_LANES; ++l) {
+        HmacKey  hk;
+        uint32_t first[8];
+        hmac_key_setup(&hk, passwords[l], password_lens[l]);
+        pbkdf2_first(&hk, salts[l], salt_len, first);
+        for (int i = 0; i < 8; ++i) {
+            inner[i][l] = hk.inner[i];
+            outer[i][l] = hk.outer[i];
+            u[i][l]     = first[i];
+            t[i][l]     = first[i];
+        }
+    }
+
+    for (int l = 0; l < SHA256_LANES; ++l) {
+        block[8][l] = 0x80000000u;
+        for (int i = 9; i < 15; ++i) block[i][l] = 0;
+        block[15][l] = (SHA256_BLOCK_LEN + SHA256_DIGEST_LEN) * 8;
+    }
+
+    for (uint32_t it = 1; it < iterations; ++it) {
+        memcpy(block, u, sizeof(u));
+        memcpy(u, inner, sizeof(u));
+        sha256_compress_words_x4(u, (const uint32_t (*)[SHA256_LANES])block);
+
+        memcpy(block, u, sizeof(u));
+        memcpy(u, outer, sizeof(u));
+        sha256_compress_words_x4(u, (const uint32_t (*)[SHA256_LANES])block);
+
+        for (int i = 0; i < 8; ++i) {
+            for (int l = 0; l < SHA256_LANES; ++l) {
+                t[i][l] ^= u[i][l];
+            }
+        }
+    }
+
+    for (int l = 0; l < SHA256_LANES; ++l) {
+        for (int i = 0; i < 8; ++i) store_be32(out[l] + 4 * i, t[i][l]);
+    }
+}
@@ -0,0 +1,521 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      shmview.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Shared-memory balance view: the publishing writer and the lock-free
+ *   read-only client (see shmview.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "shmview.h"
+#include "crc32c.h"
+#include "timeutil.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHMVIEW_TMP_SUFFIX ".tmp"
+
+/* ---------------------------------------------------------------------- */
+/* Layout                                                                 */
+/* ---------------------------------------------------------------------- */
+
+static uint64_t *shmview_index(const ShmViewHeader *hdr) {
+    return (uint64_t *)((char *)hdr + hdr->index_offset);
+}
+
+static _Atomic uint64_t *shmview_slots(const ShmViewHeader *hdr) {
+    return (_Atomic uint64_t *)shmview_index(hdr);
+}
+
+static ShmViewRecord *shmview_records(const ShmViewHeader *hdr) {
+    return (ShmViewRecord *)((char *)hdr + hdr->records_offset);
+}
+
+static uint32_t shmview_hash(const char *id, size_t len) {
+    return crc32c(0, id, len);
+}
+
+/* Account IDs as the record stores them: NUL-padded words. */
+static void shmview_pack_id(const char *id, uint64_t words[SHMVIEW_ID_WORDS], size_t *len) {
+    char buf[MAX_ACCOUNT_ID_LEN] = { 0 };
+    size_t n = strnlen(id, MAX_ACCOUNT_ID_LEN - 1);
+    memcpy(buf, id, n);
+    memcpy(words, buf, sizeof(buf));
+    if (len) {
+        *len = n;
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/* Writer                                                                 */
+/* ---------------------------------------------------------------------- */
+
+void shmview_init(ShmView *v) {
+    if (!v) return;
+    memset(v, 0, sizeof(*v));
+}
+
+static void shmview_write_begin(_Atomic uint64_t *seq) {
+    uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void shmview_write_end(_Atomic uint64_t *seq) {
+    uint64_t s = atomic_load_explicit(seq, memory_order_relaxed);
+    atomic_store_explicit(seq, s + 1, memory_order_release);
+}
+
+/* Whether the published record differs from these values (writer side). */
+static int shmview_record_differs(ShmViewRecord *rec, const uint64_t id[SHMVIEW_ID_WORDS],
+                                  int64_t cents, int64_t locked) {
+    for (size_t w = 0; w < SHMVIEW_ID_WORDS; ++w) {
+        if (atomic_load_explicit(&rec->id[w], memory_order_relaxed) != id[w]) {
+            return 1;
+        }
+    }
+    return atomic_load_explicit(&rec->cents, memory_order_relaxed) != cents ||
+           atomic_load_explicit(&rec->is_locked, memory_order_relaxed) != locked;
+}
+
+static int shmview_id_differs(ShmViewRecord *rec, const char *id) {
+    uint64_t words[SHMVIEW_ID_WORDS];
+    shmview_pack_id(id, words, NULL);
+    for (size_t w = 0; w < SHMVIEW_ID_WORDS; ++w) {
+        if (atomic_load_explicit(&rec->id[w], memory_order_relaxed) != words[w]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Writes one record under its sequence lock if it changed. */
+static void shmview_put(ShmViewRecord *rec, const Account *acc) {
+    uint64_t id[SHMVIEW_ID_WORDS];
+    int64_t  cents  = llround(acc->balance * 100.0);
+    int64_t  locked = acc->is_locked;
+    shmview_pack_id(acc->id, id, NULL);
+    if (!shmview_record_differs(rec, id, cents, locked)) {
+        return;
+    }
+
+    shmview_write_begin(&rec->seq);
+    for (size_t w = 0; w < SHMVIEW_ID_WORDS; ++w) {
+        atomic_store_explicit(&rec->id[w], id[w], memory_order_relaxed);
+    }
+    atomic_store_explicit(&rec->cents, cents, memory_order_relaxed);
+    atomic_store_explicit(&rec->is_locked, locked, memory_order_relaxed);
+    shmview_write_end(&rec->seq);
+}
+
+/* Publishes the slot after the record it points to. */
+static void shmview_index_insert(ShmViewHeader *hdr, const char *id, size_t pos) {
+    _Atomic uint64_t *slots = shmview_slots(hdr);
+    uint64_t          mask  = hdr->index_slots - 1;
+    size_t            len   = strnlen(id, MAX_ACCOUNT_ID_LEN - 1);
+    uint32_t          hash  = shmview_hash(id, len);
+    uint64_t          h     = hash & mask;
+    while (atomic_load_explicit(&slots[h], memory_order_relaxed)) {
+        h = (h + 1) & mask;
+    }
+    atomic_store_explicit(&slots[h], (uint64_t)hash << 32 | (uint64_t)(pos + 1),
+                          memory_order_release);
+}
+
+static void shmview_unmap(ShmViewHeader *hdr, size_t len) {
+    if (hdr) {
+        munmap((void *)hdr, len);
+    }
+}
+
+/*
+ * Builds a fresh segment for `store` next to `path` and renames it into
+ * place, so readers never see one half-initialized.
+ */
+static AtmStatus shmview_create(ShmView *v, const char *path, const AccountStore *store) {
+    char tmp[MAX_DB_PATH_LEN + sizeof(SHMVIEW_TMP_SUFFIX)];
+    snprintf(tmp, sizeof(tmp), "%s%s", path, SHMVIEW_TMP_SUFFIX);
+
+    uint64_t capacity = store->size + store->size / 4 + SHMVIEW_MIN_RECORDS;
+    uint64_t slots    = 1;
+    while (slots < capacity + capacity / 2) {
+        slots <<= 1;
+    }
+    uint64_t index_offset   = (sizeof(ShmViewHeader) + 63) & ~(uint64_t)63;
+    uint64_t records_offset = index_offset + slots * sizeof(uint64_t);
+    size_t   len            = (size_t)(records_offset + capacity * sizeof(ShmViewRecord));
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return ATM_ERR_IO;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)len) == 0) {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(tmp);
+        return ATM_ERR_IO;
+    }
+
+    /* The file starts zeroed: every slot empty, every sequence even. */
+    ShmViewHeader *hdr = map;
+    memcpy(hdr->magic, SHMVIEW_MAGIC, sizeof(hdr->magic));
+    hdr->version        = SHMVIEW_VERSION;
+    hdr->record_size    = (uint32_t)sizeof(ShmViewRecord);
+    hdr->capacity       = capacity;
+    hdr->index_slots    = slots;
+    hdr->index_offset   = index_offset;
+    hdr->records_offset = records_offset;
+    hdr->writer_pid     = (uint64_t)getpid();
+
+    ShmViewRecord *recs = shmview_records(hdr);
+    for (size_t i = 0; i < store->size; ++i) {
+        shmview_put(&recs[i], &store->items[i]);
+        shmview_index_insert(hdr, store->items[i].id, i);
+    }
+    atomic_store_explicit(&hdr->count, store->size, memory_order_release);
+    atomic_store_explicit(&hdr->updated_ms, time_wall_ms(), memory_order_relaxed);
+    atomic_store_explicit(&hdr->publishes, 1, memory_order_relaxed);
+
+    if (rename(tmp, path) != 0) {
+        shmview_unmap(hdr, len);
+        unlink(tmp);
+        return ATM_ERR_IO;
+    }
+
+    if (v->hdr) {
+        atomic_store_explicit(&v->hdr->retired, 1, memory_order_release);
+        shmview_unmap(v->hdr, v->map_len);
+    }
+    v->hdr     = hdr;
+    v->map_len = len;
+    return ATM_OK;
+}
+
+AtmStatus shmview_open(ShmView *v, const char *path, const AccountStore *store) {
+    if (!v || !path || !store) return ATM_ERR_INTERNAL;
+    if (strlen(path) >= sizeof(v->path)) {
+        return ATM_ERR_IO;
+    }
+    strcpy(v->path, path);
+    return shmview_create(v, v->path, store);
+}
+
+void shmview_close(ShmView *v) {
+    if (!v) return;
+    shmview_unmap(v->hdr, v->map_len);
+    free(v->crcs);
+    shmview_init(v);
+}
+
+/* The record at `i` is published as is: its CRC matches the last publish. */
+static int shmview_unchanged(const ShmView *v, const uint32_t *crcs, size_t i) {
+    return crcs && i < v->crcs_len && v->crcs[i] == crcs[i];
+}
+
+/* Remembers `crcs` for the next publish; without them, it compares every record. */
+static void shmview_keep_crcs(ShmView *v, const uint32_t *crcs, size_t n) {
+    v->crcs_len = 0;
+    if (!crcs) {
+        return;
+    }
+    if (n > v->crcs_cap) {
+        uint32_t *grown = realloc(v->crcs, n * sizeof(uint32_t));
+        if (!grown) {
+            return;
+        }
+        v->crcs     = grown;
+        v->crcs_cap = n;
+    }
+    memcpy(v->crcs, crcs, n * sizeof(uint32_t));
+    v->crcs_len = n;
+}
+
+AtmStatus shmview_publish(ShmView *v, const AccountStore *store, const uint32_t *crcs) {
+    if (!v || !store) return ATM_ERR_INTERNAL;
+    if (!v->hdr) {
+        return ATM_OK;
+    }
+
+    ShmViewHeader *hdr = v->hdr;
+    if (store->size > hdr->capacity) {
+        AtmStatus st = shmview_create(v, v->path, store);
+        shmview_keep_crcs(v, st == ATM_OK ? crcs : NULL, store->size);
+        return st;
+    }
+
+    /* Balance changes only touch their record; moved records need the index rebuilt. */
+    ShmViewRecord *recs  = shmview_records(hdr);
+    size_t         count = (size_t)atomic_load_explicit(&hdr->count, memory_order_relaxed);
+    int            moved = store->size < count;
+    for (size_t i = 0; i < count && i < store->size && !moved; ++i) {
+        moved = !shmview_unchanged(v, crcs, i) && shmview_id_differs(&recs[i], store->items[i].id);
+    }
+
+    if (moved) {
+        shmview_write_begin(&hdr->index_seq);
+    }
+    for (size_t i = 0; i < store->size; ++i) {
+        if (!shmview_unchanged(v, crcs, i)) {
+            shmview_put(&recs[i], &store->items[i]);
+        }
+    }
+    if (moved) {
+        memset(shmview_index(hdr), 0, (size_t)hdr->index_slots * sizeof(uint64_t));
+        for (size_t i = 0; i < store->size; ++i) {
+            shmview_index_insert(hdr, store->items[i].id, i);
+        }
+        atomic_store_explicit(&hdr->count, store->size, memory_order_relaxed);
+        shmview_write_end(&hdr->index_seq);
+    } else {
+        for (size_t i = count; i < store->size; ++i) {
+            shmview_index_insert(hdr, store->items[i].id, i);
+        }
+        atomic_store_explicit(&hdr->count, store->size, memory_order_release);
+    }
+    shmview_keep_crcs(v, crcs, store->size);
+
+    atomic_store_explicit(&hdr->updated_ms, time_wall_ms(), memory_order_relaxed);
+    atomic_fetch_add_explicit(&hdr->publishes, 1, memory_order_relaxed);
+    return ATM_OK;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Reader                                                                 */
+/* ---------------------------------------------------------------------- */
+
+AtmStatus shmview_attach(ShmViewReader *r, const char *path) {
+    if (!r || !path) return ATM_ERR_INTERNAL;
+    memset(r, 0, sizeof(*r));
+    if (strlen(path) >= sizeof(r->path)) {
+        return ATM_ERR_IO;
+    }
+    strcpy(r->path, path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ATM_ERR_IO;
+    }
+    struct stat sb;
+    void       *map = MAP_FAILED;
+    if (fstat(fd, &sb) == 0 && (size_t)sb.st_size >= sizeof(ShmViewHeader)) {
+        map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ATM_ERR_IO;
+    }
+
+    const ShmViewHeader *hdr = map;
+    size_t               len = (size_t)sb.st_size;
+    int ok = memcmp(hdr->magic, SHMVIEW_MAGIC, sizeof(hdr->magic)) == 0 &&
+             hdr->version == SHMVIEW_VERSION &&
+             hdr->record_size == sizeof(ShmViewRecord) &&
+             hdr->index_slots && (hdr->index_slots & (hdr->index_slots - 1)) == 0 &&
+             hdr->index_offset >= sizeof(ShmViewHeader) &&
+             hdr->records_offset >= hdr->index_offset + hdr->index_slots * sizeof(uint64_t) &&
+             hdr->records_offset + hdr->capacity * sizeof(ShmViewRecord) <= len;
+    if (!ok) {
+        munmap(map, len);
+        return ATM_ERR_PARSE;
+    }
+    r->hdr     = hdr;
+    r->map_len = len;
+    return ATM_OK;
+}
+
+void shmview_detach(ShmViewReader *r) {
+    if (!r) return;
+    if (r->hdr) {
+        munmap((void *)r->hdr, r->map_len);
+    }
+    r->hdr     = NULL;
+    r->map_len = 0;
+}
+
+/* Follows the writer to a new segment; keeps the old one if that fails. */
+static AtmStatus shmview_current(ShmViewReader *r) {
+    if (!r || !r->hdr) return ATM_ERR_INTERNAL;
+    if (!atomic_load_explicit(&r->hdr->retired, memory_order_acquire)) {
+        return ATM_OK;
+    }
+    ShmViewReader next;
+    if (shmview_attach(&next, r->path) == ATM_OK) {
+        next.retries = r->retries;
+        shmview_detach(r);
+        *r = next;
+    }
+    return ATM_OK;
+}
+
+/* Spins (yielding now and then) after a torn read; 0 once the writer looks stuck. */
+static int shmview_retry(ShmViewReader *r, unsigned *spins) {
+    r->retries++;
+    if (++*spins >= SHMVIEW_MAX_SPINS) {
+        return 0;
+    }
+    if ((*spins & 63u) == 0) {
+        sched_yield();
+    }
+    return 1;
+}
+
+/* Copies one record under its sequence lock. 0 if it was being written. */
+static int shmview_read_record(const ShmViewRecord *rec, ShmViewBalance *out,
+                               uint64_t id[SHMVIEW_ID_WORDS]) {
+    uint64_t s1 = atomic_load_explicit(&rec->seq, memory_order_acquire);
+    if (s1 & 1u) {
+        return 0;
+    }
+    for (size_t w = 0; w < SHMVIEW_ID_WORDS; ++w) {
+        id[w] = atomic_load_explicit(&rec->id[w], memory_order_relaxed);
+    }
+    int64_t cents  = atomic_load_explicit(&rec->cents, memory_order_relaxed);
+    int64_t locked = atomic_load_explicit(&rec->is_locked, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&rec->seq, memory_order_relaxed) != s1) {
+        return 0;
+    }
+
+    memcpy(out->id, id, MAX_ACCOUNT_ID_LEN);
+    out->id[MAX_ACCOUNT_ID_LEN - 1] = '\0';
+    out->cents     = cents;
+    out->is_locked = (int)locked;
+    return 1;
+}
+
+AtmStatus shmview_get(ShmViewReader *r, const char *account_id, ShmViewBalance *out) {
+    if (!account_id || !out || shmview_current(r) != ATM_OK) return ATM_ERR_INTERNAL;
+
+    const ShmViewHeader     *hdr   = r->hdr;
+    const _Atomic uint64_t  *slots = shmview_slots(hdr);
+    const ShmViewRecord     *recs  = shmview_records(hdr);
+    uint64_t                 mask  = hdr->index_slots - 1;
+    uint64_t                 want[SHMVIEW_ID_WORDS];
+    size_t                   len   = 0;
+    shmview_pack_id(account_id, want, &len);
+    uint32_t                 hash  = shmview_hash(account_id, len);
+
+    unsigned spins = 0;
+    for (;;) {
+        uint64_t gen = atomic_load_explicit(&hdr->index_seq, memory_order_acquire);
+        if (gen & 1u) {
+            if (!shmview_retry(r, &spins)) return ATM_ERR_IO;
+            continue;
+        }
+
+        AtmStatus st    = ATM_ERR_NOT_FOUND;
+        int       torn  = 0;
+        uint64_t  count = atomic_load_explicit(&hdr->count, memory_order_acquire);
+        for (uint64_t h = hash & mask, n = 0; n <= mask; h = (h + 1) & mask, ++n) {
+            uint64_t slot = atomic_load_explicit(&slots[h], memory_order_acquire);
+            if (!slot) {
+                break;
+            }
+            uint64_t pos = (slot & 0xffffffffu) - 1;
+            if ((uint32_t)(slot >> 32) != hash || pos >= count || pos >= hdr->capacity) {
+                continue;
+            }
+            uint64_t id[SHMVIEW_ID_WORDS];
+            if (!shmview_read_record(&recs[pos], out, id)) {
+                torn = 1;
+                break;
+            }
+            if (memcmp(id, want, sizeof(want)) == 0) {
+                st = (out->is_locked == ACCOUNT_CLOSED) ? ATM_ERR_NOT_FOUND : ATM_OK;
+                break;
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (!torn && atomic_load_explicit(&hdr->index_seq, memory_order_relaxed) == gen) {
+            return st;
+        }
+        if (!shmview_retry(r, &spins)) return ATM_ERR_IO;
+    }
+}
+
+size_t shmview_count(ShmViewReader *r) {
+    if (shmview_current(r) != ATM_OK) return 0;
+    return (size_t)atomic_load_explicit(&r->hdr->count, memory_order_acquire);
+}
+
+AtmStatus shmview_at(ShmViewReader *r, size_t pos, ShmViewBalance *out) {
+    if (!out || shmview_current(r) != ATM_OK) return ATM_ERR_INTERNAL;
+    if (pos >= atomic_load_explicit(&r->hdr->count, memory_order_acquire) ||
+        pos >= r->hdr->capacity) {
+        return ATM_ERR_NOT_FOUND;
+    }
+
+    const ShmViewRecord *rec   = &shmview_records(r->hdr)[pos];
+    unsigned             spins = 0;
+    uint64_t             id[SHMVIEW_ID_WORDS];
+    while (!shmview_read_record(rec, out, id)) {
+        if (!shmview_retry(r, &spins)) return ATM_ERR_IO;
+    }
+    return ATM_OK;
+}
+
+#else /* Windows: no shared-memory view */
+
+void shmview_init(ShmView *v) {
+    if (!v) return;
+    memset(v, 0, sizeof(*v));
+}
+
+AtmStatus shmview_open(ShmView *v, const char *path, const AccountStore *store) {
+    (void)v; (void)path; (void)store;
+    return ATM_ERR_IO;
+}
+
+void shmview_close(ShmView *v) {
+    (void)v;
+}
+
+AtmStatus shmview_publish(ShmView *v, const AccountStore *store, const uint32_t *crcs) {
+    (void)v; (void)store; (void)crcs;
+    return ATM_OK;
+}
+
+AtmStatus shmview_attach(ShmViewReader *r, const char *path) {
+    (void)r; (void)path;
+    return ATM_ERR_IO;
+}
+
+void shmview_detach(ShmViewReader *r) {
+    (void)r;
+}
+
+AtmStatus shmview_get(ShmViewReader *r, const char *account_id, ShmViewBalance *out) {
+    (void)r; (void)account_id; (void)out;
+    return ATM_ERR_IO;
+}
+
+size_t shmview_count(ShmViewReader *r) {
+    (void)r;
+    return 0;
+}
+
+AtmStatus shmview_at(ShmViewReader *r, size_t pos, ShmViewBalance *out) {
+    (void)r; (void)pos; (void)out;
+    return ATM_ERR_IO;
+}
+
+#endif
@@ -0,0 +1,834 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      snapshot.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Archival snapshot writer and restorer (see snapshot.h). The record
+ *   encoding is generated from ACCOUNT_FIELDS like the text codecs.
+ */
+
+#include "snapshot.h"
+#include "crc32c.h"
+#include "fileio.h"
+#include "timeutil.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SNAP_MAGIC_LEN 8
+#define SNAP_CRC_LEN   4
+
+enum {
+    SNAP_KEEP,
+    SNAP_SKIP,
+    SNAP_CHANGE,
+    SNAP_INSERT
+};
+
+/* Field numbers: bit positions in a record's field mask. */
+#define SNAP_FIELD_ENUM(member, key, kind, c_type, dim) SNAP_FIELD_##member,
+enum { ACCOUNT_FIELDS(SNAP_FIELD_ENUM) SNAP_FIELD_COUNT };
+#undef SNAP_FIELD_ENUM
+
+static const Account snap_empty;
+
+/* ---------------------------------------------------------------------- */
+/* Byte buffer and varints                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    uint8_t *data;
+    size_t   len;
+    size_t   cap;
+    int      failed; /* out of memory */
+} SnapBuf;
+
+static int snap_reserve(SnapBuf *b, size_t n) {
+    if (b->failed) return 0;
+    if (b->cap - b->len >= n) return 1;
+
+    size_t cap = b->cap ? b->cap : 4096;
+    while (cap - b->len < n) {
+        cap *= 2;
+    }
+    uint8_t *grown = realloc(b->data, cap);
+    if (!grown) {
+        b->failed = 1;
+        return 0;
+    }
+    b->data = grown;
+    b->cap  = cap;
+    return 1;
+}
+
+static void snap_put_bytes(SnapBuf *b, const void *p, size_t n) {
+    if (n && snap_reserve(b, n)) {
+        memcpy(b->data + b->len, p, n);
+        b->len += n;
+    }
+}
+
+static void snap_put_varint(SnapBuf *b, uint64_t v) {
+    if (!snap_reserve(b, 10)) return;
+    while (v >= 0x80) {
+        b->data[b->len++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    b->data[b->len++] = (uint8_t)v;
+}
+
+static void snap_put_u32le(SnapBuf *b, uint32_t v) {
+    uint8_t le[4] = { (uint8_t)v, (uint8_t)(v >> 8), (uint8_t)(v >> 16), (uint8_t)(v >> 24) };
+    snap_put_bytes(b, le, sizeof(le));
+}
+
+static uint32_t snap_get_u32le(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t snap_zigzag(int64_t v) {
+    return v < 0 ? (((uint64_t)-(v + 1)) << 1) | 1u : (uint64_t)v << 1;
+}
+
+static int64_t snap_unzigzag(uint64_t u) {
+    return (u & 1u) ? -(int64_t)(u >> 1) - 1 : (int64_t)(u >> 1);
+}
+
+/* Balances are kept to the cent, as in the database files. */
+static int64_t snap_cents(double v) {
+    return (int64_t)llround(v * 100.0);
+}
+
+/* ---------------------------------------------------------------------- */
+/* Encoder                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    SnapBuf   body;       /* finished ops */
+    SnapBuf   run;        /* records of the op being built */
+    int       run_kind;
+    size_t    run_len;
+    char      prev_id[MAX_ACCOUNT_ID_LEN];
+    SnapBuf   arena;      /* dictionary words */
+    uint32_t *word_off;
+    uint32_t *word_len;
+    size_t    words;
+    size_t    words_cap;
+    uint32_t *slots;      /* word index + 1, open addressing */
+    size_t    mask;
+} SnapEncoder;
+
+static uint32_t snap_hash(const char *p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ (unsigned char)p[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void snap_encoder_reset(SnapEncoder *e) {
+    e->body.len    = 0;
+    e->run.len     = 0;
+    e->run_kind    = -1;
+    e->run_len     = 0;
+    e->prev_id[0]  = '\0';
+    e->arena.len   = 0;
+    e->words       = 0;
+    if (e->slots) {
+        memset(e->slots, 0, (e->mask + 1) * sizeof(uint32_t));
+    }
+}
+
+static void snap_encoder_free(SnapEncoder *e) {
+    free(e->body.data);
+    free(e->run.data);
+    free(e->arena.data);
+    free(e->word_off);
+    free(e->word_len);
+    free(e->slots);
+}
+
+static int snap_dict_grow(SnapEncoder *e) {
+    size_t    mask  = e->slots ? e->mask * 2 + 1 : 1023;
+    uint32_t *slots = calloc(mask + 1, sizeof(uint32_t));
+    if (!slots) {
+        return 0;
+    }
+    for (size_t w = 0; w < e->words; ++w) {
+        size_t h = snap_hash((const char *)e->arena.data + e->word_off[w], e->word_len[w]) & mask;
+        while (slots[h]) h = (h + 1) & mask;
+        slots[h] = (uint32_t)w + 1;
+    }
+    free(e->slots);
+    e->slots = slots;
+    e->mask  = mask;
+    return 1;
+}
+
+/* Writes one word: its dictionary reference + 1, or 0 and the literal. */
+static void snap_put_word(SnapEncoder *e, const char *w, size_t n) {
+    if (!e->slots || 2 * (e->words + 1) > e->mask + 1) {
+        if (!snap_dict_grow(e)) {
+            e->run.failed = 1;
+            return;
+        }
+    }
+
+    size_t h = snap_hash(w, n) & e->mask;
+    while (e->slots[h]) {
+        size_t idx = e->slots[h] - 1;
+        if (e->word_len[idx] == n && memcmp(e->arena.data + e->word_off[idx], w, n) == 0) {
+            snap_put_varint(&e->run, idx + 1);
+            return;
+        }
+        h = (h + 1) & e->mask;
+    }
+
+    if (e->words == e->words_cap) {
+        size_t    cap  = e->words_cap ? e->words_cap * 2 : 1024;
+        uint32_t *off  = realloc(e->word_off, cap * sizeof(uint32_t));
+        if (off) e->word_off = off;
+        uint32_t *len  = off ? realloc(e->word_len, cap * sizeof(uint32_t)) : NULL;
+        if (!off || !len) {
+            e->run.failed = 1;
+            return;
+        }
+        e->word_len  = len;
+        e->words_cap = cap;
+    }
+    e->word_off[e->words] = (uint32_t)e->arena.len;
+    e->word_len[e->words] = (uint32_t)n;
+    snap_put_bytes(&e->arena, w, n);
+    e->slots[h] = (uint32_t)++e->words;
+
+    snap_put_varint(&e->run, 0);
+    snap_put_varint(&e->run, n);
+    snap_put_bytes(&e->run, w, n);
+}
+
+static void snap_put_STR(SnapEncoder *e, int field, const char *v) {
+    if (field == SNAP_FIELD_id) {
+        size_t shared = 0;
+        while (v[shared] && v[shared] == e->prev_id[shared]) {
+            shared++;
+        }
+        size_t n = strlen(v + shared);
+        snap_put_varint(&e->run, shared);
+        snap_put_varint(&e->run, n);
+        snap_put_bytes(&e->run, v + shared, n);
+        memcpy(e->prev_id + shared, v + shared, n + 1);
+        return;
+    }
+
+    size_t words = 0;
+    if (*v) {
+        words = 1;
+        for (const char *p = v; *p; ++p) {
+            words += (*p == ' ');
+        }
+    }
+    snap_put_varint(&e->run, words);
+    for (const char *p = v; words--; ) {
+        const char *sp = strchr(p, ' ');
+        size_t      n  = sp ? (size_t)(sp - p) : strlen(p);
+        snap_put_word(e, p, n);
+        p += n + 1;
+    }
+}
+
+#define SNAP_PUT_STR(e, field, f, b)   snap_put_STR((e), (field), (f))
+#define SNAP_PUT_HEX(e, field, f, b)   snap_put_bytes(&(e)->run, (f), sizeof(f))
+#define SNAP_PUT_MONEY(e, field, f, b) snap_put_varint(&(e)->run, snap_zigzag(snap_cents(f) - snap_cents(b)))
+#define SNAP_PUT_U32(e, field, f, b)   snap_put_varint(&(e)->run, (f))
+#define SNAP_PUT_UINT(e, field, f, b)  snap_put_varint(&(e)->run, (f))
+#define SNAP_PUT_FLAG(e, field, f, b)  snap_put_varint(&(e)->run, snap_zigzag(f))
+
+#define SNAP_SAME_STR(a, b)   (strcmp((a), (b)) == 0)
+#define SNAP_SAME_HEX(a, b)   (memcmp((a), (b), sizeof(a)) == 0)
+#define SNAP_SAME_MONEY(a, b) (snap_cents(a) == snap_cents(b))
+#define SNAP_SAME_U32(a, b)   ((a) == (b))
+#define SNAP_SAME_UINT(a, b)  ((a) == (b))
+#define SNAP_SAME_FLAG(a, b)  ((a) == (b))
+
+static uint32_t snap_record_mask(const Account *acc, const Account *base) {
+    uint32_t mask = 0;
+#define SNAP_MASK_FIELD(member, key, kind, c_type, dim)      \
+    if (!SNAP_SAME_##kind(acc->member, base->member)) {      \
+        mask |= 1u << SNAP_FIELD_##member;                   \
+    }
+    ACCOUNT_FIELDS(SNAP_MASK_FIELD)
+#undef SNAP_MASK_FIELD
+    return mask;
+}
+
+static void snap_put_record(SnapEncoder *e, const Account *acc, const Account *base,
+                            uint32_t mask) {
+    snap_put_varint(&e->run, mask);
+#define SNAP_PUT_FIELD(member, key, kind, c_type, dim)                          \
+    if (mask & (1u << SNAP_FIELD_##member)) {                                   \
+        SNAP_PUT_##kind(e, SNAP_FIELD_##member, acc->member, base->member);     \
+    }
+    ACCOUNT_FIELDS(SNAP_PUT_FIELD)
+#undef SNAP_PUT_FIELD
+}
+
+static void snap_flush_run(SnapEncoder *e) {
+    if (e->run_len) {
+        snap_put_varint(&e->body, (uint64_t)e->run_len << 2 | (uint64_t)e->run_kind);
+        snap_put_bytes(&e->body, e->run.data, e->run.len);
+        if (e->run.failed) {
+            e->body.failed = 1;
+        }
+    }
+    e->run.len = 0;
+    e->run_len = 0;
+}
+
+/* Adds `count` records to the op stream; CHANGE/INSERT encode `acc`. */
+static void snap_emit(SnapEncoder *e, int kind, size_t count,
+                      const Account *acc, const Account *base, uint32_t mask) {
+    if (kind != e->run_kind) {
+        snap_flush_run(e);
+        e->run_kind = kind;
+    }
+    if (kind == SNAP_CHANGE || kind == SNAP_INSERT) {
+        snap_put_record(e, acc, base, mask);
+    }
+    e->run_len += count;
+}
+
+static void snap_encode_full(SnapEncoder *e, const AccountStore *store, SnapshotInfo *info) {
+    for (size_t i = 0; i < store->size; ++i) {
+        const Account *acc = &store->items[i];
+        snap_emit(e, SNAP_INSERT, 1, acc, &snap_empty, snap_record_mask(acc, &snap_empty));
+    }
+    snap_flush_run(e);
+    info->inserted = store->size;
+}
+
+static uint64_t snap_hash_id(const char *id) {
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char *p = (const unsigned char *)id; *p; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/*
+ * Edit script from `base` to `store`. Returns 0 if surviving records
+ * changed order (the caller then writes a full snapshot), -1 if out of
+ * memory.
+ */
+static int snap_encode_delta(SnapEncoder *e, const AccountStore *store,
+                             const AccountStore *base, SnapshotInfo *info) {
+    size_t mask = 15;
+    while (mask + 1 < 2 * base->size) {
+        mask = mask * 2 + 1;
+    }
+    size_t *slots = calloc(mask + 1, sizeof(size_t));
+    if (!slots) {
+        return -1;
+    }
+    for (size_t k = 0; k < base->size; ++k) {
+        size_t h = (size_t)snap_hash_id(base->items[k].id) & mask;
+        while (slots[h]) h = (h + 1) & mask;
+        slots[h] = k + 1;
+    }
+
+    size_t j  = 0; /* next base record */
+    int    ok = 1;
+    for (size_t i = 0; i < store->size && ok; ++i) {
+        const Account *acc = &store->items[i];
+        size_t         h   = (size_t)snap_hash_id(acc->id) & mask;
+        size_t         k   = 0;
+        while (slots[h]) {
+            if (strcmp(base->items[slots[h] - 1].id, acc->id) == 0) {
+                k = slots[h];
+                break;
+            }
+            h = (h + 1) & mask;
+        }
+
+        if (!k) {
+            snap_emit(e, SNAP_INSERT, 1, acc, &snap_empty, snap_record_mask(acc, &snap_empty));
+            info->inserted++;
+            continue;
+        }
+        k -= 1;
+        if (k < j) {
+            ok = 0; /* reordered (or a duplicate ID) */
+            break;
+        }
+        if (k > j) {
+            snap_emit(e, SNAP_SKIP, k - j, NULL, NULL, 0);
+            info->removed += k - j;
+        }
+        j = k + 1;
+
+        uint32_t fields = snap_record_mask(acc, &base->items[k]);
+        if (fields) {
+            snap_emit(e, SNAP_CHANGE, 1, acc, &base->items[k], fields);
+            info->changed++;
+        } else {
+            snap_emit(e, SNAP_KEEP, 1, NULL, NULL, 0);
+            info->kept++;
+        }
+    }
+    if (ok && j < base->size) {
+        snap_emit(e, SNAP_SKIP, base->size - j, NULL, NULL, 0);
+        info->removed += base->size - j;
+    }
+    snap_flush_run(e);
+
+    free(slots);
+    return ok;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Decoder                                                                */
+/* ---------------------------------------------------------------------- */
+
+typedef struct {
+    const uint8_t  *p;
+    const uint8_t  *end;
+    int             failed;
+    char            prev_id[MAX_ACCOUNT_ID_LEN];
+    const uint8_t **word_ptr;
+    uint32_t       *word_len;
+    size_t          words;
+    size_t          words_cap;
+} SnapDecoder;
+
+static uint64_t snap_get_varint(SnapDecoder *d) {
+    uint64_t v = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (d->p >= d->end) break;
+        uint8_t byte = *d->p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return v;
+        }
+    }
+    d->failed = 1;
+    return 0;
+}
+
+static const uint8_t *snap_get_bytes(SnapDecoder *d, size_t n) {
+    if ((size_t)(d->end - d->p) < n) {
+        d->failed = 1;
+        return NULL;
+    }
+    const uint8_t *p = d->p;
+    d->p += n;
+    return p;
+}
+
+static void snap_get_STR(SnapDecoder *d, int field, char *dst, size_t cap) {
+    if (field == SNAP_FIELD_id) {
+        size_t         shared = (size_t)snap_get_varint(d);
+        size_t         n      = (size_t)snap_get_varint(d);
+        const uint8_t *p      = snap_get_bytes(d, n);
+        if (!p || shared > strlen(d->prev_id) || n >= cap - shared) {
+            d->failed = 1;
+            return;
+        }
+        memcpy(dst, d->prev_id, shared);
+        memcpy(dst + shared, p, n);
+        dst[shared + n] = '\0';
+        memcpy(d->prev_id, dst, shared + n + 1);
+        return;
+    }
+
+    size_t words = (size_t)snap_get_varint(d);
+    size_t len   = 0;
+    for (size_t w = 0; w < words && !d->failed; ++w) {
+        const uint8_t *p   = NULL;
+        size_t         n   = 0;
+        uint64_t       ref = snap_get_varint(d);
+        if (ref == 0) {
+            n = (size_t)snap_get_varint(d);
+            p = snap_get_bytes(d, n);
+            if (!p) break;
+            if (d->words == d->words_cap) {
+                size_t          c   = d->words_cap ? d->words_cap * 2 : 1024;
+                const uint8_t **ptr = realloc(d->word_ptr, c * sizeof(*ptr));
+                if (ptr) d->word_ptr = ptr;
+                uint32_t       *wl  = ptr ? realloc(d->word_len, c * sizeof(*wl)) : NULL;
+                if (!ptr || !wl) {
+                    d->failed = 1;
+                    break;
+                }
+                d->word_len  = wl;
+                d->words_cap = c;
+            }
+            d->word_ptr[d->words]   = p;
+            d->word_len[d->words++] = (uint32_t)n;
+        } else if (ref <= d->words) {
+            p = d->word_ptr[ref - 1];
+            n = d->word_len[ref - 1];
+        } else {
+            d->failed = 1;
+            break;
+        }
+
+        if (len + (w > 0) + n >= cap) {
+            d->failed = 1;
+            break;
+        }
+        if (w > 0) {
+            dst[len++] = ' ';
+        }
+        memcpy(dst + len, p, n);
+        len += n;
+    }
+    dst[len] = '\0';
+}
+
+static void snap_get_HEX(SnapDecoder *d, uint8_t *dst, size_t len) {
+    const uint8_t *p = snap_get_bytes(d, len);
+    if (p) {
+        memcpy(dst, p, len);
+    }
+}
+
+static uint64_t snap_get_limited(SnapDecoder *d, uint64_t limit) {
+    uint64_t v = snap_get_varint(d);
+    if (v > limit) {
+        d->failed = 1;
+        return 0;
+    }
+    return v;
+}
+
+static int snap_get_FLAG(SnapDecoder *d) {
+    int64_t v = snap_unzigzag(snap_get_varint(d));
+    if (v < INT_MIN || v > INT_MAX) {
+        d->failed = 1;
+        return 0;
+    }
+    return (int)v;
+}
+
+#define SNAP_GET_STR(d, field, f)   snap_get_STR((d), (field), (f), sizeof(f))
+#define SNAP_GET_HEX(d, field, f)   snap_get_HEX((d), (f), sizeof(f))
+#define SNAP_GET_MONEY(d, field, f) \
+    ((f) = (double)(snap_cents(f) + snap_unzigzag(snap_get_varint(d))) / 100.0)
+#define SNAP_GET_U32(d, field, f)   ((f) = (uint32_t)snap_get_limited((d), UINT32_MAX))
+#define SNAP_GET_UINT(d, field, f)  ((f) = (unsigned)snap_get_limited((d), UINT_MAX))
+#define SNAP_GET_FLAG(d, field, f)  ((f) = snap_get_FLAG(d))
+
+/* Applies one encoded record to `acc` (a copy of its base record). */
+static void snap_get_record(SnapDecoder *d, Account *acc) {
+    uint64_t mask = snap_get_varint(d);
+    if (mask >> SNAP_FIELD_COUNT) {
+        d->failed = 1;
+        return;
+    }
+#define SNAP_GET_FIELD(member, key, kind, c_type, dim)          \
+    if (!d->failed && (mask & (1u << SNAP_FIELD_##member))) {   \
+        SNAP_GET_##kind(d, SNAP_FIELD_##member, acc->member);   \
+    }
+    ACCOUNT_FIELDS(SNAP_GET_FIELD)
+#undef SNAP_GET_FIELD
+}
+
+/* ---------------------------------------------------------------------- */
+/* Files                                                                  */
+/* ---------------------------------------------------------------------- */
+
+static AtmStatus snap_read_file(const char *path, uint8_t **data, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return ATM_ERR_IO;
+    }
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        size = ftell(f);
+    }
+    if (size < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return ATM_ERR_IO;
+    }
+    uint8_t *buf = malloc((size_t)size + 1);
+    if (!buf) {
+        fclose(f);
+        return ATM_ERR_INTERNAL;
+    }
+    if (fread(buf, 1, (size_t)size, f) != (size_t)size) {
+        free(buf);
+        fclose(f);
+        return ATM_ERR_IO;
+    }
+    fclose(f);
+    *data = buf;
+    *len  = (size_t)size;
+    return ATM_OK;
+}
+
+/* The base lives next to the delta: "<dir of path>/<name>". */
+static AtmStatus snap_sibling(const char *path, const char *name, char *out, size_t cap) {
+    const char *slash = strrchr(path, '/');
+    size_t      dir   = slash ? (size_t)(slash - path) + 1 : 0;
+    size_t      n     = strlen(name);
+    if (dir + n >= cap) {
+        return ATM_ERR_IO;
+    }
+    memcpy(out, path, dir);
+    memcpy(out + dir, name, n + 1);
+    return ATM_OK;
+}
+
+static const char *snap_basename(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static AtmStatus snap_load(const char *path, AccountStore *store, SnapshotInfo *info,
+                           size_t depth, uint32_t *file_crc) {
+    uint8_t  *data = NULL;
+    size_t    len  = 0;
+    AtmStatus st   = snap_read_file(path, &data, &len);
+    if (st != ATM_OK) {
+        return st;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->bytes = len;
+    info->chain = 1;
+
+    if (len < SNAP_MAGIC_LEN + SNAP_CRC_LEN || memcmp(data, SNAPSHOT_MAGIC, SNAP_MAGIC_LEN) != 0) {
+        free(data);
+        return ATM_ERR_PARSE;
+    }
+    *file_crc = snap_get_u32le(data + len - SNAP_CRC_LEN);
+    if (crc32c(0, data, len - SNAP_CRC_LEN) != *file_crc) {
+        free(data);
+        return ATM_ERR_CHECKSUM;
+    }
+
+    SnapDecoder d;
+    memset(&d, 0, sizeof(d));
+    d.p   = data + SNAP_MAGIC_LEN;
+    d.end = data + len - SNAP_CRC_LEN;
+
+    uint64_t version  = snap_get_varint(&d);
+    uint64_t kind     = snap_get_varint(&d);
+    info->created_ms  = snap_get_varint(&d);
+    uint64_t records  = snap_get_varint(&d);
+    if (d.failed || version != SNAPSHOT_VERSION || kind > 1 || records > SIZE_MAX / sizeof(Account)) {
+        free(data);
+        return ATM_ERR_PARSE;
+    }
+    info->delta   = (int)kind;
+    info->records = (size_t)records;
+
+    AccountStore base;
+    account_store_init(&base);
+    if (info->delta) {
+        size_t         n    = (size_t)snap_get_varint(&d);
+        const uint8_t *name = snap_get_bytes(&d, n);
+        const uint8_t *crc  = snap_get_bytes(&d, SNAP_CRC_LEN);
+        if (!name || !crc || n == 0 || n >= sizeof(info->base) ||
+            memchr(name, '/', n) || memchr(name, '\0', n) || depth >= SNAPSHOT_MAX_CHAIN) {
+            free(data);
+            return ATM_ERR_PARSE;
+        }
+        memcpy(info->base, name, n);
+        info->base[n] = '\0';
+
+        char         base_path[MAX_DB_PATH_LEN];
+        SnapshotInfo base_info;
+        uint32_t     base_crc = 0;
+        st = snap_sibling(path, info->base, base_path, sizeof(base_path));
+        if (st == ATM_OK) {
+            st = snap_load(base_path, &base, &base_info, depth + 1, &base_crc);
+        }
+        if (st == ATM_OK && base_crc != snap_get_u32le(crc)) {
+            st = ATM_ERR_CHECKSUM; /* the base was replaced */
+        }
+        if (st != ATM_OK) {
+            account_store_free(&base);
+            free(data);
+            return st;
+        }
+        info->chain += base_info.chain;
+    }
+
+    AccountStore out;
+    account_store_init(&out);
+    size_t j = 0;
+    while (st == ATM_OK && d.p < d.end && !d.failed) {
+        uint64_t op  = snap_get_varint(&d);
+        uint64_t run = op >> 2;
+        int      k   = (int)(op & 3u);
+        if (d.failed || run == 0 || (k != SNAP_SKIP && run > records - out.size) ||
+            (k != SNAP_INSERT && run > base.size - j)) {
+            d.failed = 1;
+            break;
+        }
+        for (uint64_t r = 0; r < run && st == ATM_OK && !d.failed; ++r) {
+            Account acc;
+            switch (k) {
+            case SNAP_KEEP:
+                st = account_store_append(&out, &base.items[j++]);
+                info->kept++;
+                break;
+            case SNAP_SKIP:
+                j++;
+                info->removed++;
+                break;
+            case SNAP_CHANGE:
+                acc = base.items[j++];
+                snap_get_record(&d, &acc);
+                st = account_store_append(&out, &acc);
+                info->changed++;
+                break;
+            default:
+                acc = snap_empty;
+                snap_get_record(&d, &acc);
+                st = account_store_append(&out, &acc);
+                info->inserted++;
+                break;
+            }
+        }
+    }
+    if (st == ATM_OK && (d.failed || out.size != records || j != base.size)) {
+        st = ATM_ERR_PARSE;
+    }
+
+    free(d.word_ptr);
+    free(d.word_len);
+    account_store_free(&base);
+    free(data);
+
+    if (st != ATM_OK) {
+        account_store_free(&out);
+        return st;
+    }
+    account_store_free(store);
+    *store = out;
+    return ATM_OK;
+}
+
+AtmStatus snapshot_restore(const char *path, AccountStore *store, SnapshotInfo *info) {
+    if (!path || !store) return ATM_ERR_INTERNAL;
+
+    SnapshotInfo local;
+    uint32_t     crc = 0;
+    return snap_load(path, store, info ? info : &local, 0, &crc);
+}
+
+AtmStatus snapshot_write(const AccountStore *store, const char *path,
+                         const char *base_path, SnapshotInfo *info) {
+    if (!store || !path) return ATM_ERR_INTERNAL;
+
+    SnapshotInfo local;
+    if (!info) info = &local;
+    memset(info, 0, sizeof(*info));
+    info->created_ms = time_wall_ms();
+    info->records    = store->size;
+
+    AtmStatus    st       = ATM_OK;
+    uint32_t     base_crc = 0;
+    AccountStore base;
+    account_store_init(&base);
+
+    if (base_path) {
+        /* Restore will look for the base next to the delta: check it is there. */
+        const char  *name = snap_basename(base_path);
+        char         sibling[MAX_DB_PATH_LEN];
+        SnapshotInfo base_info;
+        uint32_t     sibling_crc = 0;
+        st = snap_load(base_path, &base, &base_info, 0, &base_crc);
+        if (st == ATM_OK && strlen(name) >= sizeof(info->base)) {
+            st = ATM_ERR_IO;
+        }
+        if (st == ATM_OK) {
+            st = snap_sibling(path, name, sibling, sizeof(sibling));
+        }
+        if (st == ATM_OK && strcmp(sibling, base_path) != 0) {
+            AccountStore probe;
+            account_store_init(&probe);
+            st = snap_load(sibling, &probe, &base_info, 0, &sibling_crc);
+            account_store_free(&probe);
+            if (st == ATM_OK && sibling_crc != base_crc) {
+                st = ATM_ERR_IO;
+            }
+        }
+        if (st != ATM_OK) {
+            account_store_free(&base);
+            return st;
+        }
+        strcpy(info->base, name);
+        info->delta = 1;
+    }
+
+    SnapEncoder e;
+    memset(&e, 0, sizeof(e));
+    snap_encoder_reset(&e);
+
+    if (info->delta) {
+        int rc = snap_encode_delta(&e, store, &base, info);
+        if (rc == 0) {
+            /* Reordered: fall back to a self-contained snapshot. */
+            snap_encoder_reset(&e);
+            info->delta   = 0;
+            info->base[0] = '\0';
+            info->kept    = 0;
+            info->changed = 0;
+            info->removed = 0;
+            info->inserted = 0;
+        } else if (rc < 0) {
+            e.body.failed = 1;
+        }
+    }
+    if (!info->delta && !e.body.failed) {
+        snap_encode_full(&e, store, info);
+    }
+    account_store_free(&base);
+
+    SnapBuf head;
+    memset(&head, 0, sizeof(head));
+    snap_put_bytes(&head, SNAPSHOT_MAGIC, SNAP_MAGIC_LEN);
+    snap_put_varint(&head, SNAPSHOT_VERSION);
+    snap_put_varint(&head, (uint64_t)info->delta);
+    snap_put_varint(&head, info->created_ms);
+    snap_put_varint(&head, store->size);
+    if (info->delta) {
+        snap_put_varint(&head, strlen(info->base));
+        snap_put_bytes(&head, info->base, strlen(info->base));
+        snap_put_u32le(&head, base_crc);
+    }
+
+    if (head.failed || e.body.failed) {
+        st = ATM_ERR_INTERNAL;
+    } else {
+        uint32_t crc = crc32c(crc32c(0, head.data, head.len), e.body.data, e.body.len);
+        snap_put_u32le(&e.body, crc);
+        st = e.body.failed ? ATM_ERR_INTERNAL : ATM_OK;
+    }
+
+    if (st == ATM_OK) {
+        FileReplace out;
+        st = fileio_replace_begin(&out, path);
+        if (st == ATM_OK) {
+            int ok = fileio_replace_write(&out, head.data, head.len);
+            for (size_t off = 0; ok && off < e.body.len; off += FILEIO_BUF_LEN) {
+                size_t n = e.body.len - off < FILEIO_BUF_LEN ? e.body.len - off : FILEIO_BUF_LEN;
+                ok = fileio_replace_write(&out, e.body.data + off, n);
+            }
+            st = fileio_replace_commit(&out, ok);
+        }
+        info->bytes = head.len + e.body.len;
+    }
+
+    free(head.data);
+    snap_encoder_free(&e);
+    return st;
+}
@@ -0,0 +1,236 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      throttle.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Login throttling with exponential backoff. Keys are 64-bit hashes of
+ *   "account:<id>" / "source:<id>" so entries have a fixed size. The key
+ *   table is set-associative: when a set is full, the entry closest to
+ *   expiry is evicted. Each entry is also linked into the timing wheel
+ *   bucket of its expiry tick; advancing the wheel frees expired entries
+ *   in O(entries due) without scanning the table.
+ */
+
+#include "throttle.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define THROTTLE_SETS (THROTTLE_CAPACITY / THROTTLE_WAYS)
+
+void throttle_default_config(ThrottleConfig *config) {
+    if (!config) return;
+    config->account_free_failures = 1;
+    config->source_free_failures  = 5;
+    config->base_delay_ms         = 1000;
+    config->max_delay_ms          = 5 * 60 * 1000;
+    config->forget_after_ms       = 15 * 60 * 1000;
+}
+
+AtmStatus throttle_init(Throttle *t, const ThrottleConfig *config) {
+    if (!t) return ATM_ERR_INTERNAL;
+
+    memset(t, 0, sizeof(*t));
+    if (config) {
+        t->config = *config;
+    } else {
+        throttle_default_config(&t->config);
+    }
+
+    t->entries = calloc(THROTTLE_CAPACITY, sizeof(ThrottleEntry));
+    if (!t->entries) {
+        return ATM_ERR_INTERNAL;
+    }
+    return ATM_OK;
+}
+
+void throttle_free(Throttle *t) {
+    if (!t) return;
+    free(t->entries);
+    t->entries = NULL;
+    t->active  = 0;
+}
+
+static uint64_t throttle_key(char kind, const char *id) {
+    uint64_t hash = 14695981039346656037ull;
+    hash ^= (unsigned char)kind;
+    hash *= 1099511628211ull;
+    for (const unsigned char *p = (const unsigned char *)id; *p; ++p) {
+        hash ^= *p;
+        hash *= 1099511628211ull;
+    }
+    return hash ? hash : 1; /* 0 marks a free slot */
+}
+
+/* ---------------------------------------------------------------------- */
+/* Timing wheel                                                           */
+/* ---------------------------------------------------------------------- */
+
+static void throttle_wheel_unlink(Throttle *t, uint32_t idx) {
+    ThrottleEntry *e = &t->entries[idx];
+    if (e->wheel_prev) {
+        t->entries[e->wheel_prev - 1].wheel_next = e->wheel_next;
+    } else {
+        t->wheel[e->wheel_slot] = e->wheel_next;
+    }
+    if (e->wheel_next) {
+        t->entries[e->wheel_next - 1].wheel_prev = e->wheel_prev;
+    }
+    e->wheel_next = 0;
+    e->wheel_prev = 0;
+}
+
+static void throttle_wheel_link(Throttle *t, uint32_t idx) {
+    ThrottleEntry *e    = &t->entries[idx];
+    uint32_t       slot = (uint32_t)((e->expires_at / THROTTLE_TICK_MS) & (THROTTLE_WHEEL_SLOTS - 1));
+
+    e->wheel_slot = slot;
+    e->wheel_prev = 0;
+    e->wheel_next = t->wheel[slot];
+    if (e->wheel_next) {
+        t->entries[e->wheel_next - 1].wheel_prev = idx + 1;
+    }
+    t->wheel[slot] = idx + 1;
+}
+
+static void throttle_release(Throttle *t, uint32_t idx) {
+    throttle_wheel_unlink(t, idx);
+    memset(&t->entries[idx], 0, sizeof(ThrottleEntry));
+    t->active--;
+}
+
+/* Frees every entry whose expiry tick has passed since the last call. */
+static void throttle_advance(Throttle *t, uint64_t now_ms) {
+    uint64_t now_tick = now_ms / THROTTLE_TICK_MS;
+    if (t->wheel_tick == 0 || now_tick < t->wheel_tick) {
+        t->wheel_tick = now_tick;
+        return;
+    }
+
+    uint64_t steps = now_tick - t->wheel_tick;
+    if (steps > THROTTLE_WHEEL_SLOTS) steps = THROTTLE_WHEEL_SLOTS;
+
+    for (uint64_t s = 1; s <= steps; ++s) {
+        uint32_t slot = (uint32_t)((t->wheel_tick + s) & (THROTTLE_WHEEL_SLOTS - 1));
+        uint32_t cur  = t->wheel[slot];
+        while (cur) {
+            uint32_t next = t->entries[cur - 1].wheel_next;
+            /* Entries more than one wheel revolution out stay for later. */
+            if (t->entries[cur - 1].expires_at <= now_ms) {
+                throttle_release(t, cur - 1);
+            }
+            cur = next;
+        }
+    }
+    t->wheel_tick = now_tick;
+}
+
+/* ---------------------------------------------------------------------- */
+/* Key table                                                              */
+/* ---------------------------------------------------------------------- */
+
+static ThrottleEntry *throttle_find(Throttle *t, uint64_t key, int create, uint32_t *out_idx) {
+    uint32_t base   = (uint32_t)(key & (THROTTLE_SETS - 1)) * THROTTLE_WAYS;
+    uint32_t free_i = UINT32_MAX;
+    uint32_t victim = base;
+
+    for (uint32_t w = 0; w < THROTTLE_WAYS; ++w) {
+        ThrottleEntry *e = &t->entries[base + w];
+        if (e->key == key) {
+            *out_idx = base + w;
+            return e;
+        }
+        if (e->key == 0 && free_i == UINT32_MAX) {
+            free_i = base + w;
+        } else if (e->key != 0 && e->expires_at < t->entries[victim].expires_at) {
+            victim = base + w;
+        }
+    }
+
+    if (!create) {
+        return NULL;
+    }
+
+    if (free_i == UINT32_MAX) {
+        throttle_release(t, victim);
+        free_i = victim;
+    }
+
+    ThrottleEntry *e = &t->entries[free_i];
+    memset(e, 0, sizeof(*e));
+    e->key = key;
+    t->active++;
+    *out_idx = free_i;
+    return e;
+}
+
+static uint64_t throttle_delay(const ThrottleConfig *c, uint32_t failures, unsigned free_failures) {
+    if (failures <= free_failures) {
+        return 0;
+    }
+    uint32_t shift = failures - free_failures - 1;
+    if (shift > 30) shift = 30;
+
+    uint64_t delay = c->base_delay_ms << shift;
+    return delay > c->max_delay_ms ? c->max_delay_ms : delay;
+}
+
+static uint64_t throttle_remaining(Throttle *t, uint64_t key, uint64_t now_ms) {
+    uint32_t       idx;
+    ThrottleEntry *e = throttle_find(t, key, 0, &idx);
+    return (e && e->blocked_until > now_ms) ? e->blocked_until - now_ms : 0;
+}
+
+static void throttle_fail(Throttle *t, uint64_t key, unsigned free_failures, uint64_t now_ms) {
+    uint32_t       idx;
+    ThrottleEntry *e = throttle_find(t, key, 1, &idx);
+
+    if (e->expires_at) {
+        throttle_wheel_unlink(t, idx);
+    }
+    e->failures++;
+    uint64_t delay   = throttle_delay(&t->config, e->failures, free_failures);
+    e->blocked_until = now_ms + delay;
+    e->expires_at    = now_ms + delay + t->config.forget_after_ms;
+    throttle_wheel_link(t, idx);
+}
+
+AtmStatus throttle_check(Throttle *t, const char *account_id, const char *source,
+                         uint64_t now_ms, uint64_t *retry_after_ms) {
+    if (!t || !t->entries || !account_id) return ATM_ERR_INTERNAL;
+
+    throttle_advance(t, now_ms);
+
+    uint64_t wait = throttle_remaining(t, throttle_key('A', account_id), now_ms);
+    if (source) {
+        uint64_t w = throttle_remaining(t, throttle_key('S', source), now_ms);
+        if (w > wait) wait = w;
+    }
+
+    if (retry_after_ms) *retry_after_ms = wait;
+    return wait ? ATM_ERR_THROTTLED : ATM_OK;
+}
+
+void throttle_record(Throttle *t, const char *account_id, const char *source,
+                     uint64_t now_ms, int success) {
+    if (!t || !t->entries || !account_id) return;
+
+    throttle_advance(t, now_ms);
+
+    uint64_t account_key = throttle_key('A', account_id);
+    if (success) {
+        /* A terminal's failure history is kept: it may serve many users. */
+        uint32_t idx;
+        if (throttle_find(t, account_key, 0, &idx)) {
+            throttle_release(t, idx);
+        }
+        return;
+    }
+
+    throttle_fail(t, account_key, t->config.account_free_failures, now_ms);
+    if (source) {
+        throttle_fail(t, throttle_key('S', source), t->config.source_free_failures, now_ms);
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      timeutil.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Monotonic and wall clock helpers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "timeutil.h"
+
+#include <time.h>
+
+#if defined(_WIN32) || defined(_WIN64)
+#  include <windows.h>
+#endif
+
+uint64_t time_monotonic_ns(void) {
+#if defined(_WIN32) || defined(_WIN64)
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER        now;
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency(&freq);
+    }
+    QueryPerformanceCounter(&now);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t time_monotonic_ms(void) {
+    return time_monotonic_ns() / 1000000ull;
+}
+
+uint64_t time_wall_ms(void) {
+    struct timespec ts;
+    if (timespec_get(&ts, TIME_UTC) != TIME_UTC) {
+        return 0;
+    }
+    return (uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u;
+}
+
+void time_sleep_until_ns(uint64_t deadline_ns) {
+    for (;;) {
+        uint64_t now = time_monotonic_ns();
+        if (now >= deadline_ns) {
+            return;
+        }
+        uint64_t left = deadline_ns - now;
+#if defined(_WIN32) || defined(_WIN64)
+        Sleep((DWORD)((left + 999999ull) / 1000000ull));
+#else
+        struct timespec ts;
+        ts.tv_sec  = (time_t)(left / 1000000000ull);
+        ts.tv_nsec = (long)(left % 1000000000ull);
+        nanosleep(&ts, NULL); /* re-checked after EINTR */
+#endif
+    }
+}
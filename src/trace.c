@@ -0,0 +1,360 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      trace.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Trace ring buffer, dump (including from a signal handler) and the
+ *   dump decoder (see trace.h).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+#include "atm.h"
+#include "timeutil.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  include <x86intrin.h>
+#  define TRACE_HAVE_TSC 1
+#endif
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#  include <fcntl.h>
+#  include <signal.h>
+#  include <unistd.h>
+#  define TRACE_HAVE_POSIX 1
+#endif
+
+static TraceEvent       trace_ring[TRACE_CAPACITY];
+static _Atomic uint64_t trace_head;
+
+static char     trace_path[MAX_DB_PATH_LEN] = TRACE_DEFAULT_FILE;
+static int      trace_at_exit;
+static uint64_t trace_ref_ticks;
+static uint64_t trace_ref_ns;
+
+static inline uint64_t trace_ticks(void) {
+#ifdef TRACE_HAVE_TSC
+    return __rdtsc();
+#else
+    return time_monotonic_ns();
+#endif
+}
+
+#ifndef ATM_NO_TRACE
+void trace_record(TracePhase phase, TraceKind kind, AtmStatus status, uint32_t arg) {
+    /* Claiming a slot is the only shared write; a writer that is lapped by
+     * TRACE_CAPACITY others simply loses its event to the newer one. */
+    uint64_t    index = atomic_fetch_add_explicit(&trace_head, 1, memory_order_relaxed);
+    TraceEvent *ev    = &trace_ring[index & (TRACE_CAPACITY - 1)];
+
+    ev->ticks  = trace_ticks();
+    ev->phase  = (uint8_t)phase;
+    ev->kind   = (uint8_t)kind;
+    ev->status = (uint16_t)status;
+    ev->arg    = arg;
+}
+#endif
+
+static void trace_fill_header(TraceHeader *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+    hdr->version      = TRACE_VERSION;
+    hdr->event_size   = (uint32_t)sizeof(TraceEvent);
+    hdr->capacity     = TRACE_CAPACITY;
+    hdr->head         = atomic_load_explicit(&trace_head, memory_order_acquire);
+    hdr->ref_ticks[0] = trace_ref_ticks;
+    hdr->ref_ns[0]    = trace_ref_ns;
+    hdr->ref_ticks[1] = trace_ticks();
+    hdr->ref_ns[1]    = time_monotonic_ns();
+#ifdef TRACE_HAVE_POSIX
+    hdr->pid          = (uint32_t)getpid();
+#endif
+}
+
+#ifdef TRACE_HAVE_POSIX
+/* Async-signal-safe: only open/write/close and no allocation. */
+static int trace_write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            return 0;
+        }
+        p   += n;
+        len -= (size_t)n;
+    }
+    return 1;
+}
+
+static AtmStatus trace_dump_fd(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return ATM_ERR_IO;
+    }
+    TraceHeader hdr;
+    trace_fill_header(&hdr);
+    int ok = trace_write_all(fd, &hdr, sizeof(hdr)) &&
+             trace_write_all(fd, trace_ring, sizeof(trace_ring));
+    ok = (close(fd) == 0) && ok;
+    return ok ? ATM_OK : ATM_ERR_IO;
+}
+
+static void trace_on_signal(int sig) {
+    (void)sig;
+    trace_dump_fd(trace_path);
+}
+#endif
+
+AtmStatus trace_dump(const char *path) {
+    if (!path) return ATM_ERR_INTERNAL;
+#ifdef TRACE_HAVE_POSIX
+    return trace_dump_fd(path);
+#else
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+    TraceHeader hdr;
+    trace_fill_header(&hdr);
+    int ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+             fwrite(trace_ring, sizeof(trace_ring), 1, fp) == 1;
+    ok = (fclose(fp) == 0) && ok;
+    return ok ? ATM_OK : ATM_ERR_IO;
+#endif
+}
+
+void trace_init(void) {
+    trace_ref_ticks = trace_ticks();
+    trace_ref_ns    = time_monotonic_ns();
+
+    const char *env = getenv(TRACE_ENV);
+    if (env && *env && strlen(env) < sizeof(trace_path)) {
+        strcpy(trace_path, env);
+        trace_at_exit = 1;
+    }
+#ifdef TRACE_HAVE_POSIX
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = trace_on_signal;
+    sa.sa_flags   = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+#endif
+}
+
+void trace_shutdown(void) {
+    if (trace_at_exit && trace_dump(trace_path) != ATM_OK) {
+        fprintf(stderr, "trace: cannot write '%s'\n", trace_path);
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+/* Decoder                                                                */
+/* ---------------------------------------------------------------------- */
+
+#define TRACE_MAX_DEPTH 32
+
+static const char *const trace_phase_names[TRACE_PHASE_COUNT] = {
+    "?", "login", "find", "auth", "txn", "persist", "reload", "replicate", "session"
+};
+
+typedef struct {
+    uint8_t  phase;
+    uint64_t begin_ns;
+    uint64_t child_ns;
+} TraceFrame;
+
+typedef struct {
+    uint64_t *durations;
+    size_t    count;
+    size_t    cap;
+    size_t    errors;
+    uint64_t  total_ns;
+    uint64_t  self_ns;
+} TracePhaseStats;
+
+static int trace_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int trace_add_duration(TracePhaseStats *ps, uint64_t ns) {
+    if (ps->count == ps->cap) {
+        size_t    cap   = ps->cap ? ps->cap * 2 : 256;
+        uint64_t *grown = realloc(ps->durations, cap * sizeof(uint64_t));
+        if (!grown) {
+            return 0;
+        }
+        ps->durations = grown;
+        ps->cap       = cap;
+    }
+    ps->durations[ps->count++] = ns;
+    return 1;
+}
+
+/* Event time in ns since the first reference point. */
+static uint64_t trace_ns(const TraceHeader *hdr, double ns_per_tick, uint64_t ticks) {
+    if (ticks <= hdr->ref_ticks[0]) {
+        return 0;
+    }
+    return (uint64_t)((double)(ticks - hdr->ref_ticks[0]) * ns_per_tick);
+}
+
+static double trace_us(uint64_t ns) {
+    return (double)ns / 1000.0;
+}
+
+AtmStatus trace_decode(const char *path, FILE *out, int timeline) {
+    if (!path || !out) return ATM_ERR_INTERNAL;
+
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return ATM_ERR_IO;
+    }
+
+    TraceHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.version != TRACE_VERSION || hdr.event_size != sizeof(TraceEvent) ||
+        hdr.capacity == 0 || (hdr.capacity & (hdr.capacity - 1)) != 0) {
+        fclose(fp);
+        return ATM_ERR_PARSE;
+    }
+
+    TraceEvent *ring = malloc((size_t)hdr.capacity * sizeof(TraceEvent));
+    if (!ring) {
+        fclose(fp);
+        return ATM_ERR_INTERNAL;
+    }
+    if (fread(ring, sizeof(TraceEvent), hdr.capacity, fp) != hdr.capacity) {
+        free(ring);
+        fclose(fp);
+        return ATM_ERR_PARSE;
+    }
+    fclose(fp);
+
+    double ns_per_tick = 1.0;
+    if (hdr.ref_ticks[1] > hdr.ref_ticks[0] && hdr.ref_ns[1] > hdr.ref_ns[0]) {
+        ns_per_tick = (double)(hdr.ref_ns[1] - hdr.ref_ns[0]) /
+                      (double)(hdr.ref_ticks[1] - hdr.ref_ticks[0]);
+    }
+
+    uint64_t kept  = hdr.head < hdr.capacity ? hdr.head : hdr.capacity;
+    uint64_t first = hdr.head - kept;
+    fprintf(out, "pid %u: %llu events recorded, %llu kept, %llu overwritten\n",
+            hdr.pid, (unsigned long long)hdr.head, (unsigned long long)kept,
+            (unsigned long long)first);
+
+    TracePhaseStats stats[TRACE_PHASE_COUNT];
+    TraceFrame      stack[TRACE_MAX_DEPTH];
+    size_t          depth   = 0;
+    size_t          skipped = 0;
+    uint64_t        t0      = 0;
+    uint64_t        t_last  = 0;
+    AtmStatus       st      = ATM_OK;
+    memset(stats, 0, sizeof(stats));
+
+    for (uint64_t i = first; i < hdr.head && st == ATM_OK; ++i) {
+        const TraceEvent *ev = &ring[i & (hdr.capacity - 1)];
+        uint64_t          ts = trace_ns(&hdr, ns_per_tick, ev->ticks);
+
+        /* Slots being written at dump time, or not written yet. */
+        if (ev->phase == 0 || ev->phase >= TRACE_PHASE_COUNT ||
+            (ev->kind != TRACE_BEGIN && ev->kind != TRACE_END) || ts < t_last) {
+            skipped++;
+            continue;
+        }
+        if (!t0) {
+            t0 = ts;
+        }
+        t_last = ts;
+
+        if (ev->kind == TRACE_BEGIN) {
+            if (timeline) {
+                fprintf(out, "%12.3f ms  %*s%s begin arg=%u\n",
+                        (double)(ts - t0) / 1e6, (int)(2 * depth), "",
+                        trace_phase_names[ev->phase], ev->arg);
+            }
+            if (depth == TRACE_MAX_DEPTH) {
+                memmove(stack, stack + 1, (TRACE_MAX_DEPTH - 1) * sizeof(stack[0]));
+                depth--;
+            }
+            stack[depth].phase    = ev->phase;
+            stack[depth].begin_ns = ts;
+            stack[depth].child_ns = 0;
+            depth++;
+            continue;
+        }
+
+        /* Match the innermost open frame of this phase; frames above it
+         * lost their END (e.g. to a lapped writer) and are dropped. */
+        size_t f = depth;
+        while (f > 0 && stack[f - 1].phase != ev->phase) {
+            f--;
+        }
+        if (f == 0) {
+            skipped++; /* its BEGIN was overwritten */
+            continue;
+        }
+        depth = f - 1;
+
+        uint64_t         dur = ts - stack[depth].begin_ns;
+        uint64_t         own = dur > stack[depth].child_ns ? dur - stack[depth].child_ns : 0;
+        TracePhaseStats *ps  = &stats[ev->phase];
+        if (!trace_add_duration(ps, dur)) {
+            st = ATM_ERR_INTERNAL;
+            break;
+        }
+        ps->total_ns += dur;
+        ps->self_ns  += own;
+        if (ev->status != ATM_OK) {
+            ps->errors++;
+        }
+        if (depth > 0) {
+            stack[depth - 1].child_ns += dur;
+        }
+
+        if (timeline) {
+            fprintf(out, "%12.3f ms  %*s%s end %s arg=%u (%.1f us)\n",
+                    (double)(ts - t0) / 1e6, (int)(2 * depth), "",
+                    trace_phase_names[ev->phase], atm_status_name((AtmStatus)ev->status),
+                    ev->arg, trace_us(dur));
+        }
+    }
+
+    if (st == ATM_OK) {
+        fprintf(out, "span %.3f ms, %zu events unmatched or incomplete\n\n",
+                (double)(t_last - t0) / 1e6, skipped);
+        fprintf(out, "%-10s %8s %6s %10s %10s %10s %10s %12s %12s\n",
+                "phase", "count", "errors", "avg_us", "p50_us", "p99_us", "max_us",
+                "total_ms", "self_ms");
+        for (int p = 1; p < TRACE_PHASE_COUNT; ++p) {
+            TracePhaseStats *ps = &stats[p];
+            if (!ps->count) {
+                continue;
+            }
+            qsort(ps->durations, ps->count, sizeof(uint64_t), trace_cmp_u64);
+            fprintf(out, "%-10s %8zu %6zu %10.1f %10.1f %10.1f %10.1f %12.3f %12.3f\n",
+                    trace_phase_names[p], ps->count, ps->errors,
+                    trace_us(ps->total_ns / ps->count),
+                    trace_us(ps->durations[ps->count / 2]),
+                    trace_us(ps->durations[(ps->count * 99) / 100]),
+                    trace_us(ps->durations[ps->count - 1]),
+                    (double)ps->total_ns / 1e6, (double)ps->self_ns / 1e6);
+        }
+    }
+
+    for (int p = 0; p < TRACE_PHASE_COUNT; ++p) {
+        free(stats[p].durations);
+    }
+    free(ring);
+    return st;
+}
@@ -0,0 +1,145 @@
+/*
+ * Project:   Command-Line ATM Interface
+ * File:      codec_test.c
+ * Author:    Mobin Yousefi (GitHub: github.com/mobinyousefi-cs)
+ * License:   MIT
+ *
+ * Description:
+ *   Round-trips records covering every ACCOUNT_FIELDS kind (STR, MONEY,
+ *   U32, FLAG, UINT, HEX) through the CSV and JSON codecs, including MONEY
+ *   values far outside ACCOUNT_MAX_BALANCE, and checks that damage after
+ *   the last column is rejected. Run with
+ *   `make -f Makefile.mak test`.
+ */
+
+#include "account_codec.h"
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+static const double money_cases[] = {
+    0.0,     0.01,     -0.01,    1500.5,   -123456.78, ACCOUNT_MAX_BALANCE,
+    -ACCOUNT_MAX_BALANCE, 1.0e300, -1.0e300, DBL_MAX,  -DBL_MAX,
+};
+
+#define MONEY_CASES (sizeof(money_cases) / sizeof(money_cases[0]))
+
+static void fill_account(Account *acc, size_t i) {
+    memset(acc, 0, sizeof(*acc));
+
+    /* Alternate between the shortest and the longest STR fields. */
+    if (i % 2) {
+        memset(acc->id, '9', MAX_ACCOUNT_ID_LEN - 1);
+        memset(acc->holder_name, 'Z', MAX_NAME_LEN - 1);
+    } else {
+        snprintf(acc->id, sizeof(acc->id), "%zu", 1000 + i);
+        snprintf(acc->holder_name, sizeof(acc->holder_name), "Holder %zu", i);
+    }
+
+    acc->balance         = money_cases[i];
+    acc->pin_hash        = (i % 2) ? UINT32_MAX : (uint32_t)i * 2654435761u;
+    acc->is_locked       = (int)(i % 3) - 1; /* ACCOUNT_CLOSED, 0, 1 */
+    acc->failed_attempts = (i % 2) ? (unsigned)-1 : (unsigned)i;
+    acc->hash_version    = (unsigned)(i % 3);
+    acc->kdf_cost        = (unsigned)i + 8;
+    for (size_t k = 0; k < sizeof(acc->pin_salt); ++k) {
+        acc->pin_salt[k] = (uint8_t)(i * 31 + k * 7);
+    }
+    for (size_t k = 0; k < sizeof(acc->pin_kdf); ++k) {
+        acc->pin_kdf[k] = (uint8_t)(0xff - i - k);
+    }
+}
+
+static int check_csv(const Account *acc, size_t i) {
+    char     line[ACCOUNT_CSV_RECORD_MAX + 1];
+    uint32_t crc = 0;
+    size_t   len = account_format_csv(acc, line, &crc);
+
+    if (len > ACCOUNT_CSV_RECORD_MAX) {
+        fprintf(stderr, "case %zu: CSV record of %zu bytes is too long\n", i, len);
+        return 0;
+    }
+    line[len] = '\0';
+    if (strlen(line) != len || line[len - 1] != '\n') {
+        fprintf(stderr, "case %zu: CSV record is malformed: %s\n", i, line);
+        return 0;
+    }
+
+    Account   back;
+    int       checked = 0;
+    AtmStatus st      = account_parse_csv(line, &back, &checked);
+    if (st != ATM_OK || !checked || !account_equal(acc, &back) ||
+        crc != account_record_crc(&back)) {
+        fprintf(stderr, "case %zu: CSV round-trip failed (status %d): %s", i,
+                (int)st, line);
+        return 0;
+    }
+    return 1;
+}
+
+static int check_json(const Account *acc, size_t i) {
+    char   text[ACCOUNT_JSON_RECORD_MAX + 1];
+    size_t len = account_format_json(acc, text, NULL);
+
+    if (len > ACCOUNT_JSON_RECORD_MAX) {
+        fprintf(stderr, "case %zu: JSON record of %zu bytes is too long\n", i, len);
+        return 0;
+    }
+    text[len] = '\0';
+
+    Account     back;
+    const char *cursor  = text;
+    int         checked = 0;
+    AtmStatus   st      = account_parse_json(&cursor, &back, &checked);
+    if (st != ATM_OK || !checked || !account_equal(acc, &back)) {
+        fprintf(stderr, "case %zu: JSON round-trip failed (status %d):\n%s\n", i,
+                (int)st, text);
+        return 0;
+    }
+    return 1;
+}
+
+/* Damage after the last field must not load, with or without a checksum. */
+static int check_trailing(const Account *acc) {
+    static const char *const tails[] = { "x\n", ",1\n", ",deadbeef,1\n", ",deadbeefx\n" };
+    char   line[ACCOUNT_CSV_RECORD_MAX + 16];
+    size_t len   = account_format_csv(acc, line, NULL);
+    char  *comma = line + len;
+    while (*--comma != ',') {
+    }
+
+    int ok = 1;
+    for (size_t t = 0; t < sizeof(tails) / sizeof(tails[0]); ++t) {
+        strcpy(comma, tails[t]);
+        Account back;
+        if (account_parse_csv(line, &back, NULL) != ATM_ERR_PARSE) {
+            fprintf(stderr, "trailing \"%.*s\" was accepted\n",
+                    (int)strcspn(tails[t], "\n"), tails[t]);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+int main(void) {
+    size_t failed = 0;
+
+    for (size_t i = 0; i < MONEY_CASES; ++i) {
+        Account acc;
+        fill_account(&acc, i);
+        if (!check_csv(&acc, i)) failed++;
+        if (!check_json(&acc, i)) failed++;
+    }
+    Account acc;
+    fill_account(&acc, 0);
+    if (!check_trailing(&acc)) failed++;
+
+    if (failed) {
+        fprintf(stderr, "codec round-trip: %zu of %zu checks failed\n", failed,
+                2 * MONEY_CASES + 1);
+        return 1;
+    }
+    printf("codec round-trip: %zu records OK\n", MONEY_CASES);
+    return 0;
+}